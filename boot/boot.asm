@@ -5,9 +5,11 @@
 bits 16         ; We start in 16-bit real mode
 org 0x7c00      ; BIOS loads boot sectors here
 
-KERNEL_LOAD_ADDR equ 0x1000 ; Address where we will load the kernel
-KERNEL_SECTOR_START equ 2     ; Kernel starts at the 2nd sector (1st is bootloader)
-KERNEL_SECTORS_TO_LOAD equ 20 ; How many sectors to load (adjust if kernel grows)
+KERNEL_LOAD_ADDR equ 0x10000 ; Address where we will load the kernel (must match linker.ld)
+KERNEL_LOAD_SEG equ 0x1000    ; Real-mode segment for KERNEL_LOAD_ADDR
+KERNEL_LBA_START equ 1        ; Kernel starts at LBA 1 (LBA 0 is bootloader)
+KERNEL_SECTORS_TO_LOAD equ 512 ; How many sectors to load (256 KiB; must stay below partition start)
+KERNEL_CHUNK_SECTORS equ 64   ; Sectors per int 13h call (32 KiB, keeps each read inside one segment)
 
 start:
     ; --- Initial Setup ---
@@ -17,6 +19,7 @@ start:
     mov es, ax      ; Set ES=0
     mov ss, ax      ; Set SS=0
     mov sp, 0x7c00  ; Stack grows downwards from bootloader base
+    mov [boot_drive], dl ; BIOS passes the boot drive number in DL
 
     sti             ; Re-enable interrupts for BIOS calls
 
@@ -33,21 +36,29 @@ print_loop:
     jmp print_loop
 
 load_kernel:
-    ; --- Load Kernel from Disk using BIOS int 13h ---
-    ; Assumes boot drive is floppy (DL=0) or first hard disk (DL=0x80)
-    ; BIOS stores boot drive number in DL, so we just use it.
-
-    mov bx, KERNEL_LOAD_ADDR ; ES:BX = destination buffer (ES=0)
-    mov ah, 0x02             ; BIOS Read Sectors function
-    mov al, KERNEL_SECTORS_TO_LOAD ; Number of sectors to read
-    mov ch, 0                ; Cylinder number (track) = 0
-    mov cl, KERNEL_SECTOR_START ; Sector number to start reading from
-    mov dh, 0                ; Head number = 0
-    ; DL = drive number (already set by BIOS)
-
+    ; --- Load Kernel from Disk using BIOS int 13h Extensions (LBA) ---
+    ; The kernel no longer fits below the bootloader at 0x7C00, so it is loaded
+    ; at 0x10000 in KERNEL_CHUNK_SECTORS pieces using AH=42h (Extended Read).
+    ; Each chunk advances the destination segment, so no read crosses 64 KiB.
+
+    mov word [dap_segment], KERNEL_LOAD_SEG
+    mov dword [dap_lba], KERNEL_LBA_START
+    mov cx, KERNEL_SECTORS_TO_LOAD / KERNEL_CHUNK_SECTORS
+
+.next_chunk:
+    push cx
+    mov word [dap_count], KERNEL_CHUNK_SECTORS
+    mov si, dap              ; DS:SI = Disk Address Packet
+    mov ah, 0x42             ; BIOS Extended Read function
+    mov dl, [boot_drive]     ; DL = drive number saved at start
     int 0x13                 ; Call BIOS disk interrupt
+    pop cx
     jc disk_error            ; Jump if carry flag set (error)
 
+    add word [dap_segment], KERNEL_CHUNK_SECTORS * 512 / 16 ; Next 32 KiB
+    add dword [dap_lba], KERNEL_CHUNK_SECTORS
+    loop .next_chunk
+
     ; --- Switch to Protected Mode ---
     cli                      ; Disable interrupts PERMANENTLY before mode switch
 
@@ -140,6 +151,23 @@ CODE_SEG equ gdt_code - gdt_start ; Should be 0x08
 DATA_SEG equ gdt_data - gdt_start ; Should be 0x10
 
 ; --- Data ---
+boot_drive db 0
+
+; Disk Address Packet for int 13h AH=42h
+align 4
+dap:
+    db 0x10                 ; Packet size
+    db 0                    ; Reserved
+dap_count:
+    dw 0                    ; Sectors to transfer
+dap_offset:
+    dw 0                    ; Destination offset
+dap_segment:
+    dw 0                    ; Destination segment
+dap_lba:
+    dd 0                    ; Starting LBA (low 32 bits)
+    dd 0                    ; Starting LBA (high 32 bits)
+
 boot_msg db "Booting MyOS...", 0x0d, 0x0a, 0
 disk_err_msg db "Disk read error!", 0x0d, 0x0a, 0
 
@@ -9,6 +9,8 @@ BOOT_BIN=${2:-boot/boot.bin}
 KERNEL_BIN=${3:-kernel.bin}
 IMAGE_SECTORS=${4:-65536}   # Default 32 MiB
 PART_START_SECTOR=${5:-2048} # Default start sector
+shift 5 2>/dev/null || shift $#
+PROGRAMS="$@"               # Remaining arguments: files to copy into the FAT32 root
 
 # Constants
 SECTOR_SIZE=512
@@ -73,6 +75,15 @@ dd if=${TEMP_IMG} of=${OS_IMAGE} bs=${SECTOR_SIZE} conv=notrunc status=none
 # Clean up the temporary combined file
 rm ${TEMP_IMG}
 
+if [ -n "${PROGRAMS}" ]; then
+    echo ">>> Copying programs into the FAT32 partition: ${PROGRAMS}"
+    if command -v mcopy > /dev/null; then
+        mcopy -o -i ${OS_IMAGE}@@${PART_OFFSET} ${PROGRAMS} ::/
+    else
+        echo "Warning: mtools (mcopy) not found; programs not copied."
+    fi
+fi
+
 echo ">>> OS Image created successfully: ${OS_IMAGE}"
 echo "--- NOTE: Formatting/losetup steps required sudo privileges. ---"
 
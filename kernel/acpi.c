@@ -0,0 +1,126 @@
+// kernel/acpi.c
+// RSDP search, RSDT walk and MADT parsing. Tables are read in place through
+// the identity mapping, so physical addresses are directly usable. Readably
+// formatted.
+
+#include "acpi.h"
+#include "io.h"
+#include "string.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// --- ACPI Structures ---
+typedef struct __attribute__((packed)) {
+    char signature[8];     // "RSD PTR "
+    uint8_t checksum;
+    char oem_id[6];
+    uint8_t revision;
+    uint32_t rsdt_address;
+} AcpiRsdp;
+
+typedef struct __attribute__((packed)) {
+    char signature[4];
+    uint32_t length;
+    uint8_t revision;
+    uint8_t checksum;
+    char oem_id[6];
+    char oem_table_id[8];
+    uint32_t oem_revision;
+    uint32_t creator_id;
+    uint32_t creator_revision;
+} AcpiSdtHeader;
+
+typedef struct __attribute__((packed)) {
+    AcpiSdtHeader header;
+    uint32_t lapic_address;
+    uint32_t flags;
+    // Variable-length entries follow
+} AcpiMadt;
+
+typedef struct __attribute__((packed)) {
+    uint8_t type;
+    uint8_t length;
+} AcpiMadtEntry;
+
+#define MADT_TYPE_LAPIC          0
+#define MADT_TYPE_IOAPIC         1
+#define MADT_TYPE_IRQ_OVERRIDE   2
+#define MADT_LAPIC_ENABLED       0x01
+
+// --- Helpers ---
+static int acpi_checksum_ok(const void *p, uint32_t len) {
+    uint8_t sum = 0;
+    for (uint32_t i = 0; i < len; ++i) sum += ((const uint8_t*)p)[i];
+    return sum == 0;
+}
+
+// RSDP lives on a 16-byte boundary in the first KiB of the EBDA or in 0xE0000-0xFFFFF.
+static const AcpiRsdp *acpi_scan_rsdp(uint32_t start, uint32_t end) {
+    for (uint32_t addr = start; addr + sizeof(AcpiRsdp) <= end; addr += 16) {
+        const AcpiRsdp *r = (const AcpiRsdp*)addr;
+        if (memcmp(r->signature, "RSD PTR ", 8) == 0 && acpi_checksum_ok(r, sizeof(AcpiRsdp))) return r;
+    }
+    return NULL;
+}
+
+static const AcpiRsdp *acpi_find_rsdp(void) {
+    volatile uint16_t *bda_ebda = (volatile uint16_t*)0x40E; // BDA: EBDA segment
+    asm volatile ("" : "+r"(bda_ebda)); // Hide the constant address from -Warray-bounds
+    uint32_t ebda = (uint32_t)*bda_ebda << 4;
+    const AcpiRsdp *r = NULL;
+    if (ebda >= 0x80000 && ebda < 0xA0000) r = acpi_scan_rsdp(ebda, ebda + 1024);
+    if (!r) r = acpi_scan_rsdp(0xE0000, 0x100000);
+    return r;
+}
+
+// --- Public Functions ---
+int acpi_parse_madt(acpi_madt_info_t *out) {
+    memset(out, 0, sizeof(*out));
+
+    const AcpiRsdp *rsdp = acpi_find_rsdp();
+    if (!rsdp) { term_writestring("ACPI: RSDP not found\n"); return -1; }
+
+    const AcpiSdtHeader *rsdt = (const AcpiSdtHeader*)rsdp->rsdt_address;
+    if (memcmp(rsdt->signature, "RSDT", 4) != 0 || !acpi_checksum_ok(rsdt, rsdt->length)) {
+        term_writestring("ACPI: bad RSDT\n"); return -2;
+    }
+
+    const AcpiMadt *madt = NULL;
+    uint32_t n = (rsdt->length - sizeof(AcpiSdtHeader)) / 4;
+    const uint32_t *tables = (const uint32_t*)(rsdt + 1);
+    for (uint32_t i = 0; i < n; ++i) {
+        const AcpiSdtHeader *h = (const AcpiSdtHeader*)tables[i];
+        if (memcmp(h->signature, "APIC", 4) == 0 && acpi_checksum_ok(h, h->length)) { madt = (const AcpiMadt*)h; break; }
+    }
+    if (!madt) { term_writestring("ACPI: MADT not found\n"); return -3; }
+
+    out->lapic_address = madt->lapic_address;
+    const uint8_t *p = (const uint8_t*)(madt + 1);
+    const uint8_t *end = (const uint8_t*)madt + madt->header.length;
+    while (p + sizeof(AcpiMadtEntry) <= end) {
+        const AcpiMadtEntry *e = (const AcpiMadtEntry*)p;
+        if (e->length < 2) break; // Corrupt table: stop rather than loop forever
+
+        if (e->type == MADT_TYPE_LAPIC) {
+            // acpi_processor_id(1), apic_id(1), flags(4)
+            uint8_t apic_id = p[3];
+            uint32_t flags = *(const uint32_t*)(p + 4);
+            if ((flags & MADT_LAPIC_ENABLED) && out->cpu_count < MAX_CPUS) out->cpu_apic_ids[out->cpu_count++] = apic_id;
+        } else if (e->type == MADT_TYPE_IOAPIC && out->ioapic_address == 0) {
+            // id(1), reserved(1), address(4), gsi_base(4)
+            out->ioapic_id = p[2];
+            out->ioapic_address = *(const uint32_t*)(p + 4);
+            out->ioapic_gsi_base = *(const uint32_t*)(p + 8);
+        } else if (e->type == MADT_TYPE_IRQ_OVERRIDE && out->override_count < ACPI_MAX_IRQ_OVERRIDES) {
+            // bus(1), source(1), gsi(4), flags(2)
+            acpi_irq_override_t *o = &out->overrides[out->override_count++];
+            o->source_irq = p[3];
+            o->gsi = *(const uint32_t*)(p + 4);
+            o->flags = *(const uint16_t*)(p + 8);
+        }
+        p += e->length;
+    }
+
+    if (out->cpu_count == 0 || out->ioapic_address == 0) { term_writestring("ACPI: MADT lacks CPUs or I/O APIC\n"); return -4; }
+    return 0;
+}
@@ -0,0 +1,40 @@
+// kernel/acpi.h
+// Minimal ACPI table discovery: RSDP -> RSDT -> MADT ("APIC"). Readably formatted.
+
+#ifndef ACPI_H
+#define ACPI_H
+
+#include <stdint.h>
+#include "cpu.h"
+
+#define ACPI_MAX_IRQ_OVERRIDES 16
+
+// Interrupt Source Override flags (MPS INTI flags)
+#define ACPI_MADT_POLARITY_MASK  0x03
+#define ACPI_MADT_POLARITY_LOW   0x03
+#define ACPI_MADT_TRIGGER_MASK   0x0C
+#define ACPI_MADT_TRIGGER_LEVEL  0x0C
+
+typedef struct {
+    uint8_t  source_irq; // ISA IRQ
+    uint32_t gsi;        // Global System Interrupt it is wired to
+    uint16_t flags;      // Polarity/trigger
+} acpi_irq_override_t;
+
+// What the kernel needs from the MADT.
+typedef struct {
+    uint32_t lapic_address;
+    uint32_t cpu_count;                   // Enabled processors (up to MAX_CPUS)
+    uint8_t  cpu_apic_ids[MAX_CPUS];
+    uint32_t ioapic_address;              // First I/O APIC (0 if none)
+    uint8_t  ioapic_id;
+    uint32_t ioapic_gsi_base;
+    uint32_t override_count;
+    acpi_irq_override_t overrides[ACPI_MAX_IRQ_OVERRIDES];
+} acpi_madt_info_t;
+
+// Locates and parses the MADT. Returns 0 on success, negative if ACPI or
+// the MADT is missing/corrupt (the kernel then stays on the 8259 PIC).
+int acpi_parse_madt(acpi_madt_info_t *out);
+
+#endif // ACPI_H
@@ -0,0 +1,347 @@
+// kernel/ahci.c
+// AHCI driver for one SATA disk behind a request queue. The queue's worker
+// hands each merged transfer to a free command slot (one PRDT entry per
+// merged request) and returns at once; with NCQ up to 32 READ/WRITE FPDMA
+// QUEUED commands are outstanding and the IRQ handler completes every slot
+// whose SActive bit the drive has cleared. Kernel buffers and the HBA
+// registers are reached through the identity mapping (the registers through
+// its uncached 4 MiB pages above RAM), so their physical addresses are used
+// as is. Readably formatted.
+
+#include "ahci.h"
+#include "pci.h"
+#include "blkdev.h"
+#include "idt.h"
+#include "smp.h"
+#include "cpu.h"
+#include "spinlock.h"
+#include "io.h"
+#include "string.h"
+#include <stdint.h>
+
+// --- PCI Identification ---
+#define PCI_CLASS_STORAGE 0x01
+#define PCI_SUBCLASS_SATA 0x06
+#define PCI_PROGIF_AHCI   0x01
+#define AHCI_ABAR_BAR     5
+
+// --- HBA / Port Register Bits ---
+#define HBA_CAP_SNCQ      (1u << 30)
+#define HBA_CAP_NCS(cap)  ((((cap) >> 8) & 0x1F) + 1)
+#define HBA_GHC_AE        (1u << 31)
+#define HBA_GHC_IE        (1u << 1)
+
+#define PORT_CMD_ST       0x0001
+#define PORT_CMD_FRE      0x0010
+#define PORT_CMD_FR       0x4000
+#define PORT_CMD_CR       0x8000
+#define PORT_SSTS_DET_MASK 0x0F
+#define PORT_SSTS_DET_OK  0x03 // Device present, PHY communication established
+#define PORT_SIG_SATA     0x00000101
+#define PORT_TFD_ERR      0x01
+#define PORT_TFD_DRQ      0x08
+#define PORT_TFD_BSY      0x80
+
+#define PORT_IS_DHRS      (1u << 0)  // D2H register FIS (non-queued completion)
+#define PORT_IS_SDBS      (1u << 3)  // Set Device Bits FIS (NCQ completion)
+#define PORT_IS_IFS       (1u << 27)
+#define PORT_IS_HBDS      (1u << 28)
+#define PORT_IS_HBFS      (1u << 29)
+#define PORT_IS_TFES      (1u << 30)
+#define PORT_IS_ERRORS    (PORT_IS_IFS | PORT_IS_HBDS | PORT_IS_HBFS | PORT_IS_TFES)
+
+#define CMD_HDR_CFL       (sizeof(ahci_fis_h2d_t) / 4)
+#define CMD_HDR_WRITE     0x0040
+#define PRD_MAX_BYTES     (4u * 1024 * 1024)
+
+// --- ATA ---
+#define FIS_TYPE_REG_H2D      0x27
+#define FIS_H2D_COMMAND       0x80
+#define ATA_CMD_IDENTIFY      0xEC
+#define ATA_CMD_READ_DMA_EXT  0x25
+#define ATA_CMD_WRITE_DMA_EXT 0x35
+#define ATA_CMD_READ_FPDMA    0x60 // READ FPDMA QUEUED
+#define ATA_CMD_WRITE_FPDMA   0x61 // WRITE FPDMA QUEUED
+#define ATA_DEV_LBA           0x40
+#define ATA_DEV_FUA           0x80 // NCQ write: forced unit access (no cache flush needed)
+
+#define ID_QUEUE_DEPTH   75  // IDENTIFY words
+#define ID_SATA_CAPS     76
+#define ID_SATA_CAP_NCQ  (1u << 8)
+#define ID_CMD_SET_2     83
+#define ID_CMD_SET_LBA48 (1u << 10)
+#define ID_LBA28_SECTORS 60
+#define ID_LBA48_SECTORS 100
+
+#define AHCI_POLL_LIMIT  1000000
+
+// --- Module State ---
+static ahci_hba_t *hba = 0;
+static ahci_port_regs_t *port = 0;
+static uint32_t port_no = 0;
+static ahci_cmd_header_t cmd_list[AHCI_MAX_SLOTS] __attribute__((aligned(1024)));
+static uint8_t fis_area[256] __attribute__((aligned(256)));
+static ahci_cmd_table_t cmd_tables[AHCI_MAX_SLOTS] __attribute__((aligned(128)));
+static uint16_t identify_data[256] __attribute__((aligned(4)));
+
+static blk_queue_t ahci_queue;
+static blkdev_t ahci_dev;                          // "sd0" in the block-device registry
+static int ahci_ready = 0;
+static spinlock_t ahci_lock = SPINLOCK_INIT;       // Guards the slot state below
+static blk_request_t *slot_rq[AHCI_MAX_SLOTS];
+static uint32_t slots_busy = 0;                    // Claimed by ahci_issue()
+static uint32_t slots_issued = 0;                  // Written to PxCI, awaiting completion
+static uint32_t queue_depth = 1;
+static int use_ncq = 0;
+static uint32_t capacity = 0;
+
+// --- Port Control ---
+static int wait_clear(volatile uint32_t *reg, uint32_t bits) {
+    for (int i = 0; i < AHCI_POLL_LIMIT; ++i) {
+        if (!(*reg & bits)) return 0;
+        asm volatile("pause");
+    }
+    return -1;
+}
+
+static void port_stop(void) {
+    port->cmd &= ~PORT_CMD_ST;
+    wait_clear(&port->cmd, PORT_CMD_CR);
+    port->cmd &= ~PORT_CMD_FRE;
+    wait_clear(&port->cmd, PORT_CMD_FR);
+}
+
+static int port_start(void) {
+    if (wait_clear(&port->tfd, PORT_TFD_BSY | PORT_TFD_DRQ) != 0) return -1;
+    port->cmd |= PORT_CMD_FRE;
+    port->cmd |= PORT_CMD_ST;
+    return 0;
+}
+
+// Clears errors and restarts the command engine; every outstanding command
+// has been aborted by then (the drive drops its whole NCQ queue on error).
+static void port_recover(void) {
+    port_stop();
+    port->serr = 0xFFFFFFFF;
+    port->is = 0xFFFFFFFF;
+    if (port_start() != 0) term_writestring("AHCI: port stuck busy after error (needs COMRESET)\n");
+}
+
+// --- Command Construction ---
+static void build_fis(ahci_cmd_table_t *t, uint8_t command, uint32_t lba, uint16_t count, uint8_t device) {
+    memset(t->cfis, 0, sizeof(t->cfis));
+    ahci_fis_h2d_t *fis = (ahci_fis_h2d_t*)t->cfis;
+    fis->type = FIS_TYPE_REG_H2D;
+    fis->pm_c = FIS_H2D_COMMAND;
+    fis->command = command;
+    fis->device = device;
+    fis->lba0 = (uint8_t)lba;
+    fis->lba1 = (uint8_t)(lba >> 8);
+    fis->lba2 = (uint8_t)(lba >> 16);
+    fis->lba3 = (uint8_t)(lba >> 24);
+    fis->count_low = (uint8_t)count;
+    fis->count_high = (uint8_t)(count >> 8);
+}
+
+static void set_header(uint32_t slot, int write, uint16_t prd_count) {
+    ahci_cmd_header_t *h = &cmd_list[slot];
+    h->flags = (uint16_t)(CMD_HDR_CFL | (write ? CMD_HDR_WRITE : 0));
+    h->prdtl = prd_count;
+    h->prdbc = 0;
+}
+
+// IDENTIFY DEVICE on slot 0, polled (before the port's interrupts are on).
+static int ahci_identify(void) {
+    ahci_cmd_table_t *t = &cmd_tables[0];
+    build_fis(t, ATA_CMD_IDENTIFY, 0, 0, 0);
+    t->prdt[0].dba = (uint32_t)identify_data;
+    t->prdt[0].dbau = 0;
+    t->prdt[0].dbc = sizeof(identify_data) - 1;
+    set_header(0, 0, 1);
+
+    port->is = 0xFFFFFFFF;
+    port->ci = 1;
+    for (int i = 0; i < AHCI_POLL_LIMIT; ++i) {
+        if (port->is & PORT_IS_TFES) break;
+        if (!(port->ci & 1)) break;
+        asm volatile("pause");
+    }
+    int ok = !(port->ci & 1) && !(port->is & PORT_IS_TFES) && !(port->tfd & PORT_TFD_ERR);
+    port->is = 0xFFFFFFFF;
+    if (!ok) { port_recover(); return -1; }
+    return 0;
+}
+
+// --- Queue Hook ---
+// Runs on the queue's worker: fill a free slot and start it. The queue never
+// has more than queue_depth transfers in flight, so a slot is always free.
+static void ahci_issue(blk_queue_t *q, blk_request_t *rq) {
+    uint32_t flags = spin_lock_irqsave(&ahci_lock);
+    uint32_t slot = 0;
+    while (slot < queue_depth && (slots_busy & (1u << slot))) slot++;
+    if (slot == queue_depth) {
+        spin_unlock_irqrestore(&ahci_lock, flags);
+        blk_queue_complete(q, rq, -1);
+        return;
+    }
+    slots_busy |= 1u << slot;
+    slot_rq[slot] = rq;
+    spin_unlock_irqrestore(&ahci_lock, flags);
+
+    int write = (rq->op == BLK_WRITE);
+    ahci_cmd_table_t *t = &cmd_tables[slot];
+    uint16_t n = 0;
+    for (blk_request_t *seg = rq; seg && n < AHCI_MAX_PRDT; seg = seg->merge_next, ++n) {
+        t->prdt[n].dba = (uint32_t)seg->buffer;
+        t->prdt[n].dbau = 0;
+        t->prdt[n].reserved = 0;
+        t->prdt[n].dbc = seg->count * BLK_SECTOR_SIZE - 1; // <= AHCI_MAX_SECTORS * 512 < PRD_MAX_BYTES
+    }
+    uint16_t count = (uint16_t)rq->merged_count;
+    if (use_ncq) {
+        // Sector count moves to the features field; the count field carries the tag.
+        build_fis(t, write ? ATA_CMD_WRITE_FPDMA : ATA_CMD_READ_FPDMA, rq->lba, (uint16_t)(slot << 3),
+                  (uint8_t)(ATA_DEV_LBA | (write ? ATA_DEV_FUA : 0)));
+        ahci_fis_h2d_t *fis = (ahci_fis_h2d_t*)t->cfis;
+        fis->feature_low = (uint8_t)count;
+        fis->feature_high = (uint8_t)(count >> 8);
+    } else {
+        build_fis(t, write ? ATA_CMD_WRITE_DMA_EXT : ATA_CMD_READ_DMA_EXT, rq->lba, count, ATA_DEV_LBA);
+    }
+    set_header(slot, write, n);
+
+    flags = spin_lock_irqsave(&ahci_lock);
+    if (use_ncq) port->sact = 1u << slot; // SActive before CI for queued commands
+    port->ci = 1u << slot;
+    slots_issued |= 1u << slot;
+    spin_unlock_irqrestore(&ahci_lock, flags);
+}
+
+// --- Interrupt Handler ---
+static void ahci_irq(interrupt_frame_t *frame) {
+    (void)frame;
+    blk_request_t *done[AHCI_MAX_SLOTS];
+    uint32_t ndone = 0;
+    int status = 0;
+
+    uint32_t flags = spin_lock_irqsave(&ahci_lock);
+    uint32_t is = port->is;
+    port->is = is;                 // Write-1-to-clear, port level first
+    hba->is = 1u << port_no;
+
+    uint32_t finished;
+    if (is & PORT_IS_ERRORS) {
+        term_writestring("AHCI: error, IS "); term_print_hex(is);
+        term_writestring(" TFD "); term_print_hex(port->tfd); term_putchar('\n');
+        finished = slots_issued; // All outstanding commands were aborted
+        status = -1;
+        port_recover();
+    } else {
+        finished = slots_issued & ~(port->sact | port->ci);
+    }
+    for (uint32_t slot = 0; slot < queue_depth; ++slot) {
+        if (!(finished & (1u << slot))) continue;
+        done[ndone++] = slot_rq[slot];
+        slot_rq[slot] = NULL;
+    }
+    slots_issued &= ~finished;
+    slots_busy &= ~finished;
+    spin_unlock_irqrestore(&ahci_lock, flags);
+
+    for (uint32_t i = 0; i < ndone; ++i) blk_queue_complete(&ahci_queue, done[i], status);
+}
+
+// --- Block Device ---
+static int ahci_geometry(blkdev_t *dev, blkdev_geometry_t *out) {
+    (void)dev;
+    out->sector_size = BLK_SECTOR_SIZE;
+    out->sector_count = capacity;
+    return 0;
+}
+
+static const blkdev_ops_t ahci_ops = { blkdev_queue_read, blkdev_queue_write, blkdev_queue_flush, ahci_geometry };
+
+// --- Public Functions ---
+int ahci_initialize(void) {
+    pci_device_t dev;
+    if (pci_find_class(PCI_CLASS_STORAGE, PCI_SUBCLASS_SATA, PCI_PROGIF_AHCI, &dev) != 0) return -1;
+    pci_enable_bus_master(&dev);
+    hba = (ahci_hba_t*)pci_bar_address(&dev, AHCI_ABAR_BAR);
+    hba->ghc |= HBA_GHC_AE;
+
+    // First implemented port with an established link to a SATA disk.
+    uint32_t pi = hba->pi;
+    for (port_no = 0; port_no < 32; ++port_no) {
+        if (!(pi & (1u << port_no))) continue;
+        ahci_port_regs_t *p = &hba->ports[port_no];
+        if ((p->ssts & PORT_SSTS_DET_MASK) == PORT_SSTS_DET_OK && p->sig == PORT_SIG_SATA) break;
+    }
+    if (port_no == 32) {
+        term_writestring("AHCI: controller found, no SATA disk attached\n");
+        return -1;
+    }
+    port = &hba->ports[port_no];
+
+    port_stop();
+    memset(cmd_list, 0, sizeof(cmd_list));
+    memset(fis_area, 0, sizeof(fis_area));
+    memset(cmd_tables, 0, sizeof(cmd_tables));
+    for (uint32_t i = 0; i < AHCI_MAX_SLOTS; ++i) {
+        cmd_list[i].ctba = (uint32_t)&cmd_tables[i];
+        cmd_list[i].ctbau = 0;
+    }
+    port->clb = (uint32_t)cmd_list; port->clbu = 0;
+    port->fb = (uint32_t)fis_area; port->fbu = 0;
+    port->serr = 0xFFFFFFFF;
+    port->is = 0xFFFFFFFF;
+    port->ie = 0;
+    if (port_start() != 0 || ahci_identify() != 0) {
+        term_writestring("AHCI: IDENTIFY failed\n");
+        return -1;
+    }
+
+    if (identify_data[ID_CMD_SET_2] & ID_CMD_SET_LBA48) capacity = identify_data[ID_LBA48_SECTORS] | ((uint32_t)identify_data[ID_LBA48_SECTORS + 1] << 16);
+    else capacity = identify_data[ID_LBA28_SECTORS] | ((uint32_t)identify_data[ID_LBA28_SECTORS + 1] << 16);
+
+    use_ncq = (hba->cap & HBA_CAP_SNCQ) && (identify_data[ID_SATA_CAPS] & ID_SATA_CAP_NCQ);
+    queue_depth = 1;
+    if (use_ncq) {
+        uint32_t dev_depth = (identify_data[ID_QUEUE_DEPTH] & 0x1F) + 1;
+        uint32_t hba_slots = HBA_CAP_NCS(hba->cap);
+        queue_depth = dev_depth < hba_slots ? dev_depth : hba_slots;
+    }
+
+    // MSI goes straight to the BSP's LAPIC; the legacy INTx line is only usable
+    // through the 8259 (the I/O APIC has ISA-style edge routing for IRQs 0-15).
+    if (smp_active() && pci_enable_msi(&dev, VECTOR_MSI_BASE, this_cpu()->apic_id) == 0) {
+        local_vector_register_handler(VECTOR_MSI_BASE, ahci_irq);
+    } else if (!smp_active() && dev.irq_line < IRQ_COUNT) {
+        irq_register_handler(dev.irq_line, ahci_irq);
+    } else {
+        term_writestring("AHCI: no usable interrupt\n");
+        return -1;
+    }
+    port->ie = PORT_IS_DHRS | PORT_IS_SDBS | PORT_IS_ERRORS;
+    hba->ghc |= HBA_GHC_IE;
+
+    if (blk_queue_init(&ahci_queue, "sd0", ahci_issue, NULL, AHCI_MAX_SECTORS, queue_depth) != 0) return -1;
+    ahci_queue.max_segments = AHCI_MAX_PRDT;
+    memset(&ahci_dev, 0, sizeof(ahci_dev));
+    strncpy(ahci_dev.name, "sd0", BLKDEV_NAME_LEN - 1);
+    ahci_dev.ops = &ahci_ops;
+    ahci_dev.queue = &ahci_queue;
+    if (blkdev_register(&ahci_dev) != 0) return -1;
+    ahci_ready = 1;
+
+    term_writestring("AHCI: port "); term_print_dec(port_no);
+    term_writestring(", "); term_print_dec(capacity / 2048); term_writestring(" MiB, ");
+    if (use_ncq) { term_writestring("NCQ depth "); term_print_dec(queue_depth); }
+    else term_writestring("no NCQ");
+    term_writestring(" (device sd0)\n");
+    return 0;
+}
+
+blk_queue_t *ahci_get_queue(void) { return ahci_ready ? &ahci_queue : NULL; }
+blkdev_t *ahci_get_device(void) { return ahci_ready ? &ahci_dev : NULL; }
+uint32_t ahci_get_capacity(void) { return capacity; }
+uint32_t ahci_get_queue_depth(void) { return queue_depth; }
@@ -0,0 +1,94 @@
+// kernel/ahci.h
+// AHCI (SATA) driver: command list + FIS receive area per port, PRDT
+// scatter-gather, native command queuing with interrupt-driven completion.
+// Readably formatted.
+
+#ifndef AHCI_H
+#define AHCI_H
+
+#include <stdint.h>
+#include "blkq.h"
+#include "blkdev.h"
+
+#define AHCI_MAX_SLOTS    32   // Command slots per port (upper bound for NCQ depth)
+#define AHCI_MAX_PRDT     32   // Scatter-gather entries per command (one per merged request)
+#define AHCI_MAX_SECTORS  1024 // Sectors per command (512 KiB)
+
+// --- HBA Memory Registers (ABAR, PCI BAR5) ---
+typedef volatile struct {
+    uint32_t clb, clbu;     // Command list base (1 KiB aligned)
+    uint32_t fb, fbu;       // FIS receive base (256 B aligned)
+    uint32_t is, ie;        // Interrupt status / enable
+    uint32_t cmd;           // Command and status
+    uint32_t reserved0;
+    uint32_t tfd;           // Task file data (status/error)
+    uint32_t sig;           // Device signature
+    uint32_t ssts, sctl, serr, sact;
+    uint32_t ci;            // Command issue
+    uint32_t sntf, fbs;
+    uint32_t reserved1[11];
+    uint32_t vendor[4];
+} ahci_port_regs_t;
+
+typedef volatile struct {
+    uint32_t cap, ghc, is, pi, vs;
+    uint32_t ccc_ctl, ccc_pts, em_loc, em_ctl, cap2, bohc;
+    uint8_t  reserved[0xA0 - 0x2C];
+    uint8_t  vendor[0x100 - 0xA0];
+    ahci_port_regs_t ports[32];
+} ahci_hba_t;
+
+// --- In-Memory Structures (DMA) ---
+typedef struct __attribute__((packed)) {
+    uint16_t flags;         // CFL (FIS dwords, 4:0), A, W (6), P, R, B, C, PMP
+    uint16_t prdtl;         // PRDT entries
+    volatile uint32_t prdbc; // Bytes transferred (written by the HBA)
+    uint32_t ctba, ctbau;   // Command table base (128 B aligned)
+    uint32_t reserved[4];
+} ahci_cmd_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t dba, dbau;     // Data base address (word aligned)
+    uint32_t reserved;
+    uint32_t dbc;           // Byte count - 1 (bit 0 must be 1), bit 31: interrupt on completion
+} ahci_prd_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t cfis[64];       // Command FIS
+    uint8_t acmd[16];       // ATAPI command
+    uint8_t reserved[48];
+    ahci_prd_t prdt[AHCI_MAX_PRDT];
+} ahci_cmd_table_t;
+
+// Host-to-device register FIS
+typedef struct __attribute__((packed)) {
+    uint8_t type;           // FIS_TYPE_REG_H2D
+    uint8_t pm_c;           // Bit 7: command (vs. control) update
+    uint8_t command;
+    uint8_t feature_low;
+    uint8_t lba0, lba1, lba2;
+    uint8_t device;
+    uint8_t lba3, lba4, lba5;
+    uint8_t feature_high;
+    uint8_t count_low, count_high;
+    uint8_t icc, control;
+    uint8_t reserved[4];
+} ahci_fis_h2d_t;
+
+// --- Function Prototypes ---
+
+// Finds the AHCI controller on PCI and the first port with a SATA disk,
+// identifies it, starts its request queue and registers block device "sd0".
+// Needs the scheduler and, for MSI delivery, smp_init(). Returns 0, or -1
+// if there is no usable controller/disk (callers fall back to IDE).
+int ahci_initialize(void);
+
+// Request queue / block device of the disk (NULL before a successful ahci_initialize()).
+blk_queue_t *ahci_get_queue(void);
+blkdev_t *ahci_get_device(void);
+
+// Capacity in sectors and NCQ depth (1 = no NCQ) of the disk.
+uint32_t ahci_get_capacity(void);
+uint32_t ahci_get_queue_depth(void);
+
+#endif // AHCI_H
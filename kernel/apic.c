@@ -0,0 +1,172 @@
+// kernel/apic.c
+// Local APIC and I/O APIC register access. The MMIO windows are reached
+// through the identity mapping, which uses uncached 4 MiB pages above RAM.
+// Readably formatted.
+
+#include "apic.h"
+#include "idt.h"
+#include "timer.h"
+#include "io.h"
+#include <stdint.h>
+
+// --- Local APIC Registers (offsets from base) ---
+#define LAPIC_ID          0x020
+#define LAPIC_TPR         0x080
+#define LAPIC_EOI         0x0B0
+#define LAPIC_SVR         0x0F0
+#define LAPIC_ICR_LOW     0x300
+#define LAPIC_ICR_HIGH    0x310
+#define LAPIC_LVT_TIMER   0x320
+#define LAPIC_TIMER_INIT  0x380
+#define LAPIC_TIMER_CUR   0x390
+#define LAPIC_TIMER_DIV   0x3E0
+
+#define LAPIC_SVR_ENABLE      0x100
+#define LAPIC_ICR_INIT        0x00000500
+#define LAPIC_ICR_STARTUP     0x00000600
+#define LAPIC_ICR_FIXED       0x00000000
+#define LAPIC_ICR_LEVEL_ASSERT 0x00004000
+#define LAPIC_ICR_PENDING     0x00001000
+#define LAPIC_TIMER_PERIODIC  0x00020000
+#define LAPIC_LVT_MASKED      0x00010000
+#define LAPIC_TIMER_DIV_16    0x3
+
+// --- I/O APIC Registers ---
+#define IOAPIC_REGSEL     0x00
+#define IOAPIC_WINDOW     0x10
+#define IOAPIC_REG_VER    0x01
+#define IOAPIC_REDTBL(n)  (0x10 + 2 * (n))
+
+#define IOAPIC_MASKED        0x00010000
+#define IOAPIC_LEVEL         0x00008000
+#define IOAPIC_ACTIVE_LOW    0x00002000
+#define IOAPIC_NO_GSI        0xFFFFFFFF // ISA IRQ has no I/O APIC pin
+
+// --- Module State ---
+static volatile uint32_t *lapic = 0;
+static volatile uint32_t *ioapic = 0;
+static uint32_t ioapic_gsi_base = 0;
+static uint32_t lapic_ticks_per_tick = 0; // LAPIC timer counts per TIMER_HZ tick
+static uint32_t irq_to_gsi[IRQ_COUNT];
+static uint32_t irq_redir_flags[IRQ_COUNT];
+static uint8_t ioapic_dest = 0;
+static volatile int lapic_timer_running = 0;
+
+// --- Local APIC ---
+static inline uint32_t lapic_read(uint32_t reg) { return lapic[reg / 4]; }
+static inline void lapic_write(uint32_t reg, uint32_t val) { lapic[reg / 4] = val; (void)lapic[LAPIC_ID / 4]; }
+
+static void lapic_wait_icr(void) {
+    while (lapic_read(LAPIC_ICR_LOW) & LAPIC_ICR_PENDING) asm volatile("pause");
+}
+
+void lapic_set_base(uint32_t base) { lapic = (volatile uint32_t*)base; }
+
+void lapic_enable(void) {
+    lapic_write(LAPIC_TPR, 0);
+    lapic_write(LAPIC_SVR, LAPIC_SVR_ENABLE | VECTOR_SPURIOUS);
+}
+
+uint32_t lapic_id(void) { return lapic ? (lapic_read(LAPIC_ID) >> 24) : 0; }
+
+void lapic_eoi(void) { lapic_write(LAPIC_EOI, 0); }
+
+void lapic_send_init(uint32_t apic_id) {
+    lapic_write(LAPIC_ICR_HIGH, apic_id << 24);
+    lapic_write(LAPIC_ICR_LOW, LAPIC_ICR_INIT | LAPIC_ICR_LEVEL_ASSERT);
+    lapic_wait_icr();
+}
+
+void lapic_send_startup(uint32_t apic_id, uint8_t vector_page) {
+    lapic_write(LAPIC_ICR_HIGH, apic_id << 24);
+    lapic_write(LAPIC_ICR_LOW, LAPIC_ICR_STARTUP | vector_page);
+    lapic_wait_icr();
+}
+
+void lapic_send_ipi(uint32_t apic_id, uint8_t vector) {
+    uint32_t flags = irq_save(); // ICR high/low must be written back to back
+    lapic_write(LAPIC_ICR_HIGH, apic_id << 24);
+    lapic_write(LAPIC_ICR_LOW, LAPIC_ICR_FIXED | LAPIC_ICR_LEVEL_ASSERT | vector);
+    lapic_wait_icr();
+    irq_restore(flags);
+}
+
+void lapic_timer_calibrate(void) {
+    lapic_write(LAPIC_TIMER_DIV, LAPIC_TIMER_DIV_16);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED | VECTOR_LAPIC_TIMER);
+
+    // Count down from the maximum over 10 PIT ticks, starting on a tick edge.
+    uint32_t start = timer_ticks();
+    while (timer_ticks() == start) asm volatile("pause");
+    lapic_write(LAPIC_TIMER_INIT, 0xFFFFFFFF);
+    start = timer_ticks();
+    while (timer_ticks() - start < 10) asm volatile("pause");
+    uint32_t elapsed = 0xFFFFFFFF - lapic_read(LAPIC_TIMER_CUR);
+    lapic_write(LAPIC_TIMER_INIT, 0);
+
+    lapic_ticks_per_tick = elapsed / 10;
+    term_writestring("APIC: timer "); term_print_dec(lapic_ticks_per_tick);
+    term_writestring(" counts/tick\n");
+}
+
+void lapic_timer_start(void) {
+    if (lapic_ticks_per_tick == 0) return;
+    lapic_write(LAPIC_TIMER_DIV, LAPIC_TIMER_DIV_16);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_TIMER_PERIODIC | VECTOR_LAPIC_TIMER);
+    lapic_write(LAPIC_TIMER_INIT, lapic_ticks_per_tick);
+    lapic_timer_running = 1;
+}
+
+int lapic_timer_active(void) { return lapic_timer_running; }
+
+// --- I/O APIC ---
+static uint32_t ioapic_read(uint8_t reg) { ioapic[IOAPIC_REGSEL / 4] = reg; return ioapic[IOAPIC_WINDOW / 4]; }
+static void ioapic_write(uint8_t reg, uint32_t val) { ioapic[IOAPIC_REGSEL / 4] = reg; ioapic[IOAPIC_WINDOW / 4] = val; }
+
+static int irq_routable(uint8_t irq, uint32_t pins) {
+    return irq_to_gsi[irq] != IOAPIC_NO_GSI && irq_to_gsi[irq] >= ioapic_gsi_base && irq_to_gsi[irq] - ioapic_gsi_base < pins;
+}
+
+static void ioapic_program(uint8_t irq, int masked) {
+    uint32_t pin = irq_to_gsi[irq] - ioapic_gsi_base;
+    uint32_t low = (uint32_t)(IRQ_BASE_VECTOR + irq) | irq_redir_flags[irq] | (masked ? IOAPIC_MASKED : 0);
+    ioapic_write((uint8_t)(IOAPIC_REDTBL(pin) + 1), (uint32_t)ioapic_dest << 24);
+    ioapic_write((uint8_t)IOAPIC_REDTBL(pin), low);
+}
+
+void ioapic_init(const acpi_madt_info_t *madt, uint8_t dest_apic_id) {
+    ioapic = (volatile uint32_t*)madt->ioapic_address;
+    ioapic_gsi_base = madt->ioapic_gsi_base;
+    ioapic_dest = dest_apic_id;
+    uint32_t pins = ((ioapic_read(IOAPIC_REG_VER) >> 16) & 0xFF) + 1;
+
+    // ISA IRQs are identity-mapped, edge-triggered, active-high unless overridden.
+    for (uint8_t irq = 0; irq < IRQ_COUNT; ++irq) {
+        irq_to_gsi[irq] = ioapic_gsi_base + irq;
+        irq_redir_flags[irq] = 0;
+    }
+    for (uint32_t i = 0; i < madt->override_count; ++i) {
+        const acpi_irq_override_t *o = &madt->overrides[i];
+        if (o->source_irq >= IRQ_COUNT) continue;
+        irq_to_gsi[o->source_irq] = o->gsi;
+        uint32_t f = 0;
+        if ((o->flags & ACPI_MADT_POLARITY_MASK) == ACPI_MADT_POLARITY_LOW) f |= IOAPIC_ACTIVE_LOW;
+        if ((o->flags & ACPI_MADT_TRIGGER_MASK) == ACPI_MADT_TRIGGER_LEVEL) f |= IOAPIC_LEVEL;
+        irq_redir_flags[o->source_irq] = f;
+        // An identity-mapped IRQ whose pin was taken over (QEMU: IRQ0 -> GSI2) loses its route.
+        if (o->gsi - ioapic_gsi_base < IRQ_COUNT && o->gsi - ioapic_gsi_base != o->source_irq) {
+            irq_to_gsi[o->gsi - ioapic_gsi_base] = IOAPIC_NO_GSI;
+        }
+    }
+    // Re-apply overrides: an entry cleared above may itself have been overridden.
+    for (uint32_t i = 0; i < madt->override_count; ++i) {
+        if (madt->overrides[i].source_irq < IRQ_COUNT) irq_to_gsi[madt->overrides[i].source_irq] = madt->overrides[i].gsi;
+    }
+    for (uint8_t irq = 0; irq < IRQ_COUNT; ++irq) {
+        if (irq_routable(irq, pins)) ioapic_program(irq, 1);
+        else irq_to_gsi[irq] = IOAPIC_NO_GSI;
+    }
+}
+
+void ioapic_unmask(uint8_t irq) { if (ioapic && irq < IRQ_COUNT && irq_to_gsi[irq] != IOAPIC_NO_GSI) ioapic_program(irq, 0); }
+void ioapic_mask(uint8_t irq) { if (ioapic && irq < IRQ_COUNT && irq_to_gsi[irq] != IOAPIC_NO_GSI) ioapic_program(irq, 1); }
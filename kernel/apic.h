@@ -0,0 +1,37 @@
+// kernel/apic.h
+// Local APIC (per CPU: EOI, IPIs, timer) and I/O APIC (ISA IRQ routing). Readably formatted.
+
+#ifndef APIC_H
+#define APIC_H
+
+#include <stdint.h>
+#include "acpi.h"
+
+// --- Local APIC ---
+// Records the LAPIC MMIO base (from the MADT). Call once on the BSP.
+void lapic_set_base(uint32_t base);
+// Software-enables the LAPIC of the calling CPU (spurious vector, TPR 0).
+void lapic_enable(void);
+uint32_t lapic_id(void);
+void lapic_eoi(void);
+// INIT / STARTUP IPIs used to boot application processors.
+void lapic_send_init(uint32_t apic_id);
+void lapic_send_startup(uint32_t apic_id, uint8_t vector_page);
+// Fixed-delivery IPI with 'vector' to one CPU.
+void lapic_send_ipi(uint32_t apic_id, uint8_t vector);
+
+// Measures the LAPIC timer rate against the PIT tick (BSP, interrupts on).
+void lapic_timer_calibrate(void);
+// Starts the periodic per-CPU timer at TIMER_HZ (after calibration).
+void lapic_timer_start(void);
+// Non-zero once a LAPIC timer drives the scheduler quantum (the PIT no longer does).
+int lapic_timer_active(void);
+
+// --- I/O APIC ---
+// Programs all ISA IRQs (honouring MADT overrides) masked, routed to
+// 'dest_apic_id' on vectors IRQ_BASE_VECTOR + irq.
+void ioapic_init(const acpi_madt_info_t *madt, uint8_t dest_apic_id);
+void ioapic_unmask(uint8_t irq);
+void ioapic_mask(uint8_t irq);
+
+#endif // APIC_H
@@ -0,0 +1,118 @@
+// kernel/blkdev.c
+// Block-device registry and range-checked dispatch to the backend ops. Readably formatted.
+
+#include "blkdev.h"
+#include "spinlock.h"
+#include "io.h"
+#include "string.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// --- Module State ---
+static blkdev_t *devices[BLKDEV_MAX];
+static spinlock_t registry_lock = SPINLOCK_INIT;
+
+// --- Helpers ---
+static int in_range(const blkdev_t *dev, uint32_t lba, uint32_t count) {
+    return count <= dev->geometry.sector_count && lba <= dev->geometry.sector_count - count;
+}
+
+// --- Registry ---
+int blkdev_register(blkdev_t *dev) {
+    if (!dev || !dev->ops || !dev->ops->read || !dev->ops->geometry || !dev->name[0]) return -1;
+    if (dev->ops->geometry(dev, &dev->geometry) != 0 || dev->geometry.sector_size != BLK_SECTOR_SIZE) return -1;
+    memset(&dev->stats, 0, sizeof(dev->stats));
+
+    uint32_t flags = spin_lock_irqsave(&registry_lock);
+    int slot = -1;
+    for (int i = 0; i < BLKDEV_MAX; ++i) {
+        if (devices[i] && strcmp(devices[i]->name, dev->name) == 0) { slot = -1; break; }
+        if (!devices[i] && slot < 0) slot = i;
+    }
+    if (slot >= 0) devices[slot] = dev;
+    spin_unlock_irqrestore(&registry_lock, flags);
+    if (slot < 0) return -1;
+
+    term_writestring("blkdev: "); term_writestring(dev->name); term_writestring(", ");
+    term_print_dec(dev->geometry.sector_count / 2048); term_writestring(" MiB\n");
+    return 0;
+}
+
+blkdev_t *blkdev_find(const char *name) {
+    if (!name) return NULL;
+    for (int i = 0; i < BLKDEV_MAX; ++i) {
+        if (devices[i] && strcmp(devices[i]->name, name) == 0) return devices[i];
+    }
+    return NULL;
+}
+
+blkdev_t *blkdev_get(int index) {
+    if (index < 0 || index >= BLKDEV_MAX) return NULL;
+    return devices[index];
+}
+
+// --- I/O ---
+int blkdev_read(blkdev_t *dev, uint32_t lba, uint32_t count, void *buffer) {
+    if (!dev || !buffer) return -1;
+    if (count == 0) return 0;
+    if (!in_range(dev, lba, count)) return -1;
+    int r = dev->ops->read(dev, lba, count, buffer);
+    dev->stats.reads++;
+    if (r == 0) dev->stats.sectors_read += count; else dev->stats.errors++;
+    return r;
+}
+
+int blkdev_write(blkdev_t *dev, uint32_t lba, uint32_t count, const void *buffer) {
+    if (!dev || !buffer || !dev->ops->write) return -1;
+    if (count == 0) return 0;
+    if (!in_range(dev, lba, count)) return -1;
+    int r = dev->ops->write(dev, lba, count, buffer);
+    dev->stats.writes++;
+    if (r == 0) dev->stats.sectors_written += count; else dev->stats.errors++;
+    return r;
+}
+
+// Completion of a blkdev_submit_read() request: counts the sectors once they
+// are actually read, then hands the request back to the submitter.
+static void submit_read_done(blk_request_t *rq, int status) {
+    blkdev_t *dev = (blkdev_t*)rq->dev;
+    if (status == 0) dev->stats.sectors_read += rq->count; else dev->stats.errors++;
+    rq->done = rq->caller_done;
+    if (rq->done) rq->done(rq, status);
+}
+
+int blkdev_submit_read(blkdev_t *dev, blk_request_t *rq) {
+    if (!dev || !dev->queue || !rq || !rq->buffer || rq->count == 0) return -1;
+    if (!in_range(dev, rq->lba, rq->count)) return -1;
+    rq->op = BLK_READ;
+    rq->dev = dev;
+    rq->caller_done = rq->done;
+    rq->done = submit_read_done;
+    dev->stats.reads++; // Before submitting: the completion may run first
+    if (blk_submit(dev->queue, rq) != 0) {
+        rq->done = rq->caller_done;
+        dev->stats.errors++;
+        return -1;
+    }
+    return 0;
+}
+
+int blkdev_flush(blkdev_t *dev) {
+    if (!dev) return -1;
+    dev->stats.flushes++;
+    return dev->ops->flush ? dev->ops->flush(dev) : 0;
+}
+
+// --- Queue-Backed Helpers ---
+int blkdev_queue_read(blkdev_t *dev, uint32_t lba, uint32_t count, void *buffer) {
+    return blk_transfer_sync(dev->queue, BLK_READ, lba, count, buffer);
+}
+
+int blkdev_queue_write(blkdev_t *dev, uint32_t lba, uint32_t count, const void *buffer) {
+    return blk_transfer_sync(dev->queue, BLK_WRITE, lba, count, (void*)buffer);
+}
+
+int blkdev_queue_flush(blkdev_t *dev) {
+    (void)dev;
+    return 0;
+}
@@ -0,0 +1,76 @@
+// kernel/blkdev.h
+// Block-device layer: every disk-like backend (IDE, AHCI, RAM disk, ...)
+// registers a blkdev_t with an ops table, and filesystems talk to a device
+// handle instead of a particular driver. Readably formatted.
+
+#ifndef BLKDEV_H
+#define BLKDEV_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "blkq.h"
+
+#define BLKDEV_MAX      8
+#define BLKDEV_NAME_LEN 8
+
+typedef struct blkdev blkdev_t;
+
+typedef struct {
+    uint32_t sector_size;   // Bytes per sector (always BLK_SECTOR_SIZE for now)
+    uint32_t sector_count;  // Capacity in sectors
+} blkdev_geometry_t;
+
+// Backend operations. read/write block the calling thread until the data
+// is transferred and return 0 or a negative error. flush returns once
+// everything written so far is on stable storage.
+typedef struct {
+    int (*read)(blkdev_t *dev, uint32_t lba, uint32_t count, void *buffer);
+    int (*write)(blkdev_t *dev, uint32_t lba, uint32_t count, const void *buffer);
+    int (*flush)(blkdev_t *dev);
+    int (*geometry)(blkdev_t *dev, blkdev_geometry_t *out);
+} blkdev_ops_t;
+
+typedef struct {
+    uint32_t reads, writes, flushes;  // Calls through blkdev_read/write/flush
+    uint32_t sectors_read, sectors_written;
+    uint32_t errors;
+} blkdev_stats_t;
+
+struct blkdev {
+    char name[BLKDEV_NAME_LEN];
+    const blkdev_ops_t *ops;
+    void *driver_data;
+    blk_queue_t *queue;             // Request queue behind it, if any (async users, iostat)
+    blkdev_geometry_t geometry;     // Cached by blkdev_register()
+    blkdev_stats_t stats;
+};
+
+// Adds 'dev' (name, ops, driver_data and queue filled in; storage owned by
+// the caller) to the registry. Returns 0, or -1 if the name is taken, the
+// registry is full or the geometry cannot be read.
+int blkdev_register(blkdev_t *dev);
+
+// Registry lookup by name ("hd0", "sd0", "ram0", ...) or by index (0..BLKDEV_MAX-1).
+blkdev_t *blkdev_find(const char *name);
+blkdev_t *blkdev_get(int index);
+
+// Range-checked entry points used by filesystems.
+int blkdev_read(blkdev_t *dev, uint32_t lba, uint32_t count, void *buffer);
+int blkdev_write(blkdev_t *dev, uint32_t lba, uint32_t count, const void *buffer);
+int blkdev_flush(blkdev_t *dev);
+
+// Asynchronous read through the device's request queue: 'rq' has lba,
+// count (<= queue max_sectors), buffer and done filled in, op is set here.
+// Returns 0 (done runs later), or -1 if the device has no queue or the
+// range is bad. Counted in the stats like blkdev_read(), the sectors when
+// the read completes.
+int blkdev_submit_read(blkdev_t *dev, blk_request_t *rq);
+
+// Ready-made read/write/flush for drivers whose devices sit behind a
+// blk_queue_t (dev->queue). Writes complete on the medium (the drivers flush
+// or use FUA per transfer), so flush has nothing left to do.
+int blkdev_queue_read(blkdev_t *dev, uint32_t lba, uint32_t count, void *buffer);
+int blkdev_queue_write(blkdev_t *dev, uint32_t lba, uint32_t count, const void *buffer);
+int blkdev_queue_flush(blkdev_t *dev);
+
+#endif // BLKDEV_H
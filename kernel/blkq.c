@@ -0,0 +1,286 @@
+// kernel/blkq.c
+// Block request queue with a C-LOOK elevator, front/back merging, deadlines and
+// ordering of overlapping requests. One dispatch thread per queue hands merged
+// transfers to the driver. Queue state is protected by the worker wait queue's
+// spinlock (q->worker_wait.lock), taken with interrupts off.
+// Readably formatted.
+
+#include "blkq.h"
+#include "timer.h"
+#include "io.h"
+#include "string.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define BLK_SYNC_BATCH 8 // Requests submitted together by blk_transfer_sync()
+
+// --- Helpers (queue lock held) ---
+static int ranges_overlap(uint32_t a_lba, uint32_t a_count, uint32_t b_lba, uint32_t b_count) {
+    return a_lba < b_lba + b_count && b_lba < a_lba + a_count;
+}
+
+// Latest request on the list starting at 'head' (linked through the field at
+// 'link_offset', merge chains included) that 'rq' must not overtake: any
+// overlap where at least one side is a write. Returns its seq, or 0.
+static uint32_t find_conflict(blk_request_t *head, size_t link_offset, const blk_request_t *rq) {
+    uint32_t seq = 0;
+    for (blk_request_t *h = head; h; h = *(blk_request_t**)((uint8_t*)h + link_offset)) {
+        for (blk_request_t *r = h; r; r = r->merge_next) {
+            if (r->op == BLK_READ && rq->op == BLK_READ) continue;
+            if (ranges_overlap(r->lba, r->count, rq->lba, rq->count) && r->seq > seq) seq = r->seq;
+        }
+    }
+    return seq;
+}
+
+static int seq_outstanding(const blk_queue_t *q, uint32_t seq) {
+    for (blk_request_t *h = q->fifo_head; h; h = h->fifo_next)
+        for (blk_request_t *r = h; r; r = r->merge_next) if (r->seq == seq) return 1;
+    for (blk_request_t *h = q->flight; h; h = h->flight_next)
+        for (blk_request_t *r = h; r; r = r->merge_next) if (r->seq == seq) return 1;
+    return 0;
+}
+
+static int dispatchable(const blk_queue_t *q, blk_request_t *rq) {
+    if (rq->after_seq == 0) return 1;
+    if (seq_outstanding(q, rq->after_seq)) return 0;
+    rq->after_seq = 0; // Dependency finished; no need to look again
+    return 1;
+}
+
+static void sorted_insert(blk_queue_t *q, blk_request_t *rq) {
+    blk_request_t **pp = &q->sorted;
+    while (*pp && (*pp)->lba <= rq->lba) pp = &(*pp)->sort_next;
+    rq->sort_next = *pp;
+    *pp = rq;
+}
+
+static void sorted_remove(blk_queue_t *q, blk_request_t *rq) {
+    for (blk_request_t **pp = &q->sorted; *pp; pp = &(*pp)->sort_next) {
+        if (*pp == rq) { *pp = rq->sort_next; rq->sort_next = NULL; return; }
+    }
+}
+
+static void fifo_remove(blk_queue_t *q, blk_request_t *rq) {
+    blk_request_t *prev = NULL;
+    for (blk_request_t *it = q->fifo_head; it; prev = it, it = it->fifo_next) {
+        if (it != rq) continue;
+        if (prev) prev->fifo_next = it->fifo_next; else q->fifo_head = it->fifo_next;
+        if (q->fifo_tail == it) q->fifo_tail = prev;
+        it->fifo_next = NULL;
+        return;
+    }
+}
+
+// Tries to join 'rq' to a pending transfer it is contiguous with.
+// Returns 1 if merged (rq is no longer a head of its own).
+static int try_merge(blk_queue_t *q, blk_request_t *rq) {
+    for (blk_request_t *h = q->sorted; h; h = h->sort_next) {
+        if (h->op != rq->op || h->merged_count + rq->count > q->max_sectors) continue;
+        if (q->max_segments && h->merged_segments >= q->max_segments) continue;
+
+        if (h->lba + h->merged_count == rq->lba) { // Back merge: rq continues h
+            h->merge_tail->merge_next = rq;
+            h->merge_tail = rq;
+            h->merged_count += rq->count;
+            h->merged_segments++;
+            return 1;
+        }
+        if (rq->lba + rq->count == h->lba) { // Front merge: rq becomes the new head
+            rq->merge_next = h;
+            rq->merge_tail = h->merge_tail;
+            rq->merged_count = rq->count + h->merged_count;
+            rq->merged_segments = 1 + h->merged_segments;
+            rq->deadline = h->deadline;   // Keep the older deadline
+            rq->after_seq = h->after_seq; // And h's ordering constraint
+            // Take h's place in arrival order, re-sort by the new start LBA.
+            rq->fifo_next = h->fifo_next;
+            if (q->fifo_head == h) q->fifo_head = rq;
+            else for (blk_request_t *it = q->fifo_head; it; it = it->fifo_next) if (it->fifo_next == h) { it->fifo_next = rq; break; }
+            if (q->fifo_tail == h) q->fifo_tail = rq;
+            sorted_remove(q, h);
+            sorted_insert(q, rq);
+            h->fifo_next = NULL;
+            h->merge_tail = NULL;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Chooses the next transfer: an expired deadline first, otherwise C-LOOK
+// (lowest LBA at or after the head position, wrapping to the lowest LBA).
+static blk_request_t *elevator_pick(blk_queue_t *q) {
+    uint32_t now = timer_ticks();
+    blk_request_t *pick = NULL;
+
+    for (blk_request_t *r = q->fifo_head; r; r = r->fifo_next) {
+        if ((int32_t)(now - r->deadline) < 0) continue; // Reads and writes have different deadlines
+        if (dispatchable(q, r)) { pick = r; q->stats.deadline_hits++; break; }
+    }
+    if (!pick) {
+        for (blk_request_t *r = q->sorted; r; r = r->sort_next) {
+            if (r->lba >= q->head_lba && dispatchable(q, r)) { pick = r; break; }
+        }
+    }
+    if (!pick) {
+        for (blk_request_t *r = q->sorted; r && r->lba < q->head_lba; r = r->sort_next) {
+            if (dispatchable(q, r)) { pick = r; break; }
+        }
+    }
+    if (pick) {
+        sorted_remove(q, pick);
+        fifo_remove(q, pick);
+    }
+    return pick;
+}
+
+// --- Dispatch Thread ---
+static void blk_worker(void *arg) {
+    blk_queue_t *q = (blk_queue_t*)arg;
+    for (;;) {
+        uint32_t flags = wait_queue_lock(&q->worker_wait);
+        blk_request_t *rq = NULL;
+        for (;;) {
+            if (q->inflight < q->max_inflight && (rq = elevator_pick(q)) != NULL) break;
+            wait_queue_sleep(&q->worker_wait);
+        }
+        q->stats.depth_sum += q->stats.depth;
+        q->stats.depth--;
+        q->stats.dispatched++;
+        if (rq->op == BLK_READ) q->stats.sectors_read += rq->merged_count;
+        else q->stats.sectors_written += rq->merged_count;
+        q->head_lba = rq->lba + rq->merged_count;
+        rq->flight_next = q->flight;
+        q->flight = rq;
+        q->inflight++;
+        wait_queue_unlock(&q->worker_wait, flags);
+
+        q->issue(q, rq);
+    }
+}
+
+// --- Public Functions ---
+int blk_queue_init(blk_queue_t *q, const char *name, blk_issue_t issue, void *driver_data,
+                   uint32_t max_sectors, uint32_t max_inflight) {
+    memset(q, 0, sizeof(*q));
+    q->name = name;
+    q->issue = issue;
+    q->driver_data = driver_data;
+    q->max_sectors = max_sectors;
+    q->max_inflight = max_inflight ? max_inflight : 1;
+    q->next_seq = 1;
+    q->worker = thread_create(name, blk_worker, q);
+    if (!q->worker) {
+        term_writestring("blkq: no thread for queue "); term_writestring(name); term_putchar('\n');
+        return -1;
+    }
+    thread_detach(q->worker);
+    return 0;
+}
+
+int blk_submit(blk_queue_t *q, blk_request_t *rq) {
+    if (!q || !rq || rq->count == 0 || rq->count > q->max_sectors || !rq->buffer) return -1;
+    if (rq->op != BLK_READ && rq->op != BLK_WRITE) return -1;
+
+    uint32_t deadline_ms = (rq->op == BLK_READ) ? BLK_READ_DEADLINE_MS : BLK_WRITE_DEADLINE_MS;
+    uint32_t flags = wait_queue_lock(&q->worker_wait);
+    rq->status = 0;
+    rq->seq = q->next_seq++;
+    rq->deadline = timer_ticks() + timer_ms_to_ticks(deadline_ms);
+    rq->merged_count = rq->count;
+    rq->merged_segments = 1;
+    rq->merge_next = NULL;
+    rq->merge_tail = rq;
+    rq->sort_next = rq->fifo_next = rq->flight_next = NULL;
+
+    uint32_t pending = find_conflict(q->fifo_head, offsetof(blk_request_t, fifo_next), rq);
+    uint32_t flying = find_conflict(q->flight, offsetof(blk_request_t, flight_next), rq);
+    rq->after_seq = (pending > flying) ? pending : flying;
+
+    q->stats.submitted++;
+    if (rq->after_seq == 0 && try_merge(q, rq)) {
+        q->stats.merged++;
+    } else {
+        sorted_insert(q, rq);
+        if (q->fifo_tail) q->fifo_tail->fifo_next = rq; else q->fifo_head = rq;
+        q->fifo_tail = rq;
+        q->stats.depth++;
+        if (q->stats.depth > q->stats.depth_max) q->stats.depth_max = q->stats.depth;
+    }
+    wait_queue_wake_one_locked(&q->worker_wait);
+    wait_queue_unlock(&q->worker_wait, flags);
+    return 0;
+}
+
+void blk_queue_complete(blk_queue_t *q, blk_request_t *rq, int status) {
+    uint32_t flags = wait_queue_lock(&q->worker_wait);
+    for (blk_request_t **pp = &q->flight; *pp; pp = &(*pp)->flight_next) {
+        if (*pp == rq) { *pp = rq->flight_next; break; }
+    }
+    rq->flight_next = NULL;
+    q->inflight--;
+    wait_queue_unlock(&q->worker_wait, flags);
+
+    // Complete every request of the merge chain. Read 'merge_next' first:
+    // the callback may release the request memory.
+    for (blk_request_t *r = rq; r; ) {
+        blk_request_t *next = r->merge_next;
+        r->status = status;
+        flags = wait_queue_lock(&q->worker_wait);
+        q->stats.completed++;
+        if (status < 0) q->stats.errors++;
+        wait_queue_unlock(&q->worker_wait, flags);
+        if (r->done) r->done(r, status);
+        r = next;
+    }
+
+    wait_queue_wake_one(&q->worker_wait); // A slot freed up / dependencies may be satisfied
+}
+
+// --- Synchronous Wrapper ---
+typedef struct {
+    wait_queue_t wait;          // Its lock also guards 'pending' and 'status'
+    uint32_t pending;
+    int status;
+} blk_sync_waiter_t;
+
+static void blk_sync_done(blk_request_t *rq, int status) {
+    blk_sync_waiter_t *w = (blk_sync_waiter_t*)rq->private_data;
+    uint32_t flags = wait_queue_lock(&w->wait);
+    if (status < 0 && w->status == 0) w->status = status;
+    if (--w->pending == 0) wait_queue_wake_all_locked(&w->wait);
+    wait_queue_unlock(&w->wait, flags);
+}
+
+int blk_transfer_sync(blk_queue_t *q, int op, uint32_t lba, uint32_t count, void *buffer) {
+    blk_request_t rqs[BLK_SYNC_BATCH];
+    blk_sync_waiter_t w = { WAIT_QUEUE_INIT, 0, 0 };
+    uint8_t *p = (uint8_t*)buffer;
+
+    while (count > 0 && w.status == 0) {
+        uint32_t n = 0;
+        for (; n < BLK_SYNC_BATCH && count > 0; ++n) {
+            uint32_t chunk = (count < q->max_sectors) ? count : q->max_sectors;
+            memset(&rqs[n], 0, sizeof(rqs[n]));
+            rqs[n].lba = lba; rqs[n].count = chunk; rqs[n].buffer = p; rqs[n].op = op;
+            rqs[n].done = blk_sync_done; rqs[n].private_data = &w;
+            lba += chunk; count -= chunk; p += chunk * BLK_SECTOR_SIZE;
+        }
+
+        w.pending = n; // Set before submitting: completions may start right away
+        for (uint32_t i = 0; i < n; ++i) {
+            if (blk_submit(q, &rqs[i]) != 0) {
+                uint32_t flags = wait_queue_lock(&w.wait);
+                if (w.status == 0) w.status = -1;
+                w.pending--;
+                wait_queue_unlock(&w.wait, flags);
+            }
+        }
+
+        uint32_t flags = wait_queue_lock(&w.wait);
+        while (w.pending > 0) wait_queue_sleep(&w.wait);
+        wait_queue_unlock(&w.wait, flags);
+    }
+    return w.status;
+}
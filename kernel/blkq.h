@@ -0,0 +1,116 @@
+// kernel/blkq.h
+// Asynchronous block I/O request queue: C-LOOK elevator, request merging and
+// a deadline cap against starvation. Readably formatted.
+
+#ifndef BLKQ_H
+#define BLKQ_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "thread.h"
+
+#define BLK_SECTOR_SIZE 512
+
+// Request operations
+#define BLK_READ  0
+#define BLK_WRITE 1
+
+// Deadlines (ms after submit). An expired request is dispatched next even if
+// the elevator would rather keep sweeping, so no request starves.
+#define BLK_READ_DEADLINE_MS  100
+#define BLK_WRITE_DEADLINE_MS 500
+
+typedef struct blk_request blk_request_t;
+typedef struct blk_queue blk_queue_t;
+
+// Completion callback: runs once per submitted request, possibly from an IRQ
+// handler or the queue's worker thread, so it must not block.
+typedef void (*blk_completion_t)(blk_request_t *rq, int status);
+
+struct blk_request {
+    // --- Filled in by the submitter ---
+    uint32_t lba;               // First sector
+    uint32_t count;             // Sectors (1..queue max_sectors)
+    void *buffer;               // count * BLK_SECTOR_SIZE bytes
+    int op;                     // BLK_READ / BLK_WRITE
+    blk_completion_t done;      // Completion callback (may be NULL)
+    void *private_data;         // Opaque to the queue
+
+    // --- Owned by blkdev_submit_read() ---
+    void *dev;                  // blkdev_t whose stats count the request
+    blk_completion_t caller_done; // Submitter's callback, run after counting
+
+    // --- Owned by the queue ---
+    int status;                 // Final status (0 or negative driver error)
+    uint32_t seq;               // Submission order
+    uint32_t after_seq;         // Must not dispatch before this request finishes (0 = none)
+    uint32_t deadline;          // Tick by which it should be dispatched
+    uint32_t merged_count;      // Head only: sectors in the whole merge chain
+    uint32_t merged_segments;   // Head only: requests (buffers) in the chain
+    blk_request_t *merge_next;  // Next contiguous request transferred with this one
+    blk_request_t *merge_tail;  // Head only: last request of the chain
+    blk_request_t *sort_next;   // Elevator order (ascending LBA)
+    blk_request_t *fifo_next;   // Arrival order (deadline checks)
+    blk_request_t *flight_next; // In-flight list
+};
+
+// Driver hook: start the transfer described by 'rq' and its merge chain
+// (rq->merged_count sectors from rq->lba; buffers taken in order from
+// rq, rq->merge_next, ...). The driver must eventually call
+// blk_queue_complete(q, rq, status) exactly once, either before returning
+// (synchronous drivers) or later from its IRQ handler.
+typedef void (*blk_issue_t)(blk_queue_t *q, blk_request_t *rq);
+
+typedef struct {
+    uint32_t submitted;         // Requests accepted by blk_submit()
+    uint32_t merged;            // Requests absorbed into a neighbour (front or back)
+    uint32_t dispatched;        // Transfers handed to the driver (after merging)
+    uint32_t completed;         // Requests completed (including merged ones)
+    uint32_t errors;            // Requests completed with a negative status
+    uint32_t deadline_hits;     // Dispatches forced by an expired deadline
+    uint32_t sectors_read;
+    uint32_t sectors_written;
+    uint32_t depth;             // Currently queued (not yet dispatched) transfers
+    uint32_t depth_max;         // Highest 'depth' seen
+    uint32_t depth_sum;         // Sum of 'depth' sampled at each dispatch (avg = depth_sum / dispatched)
+} blk_queue_stats_t;
+
+struct blk_queue {
+    const char *name;
+    blk_issue_t issue;
+    void *driver_data;
+    uint32_t max_sectors;       // Largest single transfer the driver accepts
+    uint32_t max_segments;      // Buffers per transfer (scatter-gather entries); 0 = no limit.
+                                // Drivers set it right after blk_queue_init().
+    uint32_t max_inflight;      // Transfers the driver can have outstanding
+    uint32_t inflight;
+    uint32_t head_lba;          // Sector after the last dispatched transfer (C-LOOK position)
+    uint32_t next_seq;
+    blk_request_t *sorted;      // Pending heads in ascending LBA order
+    blk_request_t *fifo_head;   // Pending heads in arrival order
+    blk_request_t *fifo_tail;
+    blk_request_t *flight;      // Dispatched, not yet completed
+    wait_queue_t worker_wait;   // Worker sleeps here when nothing can be dispatched
+    thread_t *worker;
+    blk_queue_stats_t stats;
+};
+
+// Sets up 'q' and starts its dispatch thread (named after the queue).
+// Returns 0 on success, -1 if no thread slot is free.
+int blk_queue_init(blk_queue_t *q, const char *name, blk_issue_t issue, void *driver_data,
+                   uint32_t max_sectors, uint32_t max_inflight);
+
+// Queues 'rq' (count <= q->max_sectors) and returns immediately; rq->done
+// runs when the transfer finishes. 'rq' must stay valid until then.
+// Returns 0, or -1 if the request is malformed (done is not called).
+int blk_submit(blk_queue_t *q, blk_request_t *rq);
+
+// Called by drivers when the transfer started by 'issue' finishes.
+void blk_queue_complete(blk_queue_t *q, blk_request_t *rq, int status);
+
+// Synchronous helper: splits the range into max_sectors pieces, submits them
+// together (so they can be sorted and merged) and sleeps until all complete.
+// Returns 0 or the first negative status.
+int blk_transfer_sync(blk_queue_t *q, int op, uint32_t lba, uint32_t count, void *buffer);
+
+#endif // BLKQ_H
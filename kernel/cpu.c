@@ -0,0 +1,30 @@
+// kernel/cpu.c
+// Per-CPU data setup. Readably formatted.
+
+#include "cpu.h"
+#include "gdt.h"
+#include "string.h"
+#include <stdint.h>
+
+// --- Module State ---
+cpu_t cpus[MAX_CPUS];
+static volatile uint32_t online_count = 0;
+
+// --- Public Functions ---
+void cpu_setup(uint32_t index, uint32_t apic_id) {
+    cpu_t *c = &cpus[index];
+    memset(c, 0, sizeof(*c));
+    c->self = c;
+    c->index = index;
+    c->apic_id = apic_id;
+    spin_init(&c->rq_lock);
+
+    gdt_set_cpu_segment(index, (uint32_t)c, sizeof(*c) - 1);
+    uint16_t sel = gdt_cpu_selector(index);
+    asm volatile ("movw %0, %%gs" : : "r"(sel) : "memory");
+
+    c->online = 1;
+    __atomic_add_fetch(&online_count, 1, __ATOMIC_SEQ_CST);
+}
+
+uint32_t cpu_online_count(void) { return online_count; }
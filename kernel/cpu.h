@@ -0,0 +1,54 @@
+// kernel/cpu.h
+// Per-CPU data. Each CPU's GS segment points at its own cpu_t, so this_cpu()
+// is a single load with no locking. Readably formatted.
+
+#ifndef CPU_H
+#define CPU_H
+
+#include <stdint.h>
+#include "spinlock.h"
+
+#define MAX_CPUS 8
+
+struct thread;
+
+typedef struct cpu {
+    struct cpu *self;              // Must stay first: this_cpu() reads %gs:0
+    uint32_t index;                // 0 = bootstrap processor (BSP)
+    uint32_t apic_id;              // Local APIC ID (0 when running without APIC)
+    volatile int online;
+
+    // --- Scheduler ---
+    struct thread *current;        // Thread running on this CPU
+    struct thread *idle;           // Runs when nothing else is ready
+    struct thread *switched_from;  // Previous thread, released once its stack is no longer in use
+    spinlock_t rq_lock;            // Protects the run queue below
+    struct thread *rq_head;        // READY threads with affinity to this CPU
+    struct thread *rq_tail;
+    volatile uint32_t nr_ready;
+    volatile int need_resched;
+    int irq_nesting;
+    uint32_t tlb_generation;       // Unmaps this CPU has flushed for (paging_tlb_sync)
+
+    // --- Statistics ---
+    volatile uint32_t ticks;       // Local timer ticks
+    volatile uint32_t idle_ticks;  // ... of which spent in the idle thread
+    uint32_t switches;             // Context switches
+    uint32_t steals;               // Threads pulled from other CPUs' run queues
+} cpu_t;
+
+extern cpu_t cpus[MAX_CPUS];
+
+static inline cpu_t *this_cpu(void) {
+    cpu_t *c;
+    asm volatile ("movl %%gs:0, %0" : "=r"(c));
+    return c;
+}
+
+// Fills in cpus[index] and points this CPU's GS at it.
+void cpu_setup(uint32_t index, uint32_t apic_id);
+
+// Number of CPUs that have come online (at least 1).
+uint32_t cpu_online_count(void);
+
+#endif // CPU_H
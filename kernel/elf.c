@@ -0,0 +1,254 @@
+// kernel/elf.c
+// ELF32 loader with demand paging from FAT32. Readably formatted.
+
+#include "elf.h"
+#include "paging.h"
+#include "pagecache.h"
+#include "timer.h"
+#include "io.h"
+#include "spinlock.h"
+#include "string.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define API_WRITE_CHUNK 128
+
+// Exceptions that stop a program instead of the machine (besides page
+// faults): divide error, invalid opcode, general protection.
+static const uint8_t stop_vectors[] = { 0, 6, 13 };
+
+typedef struct {
+    uint32_t start, end;    // Virtual range [start, end)
+    uint32_t offset;        // File offset of 'start'
+    uint32_t file_size;     // Bytes backed by the file; the rest reads as zero
+    int writable;           // Else whole file-backed pages are shared with the page cache
+} ElfSegment;
+
+// Defined in program.asm
+extern int program_call(uint32_t entry, uint32_t stack_top, const void *api, const char *args);
+extern void program_abort(void);
+
+// --- Module State ---
+static spinlock_t exec_lock = SPINLOCK_INIT;
+static int exec_busy = 0;
+static Fat32File image;                     // The running program's file
+static ElfSegment segments[ELF_MAX_SEGMENTS];
+static uint32_t segment_count = 0;
+static ElfExecStats exec_stats;
+static int exec_crashed = 0;
+static const void *program_maps[ELF_MAX_MAPPINGS]; // Views to drop if the program does not
+
+// --- Program API ---
+// Copies through a kernel buffer first, so a not-yet-loaded string faults
+// in here rather than inside the console code (which holds a lock).
+static void api_write(const char *data, uint32_t size) {
+    char chunk[API_WRITE_CHUNK];
+    while (size > 0) {
+        uint32_t n = size < API_WRITE_CHUNK ? size : API_WRITE_CHUNK;
+        memcpy(chunk, data, n);
+        term_write(chunk, n);
+        data += n; size -= n;
+    }
+}
+
+static const void *api_map(const char *name, uint32_t *size) {
+    char path[FAT32_NAME_MAX + 1];
+    uint32_t n = 0;
+    while (n < FAT32_NAME_MAX && name[n]) { path[n] = name[n]; n++; } // Fault in here, not in fat32
+    path[n] = '\0';
+    int slot = -1;
+    for (int i = 0; i < ELF_MAX_MAPPINGS && slot < 0; ++i) if (!program_maps[i]) slot = i;
+    Fat32File f;
+    const void *view = NULL;
+    if (slot < 0 || fat32_open(fat32_get_current_directory_cluster(), path, 0, &f) != 0) return NULL;
+    if (fat32_mmap(&f, 0, f.size, &view) != 0) view = NULL;
+    fat32_close(&f);
+    if (view) { program_maps[slot] = view; if (size) *size = f.size; }
+    return view;
+}
+
+static void api_unmap(const void *addr) {
+    for (int i = 0; i < ELF_MAX_MAPPINGS; ++i) {
+        if (addr && program_maps[i] == addr) { fat32_munmap(addr); program_maps[i] = NULL; }
+    }
+}
+
+static const program_api_t program_api = {
+    PROGRAM_API_VERSION, api_write, timer_ticks, TIMER_HZ, api_map, api_unmap
+};
+
+// --- Helpers ---
+static int page_in_segment(uint32_t page, const ElfSegment *s) {
+    return page < s->end && page + PAGE_SIZE > s->start;
+}
+
+// Reads the program and segment headers. Nothing is mapped yet.
+static int load_headers(uint32_t *entry) {
+    Elf32Header h;
+    if (fat32_read(&image, &h, sizeof(h)) != (int)sizeof(h)) return ELF_ERR_FORMAT;
+    if (memcmp(h.ident, ELF_MAGIC, 4) != 0 || h.ident[4] != ELF_CLASS_32 || h.ident[5] != ELF_DATA_LSB ||
+        h.type != ELF_TYPE_EXEC || h.machine != ELF_MACHINE_386 || h.phentsize != sizeof(Elf32ProgramHeader)) {
+        return ELF_ERR_FORMAT;
+    }
+
+    int entry_ok = 0;
+    for (uint32_t i = 0; i < h.phnum; ++i) {
+        Elf32ProgramHeader ph;
+        if (fat32_seek(&image, h.phoff + i * sizeof(ph)) != 0 || fat32_read(&image, &ph, sizeof(ph)) != (int)sizeof(ph)) {
+            return ELF_ERR_FORMAT;
+        }
+        if (ph.type != ELF_PT_LOAD || ph.memsz == 0) continue;
+        uint32_t end = ph.vaddr + ph.memsz;
+        if (segment_count == ELF_MAX_SEGMENTS || ph.vaddr < USER_BASE || end < ph.vaddr ||
+            end > MMAP_BASE || ph.filesz > ph.memsz ||
+            ph.offset + ph.filesz < ph.offset || ph.offset + ph.filesz > image.size) {
+            return ELF_ERR_FORMAT;
+        }
+        ElfSegment *s = &segments[segment_count++];
+        s->start = ph.vaddr; s->end = end;
+        s->offset = ph.offset; s->file_size = ph.filesz;
+        s->writable = (ph.flags & ELF_PF_WRITE) != 0;
+        exec_stats.image_pages += (((end + PAGE_SIZE - 1) & PAGE_MASK) - (ph.vaddr & PAGE_MASK)) / PAGE_SIZE;
+        if (h.entry >= s->start && h.entry < s->end) entry_ok = 1;
+    }
+    if (!entry_ok) return ELF_ERR_FORMAT;
+    *entry = h.entry;
+    return 0;
+}
+
+// Maps the page-cache frame of 'page' if it is one whole, page-aligned file
+// page of a single read-only segment. Returns 1 if it did, 0 if the page
+// needs a private copy, negative on error.
+static int map_shared(uint32_t page, int overlaps) {
+    const ElfSegment *s = NULL;
+    for (uint32_t i = 0; i < segment_count && !s; ++i) if (page_in_segment(page, &segments[i])) s = &segments[i];
+    if (overlaps > 1 || s->writable || page < s->start || page + PAGE_SIZE > s->start + s->file_size ||
+        (s->offset + (page - s->start)) % PAGE_SIZE) {
+        return 0;
+    }
+    uint32_t frame;
+    int r = fat32_page_get(&image, (s->offset + (page - s->start)) / PAGE_SIZE, &frame);
+    if (r < 0) return r;
+    if (page_map(page, frame, PTE_SHARED) != 0) { pagecache_put(frame); return -4; }
+    exec_stats.shared_pages++;
+    if (r == 1) exec_stats.cache_hits++;
+    return 1;
+}
+
+// Brings in the page at 'page'. Shared if possible, else zero-fill and copy
+// the file bytes of every segment overlapping it (text and data may share a
+// boundary page).
+static int fill_page(uint32_t page) {
+    int overlaps = 0, from_file = 0;
+    for (uint32_t i = 0; i < segment_count; ++i) overlaps += page_in_segment(page, &segments[i]);
+    if (!overlaps) return -1;
+    int r = map_shared(page, overlaps);
+    if (r < 0) return r;
+    if (r == 1) { exec_stats.faults++; return 0; }
+
+    uint32_t frame = frame_alloc();
+    if (!frame) return -4;
+    uint8_t *dst = (uint8_t*)frame; // Pool frames are identity-mapped
+    memset(dst, 0, PAGE_SIZE);
+    for (uint32_t i = 0; i < segment_count; ++i) {
+        const ElfSegment *s = &segments[i];
+        if (!page_in_segment(page, s)) continue;
+        uint32_t from = page > s->start ? page : s->start;
+        uint32_t to = s->start + s->file_size;
+        if (to > page + PAGE_SIZE) to = page + PAGE_SIZE;
+        if (from >= to) continue;
+        if (fat32_seek(&image, s->offset + (from - s->start)) != 0 ||
+            fat32_read(&image, dst + (from - page), to - from) != (int)(to - from)) {
+            frame_free(frame);
+            return -3;
+        }
+        from_file = 1;
+    }
+    if (page_map(page, frame, PTE_WRITE) != 0) {
+        frame_free(frame);
+        return -4;
+    }
+    exec_stats.faults++;
+    if (!from_file) exec_stats.zero_pages++;
+    return 0;
+}
+
+// Stops the program if the exception came from program code: the frame
+// resumes in program_abort instead. In kernel code (an API call) the
+// exception stays fatal, since locks may be held.
+static int exec_stop(interrupt_frame_t *frame) {
+    if (frame->eip < USER_BASE || frame->eip >= USER_TOP) return -1;
+    term_writestring("exec: exception "); term_print_dec(frame->int_no);
+    term_writestring(" at EIP "); term_print_hex(frame->eip); term_writestring(", program stopped\n");
+    exec_crashed = 1;
+    frame->eip = (uint32_t)program_abort;
+    return 0;
+}
+
+// Page-fault handler for the image range while a program runs, and for
+// any other fault its code raises.
+static int exec_page_fault(uint32_t addr, uint32_t err, interrupt_frame_t *frame) {
+    uint32_t page = addr & PAGE_MASK;
+    if (!(err & PF_PROTECTION) && page >= USER_BASE && page < MMAP_BASE && fill_page(page) == 0) return 0;
+    return exec_stop(frame);
+}
+
+// The stack is mapped up front: in ring 0 the CPU pushes the fault frame
+// onto the faulting stack, so a missing stack page would double-fault.
+static int map_stack(void) {
+    for (uint32_t page = PROGRAM_STACK_TOP - PROGRAM_STACK_SIZE; page < PROGRAM_STACK_TOP; page += PAGE_SIZE) {
+        uint32_t frame = frame_alloc();
+        if (!frame) return -4;
+        memset((void*)frame, 0, PAGE_SIZE);
+        if (page_map(page, frame, PTE_WRITE) != 0) { frame_free(frame); return -4; }
+    }
+    return 0;
+}
+
+static void unmap_range(uint32_t start, uint32_t end) {
+    for (uint32_t page = start & PAGE_MASK; page < end; page += PAGE_SIZE) {
+        uint32_t pte = page_unmap(page);
+        if (pte & PTE_SHARED) pagecache_put(pte & PAGE_MASK);
+        else if (pte) frame_free(pte & PAGE_MASK);
+    }
+}
+
+// --- Public Functions ---
+int elf_exec(uint32_t dir_cluster, const char *name, const char *args, int *status, ElfExecStats *stats) {
+    uint32_t flags = spin_lock_irqsave(&exec_lock);
+    int busy = exec_busy;
+    exec_busy = 1;
+    spin_unlock_irqrestore(&exec_lock, flags);
+    if (busy) return ELF_ERR_BUSY;
+
+    segment_count = 0;
+    exec_crashed = 0;
+    memset(&exec_stats, 0, sizeof(exec_stats));
+    uint32_t entry = 0;
+    int r = fat32_open(dir_cluster, name, 0, &image);
+    if (r == 0) {
+        r = load_headers(&entry);
+        if (r == 0) r = map_stack();
+        if (r == 0) {
+            r = paging_register_fault_range(USER_BASE, MMAP_BASE, exec_page_fault);
+        }
+        if (r == 0) {
+            for (uint32_t i = 0; i < sizeof(stop_vectors); ++i) exception_register_handler(stop_vectors[i], exec_stop);
+            int code = program_call(entry, PROGRAM_STACK_TOP, &program_api, args ? args : "");
+            for (uint32_t i = 0; i < sizeof(stop_vectors); ++i) exception_register_handler(stop_vectors[i], NULL);
+            paging_unregister_fault_range(USER_BASE);
+            for (int i = 0; i < ELF_MAX_MAPPINGS; ++i) api_unmap(program_maps[i]);
+            if (exec_crashed) r = ELF_ERR_CRASHED;
+            else if (status) *status = code;
+        }
+        for (uint32_t i = 0; i < segment_count; ++i) unmap_range(segments[i].start, segments[i].end);
+        unmap_range(PROGRAM_STACK_TOP - PROGRAM_STACK_SIZE, PROGRAM_STACK_TOP);
+        fat32_close(&image);
+    }
+    if (stats) *stats = exec_stats;
+
+    flags = spin_lock_irqsave(&exec_lock);
+    exec_busy = 0;
+    spin_unlock_irqrestore(&exec_lock, flags);
+    return r;
+}
@@ -0,0 +1,80 @@
+// kernel/elf.h
+// ELF32 program loader. exec maps a program's PT_LOAD segments into the
+// user window without reading them: the page-fault handler fills each
+// 4 KiB page from the file on first touch, so start-up costs the pages a
+// run actually uses rather than the file size. Read-only pages come
+// straight from the page cache, so running a tool again reads nothing.
+// One program runs at a time. Readably formatted.
+
+#ifndef ELF_H
+#define ELF_H
+
+#include <stdint.h>
+#include "fat32.h"
+#include "paging.h"
+#include "mmap.h"
+#include "program.h"
+
+// --- ELF32 File Structures ---
+#define ELF_MAGIC      "\x7F" "ELF"
+#define ELF_CLASS_32   1    // ident[4]
+#define ELF_DATA_LSB   1    // ident[5]: little endian
+#define ELF_TYPE_EXEC  2
+#define ELF_MACHINE_386 3
+#define ELF_PT_LOAD    1
+#define ELF_PF_WRITE   2    // Segment flag
+
+typedef struct __attribute__((packed)) {
+    uint8_t  ident[16];
+    uint16_t type;
+    uint16_t machine;
+    uint32_t version;
+    uint32_t entry;
+    uint32_t phoff;         // Program header table offset
+    uint32_t shoff;
+    uint32_t flags;
+    uint16_t ehsize;
+    uint16_t phentsize;
+    uint16_t phnum;
+    uint16_t shentsize;
+    uint16_t shnum;
+    uint16_t shstrndx;
+} Elf32Header;
+
+typedef struct __attribute__((packed)) {
+    uint32_t type;
+    uint32_t offset;        // File offset of the segment
+    uint32_t vaddr;
+    uint32_t paddr;
+    uint32_t filesz;        // Bytes in the file; the rest up to memsz is zero
+    uint32_t memsz;
+    uint32_t flags;
+    uint32_t align;
+} Elf32ProgramHeader;
+
+// --- Loader Limits ---
+#define ELF_MAX_SEGMENTS    8
+#define ELF_MAX_MAPPINGS    8              // Files a program may have mapped at once
+#define PROGRAM_STACK_SIZE  (64 * 1024)    // Mapped up front, see elf.c
+#define PROGRAM_STACK_TOP   USER_TOP
+
+// Error codes beyond fat32's -1 (not found) .. -4 (no space/memory)
+#define ELF_ERR_FORMAT  -5  // Not an i386 executable that fits below MMAP_BASE
+#define ELF_ERR_BUSY    -6  // Another program is running
+#define ELF_ERR_CRASHED -7  // The program faulted and was stopped
+
+typedef struct {
+    uint32_t image_pages;   // Pages spanned by the PT_LOAD segments
+    uint32_t faults;        // Pages brought in on first touch
+    uint32_t zero_pages;    // ... of which needed no file data (.bss)
+    uint32_t shared_pages;  // ... of which are page-cache frames (read-only, whole pages)
+    uint32_t cache_hits;    // ... of those, already resident (earlier run or mapping)
+} ElfExecStats;
+
+// Runs executable 'name' from directory 'dir_cluster' with the argument
+// string 'args' and waits for it to return. Returns 0 and the program's exit
+// status in *status, or a negative error code. 'stats' (may be NULL)
+// receives the paging counters either way.
+int elf_exec(uint32_t dir_cluster, const char *name, const char *args, int *status, ElfExecStats *stats);
+
+#endif // ELF_H
@@ -3,36 +3,83 @@
 
 #include "fat32.h"
 #include "io.h"
+#include "mmap.h"
+#include "pagecache.h"
 #include "string.h"
+#include "thread.h"
 #include <stddef.h>
 #include <stdint.h>
 
 // --- Module State ---
 static Fat32VolumeInfo volume_info; // Uses the corrected struct definition from fat32.h
 static int is_initialized = 0;
-#define MAX_CLUSTER_BUF_SIZE (64 * 512)
-static uint8_t cluster_buffer[MAX_CLUSTER_BUF_SIZE];
 static uint32_t current_directory_cluster = 0;
+static uint8_t sector_buffer[512];  // BPB, FSInfo, directory entry / partial sector read-modify-write
+static uint8_t zero_buffer[8 * 512]; // Never written: source for zero-filling clusters
+#define DIR_ENTRIES_PER_SECTOR (512 / sizeof(Fat32DirectoryEntry))
 
-// --- Basic Memory Copy Helper ---
-void* memcpy(void* dest, const void* src, size_t n) {
-    char* dp = (char*)dest; const char* sp = (const char*)src;
-    for (size_t i = 0; i < n; i++) dp[i] = sp[i];
-    return dest;
+// FAT sector cache. Entries are read and changed here; dirty sectors reach
+// the disk only in fat_cache_writeback(), sorted and written once to each
+// FAT copy, so a long allocation costs a few large writes rather than a
+// read-modify-write per cluster per copy.
+#define FAT_CACHE_SLOTS 64
+typedef struct { uint32_t sector; uint32_t last_use; uint8_t valid; uint8_t dirty; } FatCacheSlot;
+static FatCacheSlot fat_slots[FAT_CACHE_SLOTS];
+static uint8_t fat_cache[FAT_CACHE_SLOTS][512];
+static uint8_t fat_stage[FAT_CACHE_SLOTS * 512]; // Contiguous copy of one dirty run
+static uint32_t fat_clock = 0;
+static int fsinfo_dirty = 0;
+
+// Write-back buffers for delayed allocation, one per file being written
+// (least recently used one is flushed when a new writer needs a slot). A slot
+// holds the bytes right after its owner's last allocated cluster.
+#define WRITEBACK_SLOTS 4
+#define WRITEBACK_SIZE  (64 * 1024) // >= the largest cluster (128 * 512)
+typedef struct { Fat32File *owner; uint32_t len; uint32_t last_use; } WritebackSlot;
+static uint8_t wb_buffer[WRITEBACK_SLOTS][WRITEBACK_SIZE];
+static WritebackSlot wb_slots[WRITEBACK_SLOTS];
+static uint32_t wb_clock = 0;
+
+// Driver lock: one caller at a time in the code below. Recursive, so entry
+// points may call each other, and so may a page fault raised inside the
+// driver whose handler reads a mapped file.
+static mutex_t fat32_mutex = MUTEX_INIT;
+static uint32_t fat32_depth = 0;    // Owner's nesting
+
+#define FSINFO_LEAD_SIG   0x41615252
+#define FSINFO_STRUCT_SIG 0x61417272
+#define FAT_DEFAULT_DATE  0x0021    // 1980-01-01 (no RTC driver yet)
+
+// --- Driver Lock ---
+void fat32_lock(void) {
+    if (fat32_mutex.owner == thread_current()) { fat32_depth++; return; }
+    mutex_lock(&fat32_mutex);
+    fat32_depth = 1;
+}
+
+void fat32_unlock(void) {
+    if (--fat32_depth == 0) mutex_unlock(&fat32_mutex);
 }
 
 // --- Filesystem Initialization ---
-int fat32_init(uint32_t partition_start_lba) {
-    if (is_initialized) { return 0; }
+static int fat32_init_locked(blkdev_t *dev, uint32_t partition_start_lba) {
+    if (!dev) return -1;
+    if (is_initialized && fat32_mmap_count()) return -7; // Views hold the old volume's clusters
+    if (is_initialized) fat32_sync(); // Remount: write back what the old volume still has cached
+    is_initialized = 0; // The old volume is gone once we start reading the new one
+    memset(fat_slots, 0, sizeof(fat_slots));
+    memset(wb_slots, 0, sizeof(wb_slots)); fsinfo_dirty = 0;
+    pagecache_invalidate_all(); // Cached pages are keyed by first cluster, which is per volume
     // Use full member names matching the corrected struct
+    volume_info.device = dev;
     volume_info.partition_start_lba = partition_start_lba;
 
     term_writestring("DEBUG: Reading BPB sector at LBA "); term_print_dec(volume_info.partition_start_lba); term_putchar('\n');
-    if (read_sectors(volume_info.partition_start_lba, 1, cluster_buffer) != 0) {
+    if (blkdev_read(volume_info.device, volume_info.partition_start_lba, 1, sector_buffer) != 0) {
         term_writestring("Error: fat32_init: Failed read BPB LBA "); term_print_dec(volume_info.partition_start_lba); term_putchar('\n');
         return -1;
     }
-    memcpy(&volume_info.bpb, cluster_buffer, sizeof(Fat32BiosParameterBlock));
+    memcpy(&volume_info.bpb, sector_buffer, sizeof(Fat32BiosParameterBlock));
 
     term_writestring("DEBUG: Validating BPB...\n");
     if (volume_info.bpb.bytes_per_sector != 512 && volume_info.bpb.bytes_per_sector != 1024 &&
@@ -45,7 +92,7 @@ int fat32_init(uint32_t partition_start_lba) {
     if (volume_info.bpb.num_fats == 0 || volume_info.bpb.sectors_per_cluster == 0 || (volume_info.bpb.sectors_per_cluster & (volume_info.bpb.sectors_per_cluster - 1)) != 0 ) {
         term_writestring("Error: Invalid BPB values (fats/spc).\n"); return -4;
     }
-    if (*(uint16_t*)&cluster_buffer[510] != 0xAA55) { term_writestring("Warn: Boot sig missing.\n"); }
+    if (*(uint16_t*)&sector_buffer[510] != 0xAA55) { term_writestring("Warn: Boot sig missing.\n"); }
 
     // Calculations using full member names
     volume_info.sectors_per_fat = volume_info.bpb.sectors_per_fat_fat32;
@@ -69,6 +116,17 @@ int fat32_init(uint32_t partition_start_lba) {
     if (current_directory_cluster < 2) {
         term_writestring("Error: Invalid root clus:"); term_print_dec(current_directory_cluster); term_putchar('\n'); return -6;
     }
+
+    // FSInfo: free cluster count and allocation hint (both optional)
+    volume_info.free_clusters = 0xFFFFFFFF;
+    volume_info.next_free_cluster = 0xFFFFFFFF;
+    if (volume_info.bpb.fsinfo_sector != 0 && volume_info.bpb.fsinfo_sector != 0xFFFF &&
+        blkdev_read(volume_info.device, volume_info.partition_start_lba + volume_info.bpb.fsinfo_sector, 1, sector_buffer) == 0 &&
+        *(uint32_t*)&sector_buffer[0] == FSINFO_LEAD_SIG && *(uint32_t*)&sector_buffer[484] == FSINFO_STRUCT_SIG) {
+        uint32_t free_count = *(uint32_t*)&sector_buffer[488], next_free = *(uint32_t*)&sector_buffer[492];
+        if (free_count <= volume_info.total_clusters) volume_info.free_clusters = free_count;
+        if (next_free >= 2 && next_free < volume_info.total_clusters + 2) volume_info.next_free_cluster = next_free;
+    }
     is_initialized = 1; return 0;
 }
 
@@ -84,24 +142,110 @@ uint32_t fat32_cluster_to_lba(uint32_t cluster) {
     return volume_info.data_start_lba + (cluster - 2) * volume_info.bpb.sectors_per_cluster;
 }
 
-// --- Read FAT Entry --- (Uses full member names from volume_info)
-uint32_t fat32_get_next_cluster(uint32_t current_cluster) {
-    if (!is_initialized || current_cluster < 2 || current_cluster >= (volume_info.total_clusters + 2)) return 0x0FFFFFFF;
-    uint32_t fat_offset = current_cluster * 4;
-    uint32_t fat_sector_lba = volume_info.fat_start_lba + (fat_offset / volume_info.bpb.bytes_per_sector);
-    uint32_t entry_offset_in_sector = fat_offset % volume_info.bpb.bytes_per_sector;
-
-    if (read_sectors(fat_sector_lba, 1, cluster_buffer) != 0) {
-        term_writestring("ERR: read FAT sec "); term_print_dec(fat_sector_lba); term_putchar('\n'); return 0x0FFFFFFF;
-    }
-    uint32_t next = *(uint32_t*)&cluster_buffer[entry_offset_in_sector];
-    next &= 0x0FFFFFFF;
-    if (next >= 0x0FFFFFF8) return 0;
-    else if (next == 0x0FFFFFF7) { term_writestring("Warn: Bad clus mark\n"); return 0x0FFFFFF7; }
-    else if (next == 0) { term_writestring("Warn: Free clus mark\n"); return 0; }
+// --- FAT Sector Cache ---
+
+// Writes all dirty cached FAT sectors: ascending order, each run of
+// consecutive dirty sectors gathered into one transfer per FAT copy (only the
+// active FAT when the BPB disables mirroring).
+static int fat_cache_writeback(void) {
+    uint32_t order[FAT_CACHE_SLOTS], n = 0;
+    for (uint32_t i = 0; i < FAT_CACHE_SLOTS; ++i) {
+        if (!fat_slots[i].valid || !fat_slots[i].dirty) continue;
+        uint32_t j = n++;
+        for (; j > 0 && fat_slots[order[j - 1]].sector > fat_slots[i].sector; --j) order[j] = order[j - 1];
+        order[j] = i;
+    }
+
+    int mirrored = !(volume_info.bpb.flags & 0x80);
+    uint32_t first_fat = mirrored ? 0 : (volume_info.bpb.flags & 0x0F);
+    uint32_t last_fat = mirrored ? volume_info.bpb.num_fats : first_fat + 1;
+    int err = 0;
+    for (uint32_t i = 0; i < n; ) {
+        uint32_t j = i + 1;
+        while (j < n && fat_slots[order[j]].sector == fat_slots[order[j - 1]].sector + 1) ++j;
+        for (uint32_t k = i; k < j; ++k) memcpy(fat_stage + (k - i) * 512, fat_cache[order[k]], 512);
+        for (uint32_t fat = first_fat; fat < last_fat; ++fat) {
+            uint32_t lba = volume_info.fat_start_lba + fat * volume_info.sectors_per_fat + fat_slots[order[i]].sector;
+            if (blkdev_write(volume_info.device, lba, j - i, fat_stage) != 0) err = -3;
+        }
+        if (err == 0) for (uint32_t k = i; k < j; ++k) fat_slots[order[k]].dirty = 0;
+        i = j;
+    }
+    return err;
+}
+
+// Cache slot holding FAT sector 'sector' (relative to the FAT start), loaded
+// on a miss into a free or least recently used clean slot. -1 on read error.
+static int fat_slot(uint32_t sector) {
+    int victim = -1;
+    for (int i = 0; i < FAT_CACHE_SLOTS; ++i) {
+        if (fat_slots[i].valid && fat_slots[i].sector == sector) { fat_slots[i].last_use = ++fat_clock; return i; }
+        if (!fat_slots[i].valid) { if (victim < 0 || fat_slots[victim].valid) victim = i; }
+        else if (!fat_slots[i].dirty && (victim < 0 || (fat_slots[victim].valid && fat_slots[i].last_use < fat_slots[victim].last_use))) victim = i;
+    }
+    if (victim < 0) { // All dirty: write them out, then every slot is clean
+        if (fat_cache_writeback() != 0) return -1;
+        victim = 0;
+        for (int i = 1; i < FAT_CACHE_SLOTS; ++i) if (fat_slots[i].last_use < fat_slots[victim].last_use) victim = i;
+    }
+    fat_slots[victim].valid = 0;
+    uint32_t fat = (volume_info.bpb.flags & 0x80) ? (volume_info.bpb.flags & 0x0F) : 0;
+    if (blkdev_read(volume_info.device, volume_info.fat_start_lba + fat * volume_info.sectors_per_fat + sector, 1, fat_cache[victim]) != 0) {
+        term_writestring("ERR: read FAT sec "); term_print_dec(sector); term_putchar('\n'); return -1;
+    }
+    fat_slots[victim].sector = sector; fat_slots[victim].valid = 1; fat_slots[victim].dirty = 0;
+    fat_slots[victim].last_use = ++fat_clock;
+    return victim;
+}
+
+static int valid_cluster(uint32_t cluster) { return cluster >= 2 && cluster < volume_info.total_clusters + 2; }
+
+// Raw FAT entry (low 28 bits); FAT32_EOC if it cannot be read.
+static uint32_t fat_get(uint32_t cluster) {
+    int slot = fat_slot(cluster / 128);
+    if (slot < 0) return FAT32_EOC;
+    return *(uint32_t*)&fat_cache[slot][(cluster % 128) * 4] & 0x0FFFFFFF;
+}
+
+// Sets a FAT entry in the cache (top 4 reserved bits kept) and keeps the
+// FSInfo free count in step.
+static int fat_set(uint32_t cluster, uint32_t value) {
+    int slot = fat_slot(cluster / 128);
+    if (slot < 0) return -3;
+    uint32_t *e = (uint32_t*)&fat_cache[slot][(cluster % 128) * 4];
+    uint32_t old = *e & 0x0FFFFFFF;
+    *e = (*e & 0xF0000000) | (value & 0x0FFFFFFF);
+    fat_slots[slot].dirty = 1;
+    if (volume_info.free_clusters != 0xFFFFFFFF) {
+        if (old == FAT32_FREE_CLUSTER && value != FAT32_FREE_CLUSTER) volume_info.free_clusters--;
+        else if (old != FAT32_FREE_CLUSTER && value == FAT32_FREE_CLUSTER) volume_info.free_clusters++;
+    }
+    fsinfo_dirty = 1;
+    return 0;
+}
+
+// --- Read FAT Entry ---
+static uint32_t fat32_get_next_cluster_locked(uint32_t current_cluster) {
+    if (!is_initialized || !valid_cluster(current_cluster)) return 0x0FFFFFFF;
+    uint32_t next = fat_get(current_cluster);
+    if (next >= FAT32_EOC_MIN) return 0;
+    else if (next == FAT32_BAD_CLUSTER) { term_writestring("Warn: Bad clus mark\n"); return FAT32_BAD_CLUSTER; }
+    else if (next == FAT32_FREE_CLUSTER) { term_writestring("Warn: Free clus mark\n"); return 0; }
     else return next;
 }
 
+static uint32_t fat32_chain_extents_locked(uint32_t first_cluster, uint32_t *clusters) {
+    uint32_t extents = 0, prev = 0, n = 0;
+    if (is_initialized) { // Stops after total_clusters, so a looping chain ends too
+        for (uint32_t c = first_cluster; valid_cluster(c) && n < volume_info.total_clusters; c = fat_get(c), ++n) {
+            if (c != prev + 1) extents++;
+            prev = c;
+        }
+    }
+    if (clusters) *clusters = n;
+    return extents;
+}
+
 // --- Get/Set CWD ---
 uint32_t fat32_get_current_directory_cluster(void) { return current_directory_cluster; }
 void fat32_set_current_directory_cluster(uint32_t cluster) {
@@ -109,66 +253,851 @@ void fat32_set_current_directory_cluster(uint32_t cluster) {
     else { term_writestring("Warn: set CWD invalid clus "); term_print_dec(cluster); term_putchar('\n'); }
 }
 
-// --- Read Directory --- (Uses full member names from volume_info)
-int fat32_read_directory(uint32_t directory_cluster, fat32_dir_entry_callback callback, void *user_data) {
-    if (!is_initialized || !callback || directory_cluster < 2) return -1;
-    uint32_t current_cluster = directory_cluster;
-    int err = 0; char namebuf[13]; int found_flag = 0;
+// --- Directory Sector Stream ---
+// Directories are read one sector at a time through two sector buffers:
+// while one is parsed, the read of the next sector in the chain is already
+// queued on the device (if it has a request queue), and a sector holding
+// the 0x00 end-of-directory marker starts no further reads. Memory use does
+// not depend on the cluster size.
+typedef struct {
+    uint32_t cluster;           // Position of 'data' (0 once past the end of the chain)
+    uint32_t sector;            // Sector within that cluster
+    uint8_t *data;              // Current sector: buf[cur]
+    int cur;
+    uint8_t buf[2][512];
+    blk_request_t rq;           // Prefetch of (next_cluster, next_sector) into buf[cur ^ 1]
+    wait_queue_t wait;          // Its lock guards 'in_flight' and 'status'
+    int in_flight;
+    int status;
+    int prefetched;             // A prefetch was started and not yet consumed
+    uint32_t next_cluster, next_sector;
+} DirStream;
+
+static void ds_prefetch_done(blk_request_t *rq, int status) {
+    DirStream *s = (DirStream*)rq->private_data;
+    uint32_t flags = wait_queue_lock(&s->wait);
+    s->status = status;
+    s->in_flight = 0;
+    wait_queue_wake_all_locked(&s->wait);
+    wait_queue_unlock(&s->wait, flags);
+}
+
+static void ds_wait(DirStream *s) {
+    uint32_t flags = wait_queue_lock(&s->wait);
+    while (s->in_flight) wait_queue_sleep(&s->wait);
+    wait_queue_unlock(&s->wait, flags);
+}
+
+// Position of the sector after (cluster, sector): 1 if there is one, 0 at
+// the end of the chain, negative on a broken chain.
+static int ds_next_position(uint32_t cluster, uint32_t sector, uint32_t *next_cluster, uint32_t *next_sector) {
+    if (sector + 1 < volume_info.bpb.sectors_per_cluster) { *next_cluster = cluster; *next_sector = sector + 1; return 1; }
+    uint32_t next = fat_get(cluster);
+    if (next >= FAT32_EOC_MIN) return 0;
+    if (!valid_cluster(next)) { term_writestring("ERR: Bad clus chain\n"); return -4; }
+    *next_cluster = next; *next_sector = 0;
+    return 1;
+}
+
+static int ds_read(DirStream *s, int which, uint32_t cluster, uint32_t sector) {
+    if (blkdev_read(volume_info.device, fat32_cluster_to_lba(cluster) + sector, 1, s->buf[which]) != 0) {
+        term_writestring("ERR: read dir clus "); term_print_dec(cluster); term_putchar('\n'); return -3;
+    }
+    return 0;
+}
+
+static int ds_open(DirStream *s, uint32_t cluster, uint32_t sector) {
+    memset(&s->wait, 0, sizeof(s->wait)); // WAIT_QUEUE_INIT
+    s->in_flight = 0; s->prefetched = 0; s->status = 0;
+    s->cur = 0; s->data = s->buf[0];
+    s->cluster = cluster; s->sector = sector;
+    return ds_read(s, 0, cluster, sector);
+}
+
+// Starts reading the sector after the current one, unless the current one
+// holds the end marker, the chain ends here or the device has no queue.
+static void ds_prefetch(DirStream *s) {
+    if (s->prefetched || !volume_info.device->queue) return;
+    for (uint32_t off = 0; off < 512; off += sizeof(Fat32DirectoryEntry)) if (s->data[off] == 0x00) return;
+    if (ds_next_position(s->cluster, s->sector, &s->next_cluster, &s->next_sector) != 1) return;
+    memset(&s->rq, 0, sizeof(s->rq));
+    s->rq.lba = fat32_cluster_to_lba(s->next_cluster) + s->next_sector;
+    s->rq.count = 1;
+    s->rq.buffer = s->buf[s->cur ^ 1];
+    s->rq.done = ds_prefetch_done;
+    s->rq.private_data = s;
+    s->in_flight = 1; s->status = 0;
+    if (blkdev_submit_read(volume_info.device, &s->rq) != 0) { s->in_flight = 0; return; }
+    s->prefetched = 1;
+}
+
+// Moves to the next sector: 1 if there is one, 0 at the end of the chain
+// (cluster becomes 0), negative on error.
+static int ds_advance(DirStream *s) {
+    uint32_t next_cluster, next_sector;
+    if (s->prefetched) {
+        ds_wait(s);
+        s->prefetched = 0;
+        if (s->status == 0) {
+            s->cur ^= 1; s->data = s->buf[s->cur];
+            s->cluster = s->next_cluster; s->sector = s->next_sector;
+            return 1;
+        }
+        // Prefetch failed: retry synchronously below
+    }
+    int r = ds_next_position(s->cluster, s->sector, &next_cluster, &next_sector);
+    if (r <= 0) { if (r == 0) s->cluster = 0; return r; }
+    if ((r = ds_read(s, s->cur ^ 1, next_cluster, next_sector)) != 0) return r;
+    s->cur ^= 1; s->data = s->buf[s->cur];
+    s->cluster = next_cluster; s->sector = next_sector;
+    return 1;
+}
+
+// Waits for an unused prefetch: 'rq' and the buffers live in the stream.
+static void ds_close(DirStream *s) {
+    if (s->prefetched) { ds_wait(s); s->prefetched = 0; }
+}
+
+// --- Directory Iteration ---
+
+// Long-name entries in progress: up to 20 pieces of 13 UCS-2 characters,
+// stored last piece first on disk, each carrying the short name's checksum.
+typedef struct {
+    uint16_t chars[20 * 13];
+    uint8_t checksum;
+    uint8_t expect;                 // Sequence number of the next piece expected (0 = none pending)
+} LfnState;
+
+static uint8_t short_name_checksum(const char short_name[11]) {
+    uint8_t sum = 0;
+    for (int i = 0; i < 11; ++i) sum = (uint8_t)(((sum & 1) << 7) + (sum >> 1) + (uint8_t)short_name[i]);
+    return sum;
+}
+
+static void lfn_reset(LfnState *lfn) { lfn->expect = 0; lfn->chars[0] = 0; }
+
+static void lfn_add(LfnState *lfn, const Fat32DirectoryEntry *e) {
+    uint8_t seq = e->lfn.sequence_number & 0x1F;
+    if (e->lfn.sequence_number & 0x40) { // Last piece comes first and starts a new name
+        if (seq == 0 || seq > 20) { lfn_reset(lfn); return; }
+        for (int i = 0; i < 20 * 13; ++i) lfn->chars[i] = 0;
+        lfn->checksum = e->lfn.checksum;
+    } else if (seq != lfn->expect || e->lfn.checksum != lfn->checksum) {
+        lfn_reset(lfn); // Out of order or orphaned: drop it
+        return;
+    }
+    uint16_t *dst = &lfn->chars[(seq - 1) * 13];
+    for (int i = 0; i < 5; ++i) *dst++ = e->lfn.name1[i];
+    for (int i = 0; i < 6; ++i) *dst++ = e->lfn.name2[i];
+    for (int i = 0; i < 2; ++i) *dst++ = e->lfn.name3[i];
+    lfn->expect = (uint8_t)(seq - 1);
+}
+
+// Fills 'out' from a short entry and, if a complete matching long name
+// precedes it, that name.
+static void decode_entry(const Fat32DirectoryEntry *e, LfnState *lfn, Fat32DirEntryInfo *out) {
+    int k = 0;
+    for (int j = 0; j < 8 && e->short_name[j] != ' '; ++j) {
+        char c = (j == 0 && (uint8_t)e->short_name[0] == 0x05) ? (char)0xE5 : e->short_name[j];
+        if ((e->reserved_nt & 0x08) && c >= 'A' && c <= 'Z') c = (char)(c - 'A' + 'a'); // NT lowercase base
+        out->short_name[k++] = c;
+    }
+    if (e->short_name[8] != ' ') {
+        out->short_name[k++] = '.';
+        for (int j = 8; j < 11 && e->short_name[j] != ' '; ++j) {
+            char c = e->short_name[j];
+            if ((e->reserved_nt & 0x10) && c >= 'A' && c <= 'Z') c = (char)(c - 'A' + 'a'); // NT lowercase extension
+            out->short_name[k++] = c;
+        }
+    }
+    out->short_name[k] = '\0';
+
+    if (lfn->expect == 0 && lfn->checksum == short_name_checksum(e->short_name) && lfn->chars[0] != 0) {
+        int n = 0;
+        for (; n < FAT32_NAME_MAX && lfn->chars[n] != 0x0000 && lfn->chars[n] != 0xFFFF; ++n)
+            out->name[n] = lfn->chars[n] < 0x80 ? (char)lfn->chars[n] : '?';
+        out->name[n] = '\0';
+    } else {
+        memcpy(out->name, out->short_name, (size_t)k + 1);
+    }
+    lfn_reset(lfn); // Consumed
+
+    out->attributes = e->attributes;
+    out->size = e->file_size;
+    out->first_cluster = ((uint32_t)e->first_cluster_high << 16) | e->first_cluster_low;
+}
+
+int fat32_dir_open(uint32_t directory_cluster, Fat32DirCursor *cursor) {
+    if (!is_initialized || !cursor || !valid_cluster(directory_cluster)) return -1;
+    cursor->cluster = directory_cluster;
+    cursor->index = 0;
+    return 0;
+}
 
-    if (volume_info.bytes_per_cluster > MAX_CLUSTER_BUF_SIZE) { // Use full name
-        term_writestring("ERR: clus size "); term_print_dec(volume_info.bytes_per_cluster); // Use full name
-        term_writestring(" > buf "); term_print_dec(MAX_CLUSTER_BUF_SIZE); term_putchar('\n'); return -5;
+static int fat32_dir_read_locked(Fat32DirCursor *cursor, Fat32DirEntryInfo *out, int max) {
+    if (!is_initialized || !cursor || !out || max <= 0) return -1;
+    if (!valid_cluster(cursor->cluster)) return 0; // End reached earlier
+    LfnState lfn; // Starts empty: a call only stops right after a short entry
+    lfn_reset(&lfn); lfn.checksum = 0;
+    DirStream s;
+    uint32_t k = cursor->index % DIR_ENTRIES_PER_SECTOR;
+    int n = 0, r = ds_open(&s, cursor->cluster, cursor->index / DIR_ENTRIES_PER_SECTOR);
+    if (r != 0) return r;
+    // Prefetch only when this call is likely to get past the current sector:
+    // a batch that ends mid-sector would leave the read unused
+    if ((uint32_t)max > DIR_ENTRIES_PER_SECTOR - k) ds_prefetch(&s);
+
+    while (n < max) {
+        Fat32DirectoryEntry *e = (Fat32DirectoryEntry*)s.data + k;
+        uint8_t fb = (uint8_t)e->short_name[0];
+        if (fb == 0x00) { s.cluster = 0; break; } // End of directory
+
+        if (fb == 0xE5) lfn_reset(&lfn);                  // Deleted
+        else if (e->attributes == ATTR_LONG_NAME) lfn_add(&lfn, e);
+        else if (e->attributes & ATTR_VOLUME_ID) lfn_reset(&lfn);
+        else if (fb == '.' && (e->short_name[1] == ' ' || e->short_name[1] == '.')) lfn_reset(&lfn); // "." / ".."
+        else decode_entry(e, &lfn, &out[n++]);
+
+        if (++k == DIR_ENTRIES_PER_SECTOR) {
+            k = 0;
+            if ((r = ds_advance(&s)) <= 0) break;
+            if ((uint32_t)(max - n) > DIR_ENTRIES_PER_SECTOR) ds_prefetch(&s);
+        }
     }
+    ds_close(&s);
+    if (r < 0) return r;
+    cursor->cluster = s.cluster;
+    cursor->index = s.sector * DIR_ENTRIES_PER_SECTOR + k;
+    return n;
+}
 
-    term_writestring("DEBUG: Reading dir clus:"); term_print_dec(current_cluster); term_putchar('\n');
+// --- Write Path ---
 
-    while (current_cluster != 0 && current_cluster < 0x0FFFFFF7) {
-        uint32_t lba = fat32_cluster_to_lba(current_cluster);
-        term_writestring("DEBUG: Reading Cluster "); term_print_dec(current_cluster);
-        term_writestring(" at LBA "); term_print_dec(lba); term_putchar('\n'); // Print correct LBA
-        if (lba == 0) { err = -2; break; }
+static uint32_t min_u32(uint32_t a, uint32_t b) { return a < b ? a : b; }
 
-        if (read_sectors(lba, volume_info.bpb.sectors_per_cluster, cluster_buffer) != 0) { // Use full name
-            term_writestring("ERR: read dir clus LBA "); term_print_dec(lba); term_putchar('\n'); err = -3; break;
+// "readme.txt" -> "README  TXT". Returns -1 if it is not a valid 8.3 name.
+static int make_short_name(const char *name, char out[11]) {
+    static const char allowed[] = "!#$%&'()-@^_`{}~";
+    memset(out, ' ', 11);
+    if (!name || !name[0] || name[0] == '.') return -1;
+    int pos = 0, limit = 8;
+    for (const char *p = name; *p; ++p) {
+        char c = *p;
+        if (c == '.') {
+            if (limit == 11) return -1; // Second dot
+            pos = 8; limit = 11; continue;
         }
-        term_writestring("DEBUG: Read Cluster "); term_print_dec(current_cluster);
-        term_writestring(" Data(Hex): "); for (int k = 0; k < 16; ++k) { term_print_hex_byte(cluster_buffer[k]); term_putchar(' '); } term_putchar('\n');
+        if (c >= 'a' && c <= 'z') c = (char)(c - 'a' + 'A');
+        int ok = (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+        for (const char *a = allowed; !ok && *a; ++a) ok = (c == *a);
+        if (!ok || pos >= limit) return -1;
+        out[pos++] = c;
+    }
+    if (out[0] == ' ') return -1;
+    if ((uint8_t)out[0] == 0xE5) out[0] = 0x05;
+    return 0;
+}
 
-        Fat32DirectoryEntry *entry = (Fat32DirectoryEntry*)cluster_buffer;
-        uint32_t num_entries = volume_info.bytes_per_cluster / sizeof(Fat32DirectoryEntry); // Use full name
+// Finds up to 'want' free clusters in one contiguous run and returns the run
+// length (0 if the volume is full), its first cluster in *start. The clusters
+// right after 'goal' (a file's current tail) are tried first so a growing
+// file stays in one piece; otherwise the first run of 'want' clusters from
+// the FSInfo hint on, or failing that the longest run on the volume.
+static uint32_t fat_find_run(uint32_t want, uint32_t goal, uint32_t *start) {
+    uint32_t limit = volume_info.total_clusters + 2, n = 0;
+    if (valid_cluster(goal)) {
+        while (n < want && goal + 1 + n < limit && fat_get(goal + 1 + n) == FAT32_FREE_CLUSTER) ++n;
+        if (n > 0) { *start = goal + 1; return n; }
+    }
 
-        for (uint32_t i = 0; i < num_entries; ++i, ++entry) {
-            uint8_t fb = entry->short_name[0];
-            // Debug print entry info
-            term_writestring("DEBUG: Entry "); term_print_dec(i); term_writestring(": first_byte="); term_print_hex_byte(fb); term_writestring(", attrs="); term_print_hex_byte(entry->attributes); term_writestring(", name[0..2]='"); term_putchar(fb >= ' ' ? fb : '.'); term_putchar(entry->short_name[1] >= ' ' ? entry->short_name[1] : '.'); term_putchar(entry->short_name[2] >= ' ' ? entry->short_name[2] : '.'); term_writestring("'\n");
+    uint32_t hint = valid_cluster(volume_info.next_free_cluster) ? volume_info.next_free_cluster : 2;
+    uint32_t best_start = 0, best_len = 0, run_start = 0, run_len = 0;
+    for (uint32_t i = 0; i < volume_info.total_clusters; ++i) {
+        uint32_t c = 2 + (hint - 2 + i) % volume_info.total_clusters;
+        if (c == 2) run_len = 0; // Runs do not wrap around the end of the FAT
+        if (fat_get(c) == FAT32_FREE_CLUSTER) {
+            if (run_len++ == 0) run_start = c;
+            if (run_len >= want) { *start = run_start; return want; }
+            if (run_len > best_len) { best_len = run_len; best_start = run_start; }
+        } else {
+            run_len = 0;
+        }
+    }
+    *start = best_start;
+    return best_len;
+}
 
-            if (fb == 0x00) { term_writestring("DEBUG: EOD marker (0x00)\n"); current_cluster = 0; goto end_loop; }
-            if (fb == 0xE5) { /*Skip deleted*/ continue; }
-            if (entry->attributes == ATTR_LONG_NAME) { /*Skip LFN*/ continue; }
-            if (entry->attributes & ATTR_VOLUME_ID) { /*Skip VolID*/ continue; }
+// Cluster number 'index' of the file's chain, or 0. Walks on from the
+// previous lookup when that lies before 'index', so reading a file front to
+// back (or faulting its pages in) costs one FAT step per cluster overall.
+static uint32_t file_cluster_at(Fat32File *f, uint32_t index) {
+    if (index >= f->clusters) return 0;
+    if (index == f->clusters - 1) return f->last_cluster;
+    uint32_t c = f->first_cluster, i = 0;
+    if (f->cursor_cluster && f->cursor_index <= index) { c = f->cursor_cluster; i = f->cursor_index; }
+    for (; i < index && valid_cluster(c); ++i) c = fat_get(c);
+    if (!valid_cluster(c)) return 0;
+    f->cursor_index = index; f->cursor_cluster = c;
+    return c;
+}
 
-            // Process valid 8.3 entry
-            found_flag = 1;
-            int k = 0; for (int j = 0; j < 8 && entry->short_name[j] != ' '; ++j) namebuf[k++] = (j == 0 && fb == 0x05) ? 0xE5 : entry->short_name[j];
-            if (entry->short_name[8] != ' ') { namebuf[k++] = '.'; for (int j = 8; j < 11 && entry->short_name[j] != ' '; ++j) namebuf[k++] = entry->short_name[j]; } namebuf[k] = '\0';
-            //term_writestring("DEBUG: Calling CB for '"); term_writestring(namebuf); term_writestring("'\n"); // Optional
-            callback(entry, namebuf, user_data);
-        } // End entry loop
+// Appends 'count' clusters to the chain and fills them from 'data': one
+// write and one FAT run per contiguous extent found. Data goes out before
+// the FAT entries that make it part of the file.
+static int file_append_clusters(Fat32File *f, const uint8_t *data, uint32_t count) {
+    while (count > 0) {
+        uint32_t start, n = fat_find_run(count, f->last_cluster, &start);
+        if (n == 0) return -4;
+        if (blkdev_write(volume_info.device, fat32_cluster_to_lba(start), n * volume_info.bpb.sectors_per_cluster, data) != 0) return -3;
+        for (uint32_t k = 0; k < n; ++k) {
+            if (fat_set(start + k, k + 1 < n ? start + k + 1 : FAT32_EOC) != 0) return -3;
+        }
+        if (f->clusters > 0) { if (fat_set(f->last_cluster, start) != 0) return -3; }
+        else f->first_cluster = start;
+        f->last_cluster = start + n - 1;
+        f->clusters += n;
+        volume_info.next_free_cluster = valid_cluster(start + n) ? start + n : 2;
+        data += n * volume_info.bytes_per_cluster;
+        count -= n;
+        f->entry_dirty = 1;
+    }
+    return 0;
+}
 
-        current_cluster = fat32_get_next_cluster(current_cluster);
-        term_writestring("DEBUG: Next clus "); term_print_hex(current_cluster); term_putchar('\n');
-        if (current_cluster == 0x0FFFFFF7) { term_writestring("ERR: Bad clus chain\n"); err = -4; break; }
-    end_loop:;
-    } // End cluster loop
+// Bytes of allocated clusters a write-back slot may cover.
+static uint32_t wb_capacity(void) {
+    return (WRITEBACK_SIZE / volume_info.bytes_per_cluster) * volume_info.bytes_per_cluster;
+}
 
-    // Final debug message
-    if (found_flag == 0 && err == 0) { term_writestring("DEBUG: ReadDIR done: No valid entries found.\n"); }
-    else if (err != 0) { term_writestring("DEBUG: ReadDIR done: Error "); term_print_dec(err); term_putchar('\n'); }
-    else { term_writestring("DEBUG: ReadDIR done: Success.\n"); }
+// Slot buffering 'f', or -1.
+static int wb_find(const Fat32File *f) {
+    for (int i = 0; i < WRITEBACK_SLOTS; ++i) if (wb_slots[i].owner == f) return i;
+    return -1;
+}
 
-    // Pass flag back via user_data if caller provided pointer (for improved ls)
-    if (user_data) { *((int*)user_data) = found_flag; }
-    return err;
+// Gives the buffered tail in slot 'i' its clusters, all in one allocation
+// sized to what was buffered, writes it out and frees the slot. On failure
+// the slot keeps the bytes that got no clusters, for a later retry.
+static int wb_flush(int i) {
+    WritebackSlot *w = &wb_slots[i];
+    Fat32File *f = w->owner;
+    if (!f || w->len == 0) { w->owner = NULL; w->len = 0; return 0; }
+    uint32_t bpc = volume_info.bytes_per_cluster, before = f->clusters;
+    uint32_t clusters = (w->len + bpc - 1) / bpc;
+    memset(wb_buffer[i] + w->len, 0, clusters * bpc - w->len);
+    int r = file_append_clusters(f, wb_buffer[i], clusters);
+    if (r != 0) {
+        uint32_t done = (f->clusters - before) * bpc; // Extents already linked in
+        memmove(wb_buffer[i], wb_buffer[i] + done, w->len - done);
+        w->len -= done;
+        return r;
+    }
+    w->owner = NULL; w->len = 0;
+    return 0;
+}
+
+// Slot for 'f', taking a free one or flushing the least recently used.
+// Returns the slot index or a negative error.
+static int wb_claim(Fat32File *f) {
+    int i = wb_find(f);
+    if (i < 0) {
+        for (int k = 0; k < WRITEBACK_SLOTS; ++k) {
+            if (!wb_slots[k].owner) { i = k; break; }
+            if (i < 0 || wb_slots[k].last_use < wb_slots[i].last_use) i = k;
+        }
+        if (wb_slots[i].owner) { int r = wb_flush(i); if (r != 0) return r; }
+        wb_slots[i].owner = f; wb_slots[i].len = 0;
+    }
+    wb_slots[i].last_use = ++wb_clock;
+    return i;
 }
 
-// --- TODO ---
\ No newline at end of file
+// Reads or overwrites 'len' bytes at 'offset' inside the allocated clusters.
+// Whole sectors move straight between the caller's buffer and the disk (one
+// transfer per physically contiguous stretch); partial sectors go through
+// sector_buffer.
+static int file_io(Fat32File *f, int op, uint32_t offset, uint8_t *buf, uint32_t len) {
+    uint32_t bpc = volume_info.bytes_per_cluster;
+    uint32_t c = file_cluster_at(f, offset / bpc);
+    uint32_t run_lba = 0, run_count = 0;
+    uint8_t *run_buf = NULL;
+    if (!c) return -3;
+
+    while (len > 0) {
+        uint32_t in_cluster = offset % bpc, in_sector = in_cluster % 512;
+        uint32_t lba = fat32_cluster_to_lba(c) + in_cluster / 512, chunk;
+        if (in_sector == 0 && len >= 512) {
+            uint32_t sectors = min_u32(len, bpc - in_cluster) / 512;
+            chunk = sectors * 512;
+            if (run_count && run_lba + run_count == lba && run_buf + run_count * 512 == buf) {
+                run_count += sectors;
+            } else {
+                if (run_count) {
+                    int r = op == BLK_WRITE ? blkdev_write(volume_info.device, run_lba, run_count, run_buf)
+                                            : blkdev_read(volume_info.device, run_lba, run_count, run_buf);
+                    if (r != 0) return -3;
+                }
+                run_lba = lba; run_count = sectors; run_buf = buf;
+            }
+        } else {
+            chunk = min_u32(512 - in_sector, len);
+            if (blkdev_read(volume_info.device, lba, 1, sector_buffer) != 0) return -3;
+            if (op == BLK_WRITE) {
+                memcpy(sector_buffer + in_sector, buf, chunk);
+                if (blkdev_write(volume_info.device, lba, 1, sector_buffer) != 0) return -3;
+            } else {
+                memcpy(buf, sector_buffer + in_sector, chunk);
+            }
+        }
+        offset += chunk; buf += chunk; len -= chunk;
+        if (len > 0 && offset % bpc == 0) {
+            c = fat_get(c);
+            if (!valid_cluster(c)) return -3;
+        }
+    }
+    if (run_count) {
+        int r = op == BLK_WRITE ? blkdev_write(volume_info.device, run_lba, run_count, run_buf)
+                                : blkdev_read(volume_info.device, run_lba, run_count, run_buf);
+        if (r != 0) return -3;
+    }
+    return 0;
+}
+
+// Looks 'short_name' up in a directory. Returns 1 and the entry (plus its
+// location) if found, 0 if not; either way *free_lba/*free_off receive the
+// first reusable slot (deleted or past the end marker), or 0 if the
+// directory is full, and *last the directory's final cluster. Negative on
+// I/O error.
+static int dir_lookup(uint32_t dir_cluster, const char short_name[11], Fat32DirectoryEntry *found,
+                      uint32_t *lba_out, uint32_t *off_out, uint32_t *free_lba, uint32_t *free_off, uint32_t *last) {
+    DirStream s;
+    *free_lba = 0; *free_off = 0; *last = dir_cluster;
+    int r = ds_open(&s, dir_cluster, 0);
+    if (r != 0) return r;
+    for (;;) {
+        ds_prefetch(&s);
+        *last = s.cluster;
+        uint32_t lba = fat32_cluster_to_lba(s.cluster) + s.sector;
+        for (uint32_t off = 0; off < 512; off += sizeof(Fat32DirectoryEntry)) {
+            Fat32DirectoryEntry *e = (Fat32DirectoryEntry*)(s.data + off);
+            uint8_t fb = (uint8_t)e->short_name[0];
+            if (fb == 0x00 || fb == 0xE5) {
+                if (*free_lba == 0) { *free_lba = lba; *free_off = off; }
+                if (fb == 0x00) { r = 0; goto out; } // End of directory
+                continue;
+            }
+            if (e->attributes == ATTR_LONG_NAME || (e->attributes & ATTR_VOLUME_ID)) continue;
+            if (memcmp(e->short_name, short_name, 11) == 0) {
+                memcpy(found, e, sizeof(*found));
+                *lba_out = lba; *off_out = off;
+                r = 1; goto out;
+            }
+        }
+        if ((r = ds_advance(&s)) <= 0) break;
+    }
+out:
+    ds_close(&s);
+    return r;
+}
+
+// Zero-fills cluster 'c' on disk.
+static int zero_cluster(uint32_t c) {
+    uint32_t lba = fat32_cluster_to_lba(c), left = volume_info.bpb.sectors_per_cluster;
+    while (left > 0) {
+        uint32_t n = min_u32(left, sizeof(zero_buffer) / 512);
+        if (blkdev_write(volume_info.device, lba, n, zero_buffer) != 0) return -3;
+        lba += n; left -= n;
+    }
+    return 0;
+}
+
+// Writes a new short entry into the slot from dir_lookup(), growing the
+// directory by one zeroed cluster when it has no free slot.
+static int dir_add_entry(uint32_t last, uint32_t *lba, uint32_t *off, const char short_name[11], uint8_t attributes, uint32_t first_cluster) {
+    if (*lba == 0) {
+        uint32_t c;
+        if (fat_find_run(1, last, &c) == 0) return -4;
+        if (zero_cluster(c) != 0) return -3;
+        if (fat_set(c, FAT32_EOC) != 0 || fat_set(last, c) != 0) return -3;
+        *lba = fat32_cluster_to_lba(c); *off = 0;
+    }
+    if (blkdev_read(volume_info.device, *lba, 1, sector_buffer) != 0) return -3;
+    Fat32DirectoryEntry *e = (Fat32DirectoryEntry*)(sector_buffer + *off);
+    memset(e, 0, sizeof(*e));
+    memcpy(e->short_name, short_name, 11);
+    e->attributes = attributes;
+    e->creation_date = e->last_access_date = e->last_write_date = FAT_DEFAULT_DATE;
+    e->first_cluster_high = (uint16_t)(first_cluster >> 16);
+    e->first_cluster_low = (uint16_t)(first_cluster & 0xFFFF);
+    return blkdev_write(volume_info.device, *lba, 1, sector_buffer) == 0 ? 0 : -3;
+}
+
+// Rewrites the file's directory entry (first cluster, size).
+static int entry_update(Fat32File *f) {
+    if (blkdev_read(volume_info.device, f->entry_lba, 1, sector_buffer) != 0) return -3;
+    Fat32DirectoryEntry *e = (Fat32DirectoryEntry*)(sector_buffer + f->entry_offset);
+    e->first_cluster_high = (uint16_t)(f->first_cluster >> 16);
+    e->first_cluster_low = (uint16_t)(f->first_cluster & 0xFFFF);
+    e->file_size = (f->attributes & ATTR_DIRECTORY) ? 0 : f->size;
+    e->attributes |= ATTR_ARCHIVE;
+    e->last_write_date = FAT_DEFAULT_DATE;
+    if (blkdev_write(volume_info.device, f->entry_lba, 1, sector_buffer) != 0) return -3;
+    f->entry_dirty = 0;
+    return 0;
+}
+
+static int fat32_open_locked(uint32_t dir_cluster, const char *name, int flags, Fat32File *file) {
+    char short_name[11];
+    Fat32DirectoryEntry e;
+    uint32_t lba = 0, off = 0, free_lba, free_off, last;
+    if (!is_initialized || !file || !valid_cluster(dir_cluster) || make_short_name(name, short_name) != 0) return -1;
+
+    int r = dir_lookup(dir_cluster, short_name, &e, &lba, &off, &free_lba, &free_off, &last);
+    if (r < 0) return r;
+    memset(file, 0, sizeof(*file));
+    file->dir_cluster = dir_cluster;
+    if (r == 0) {
+        if (!(flags & FAT32_OPEN_CREATE)) return -1;
+        if ((r = dir_add_entry(last, &free_lba, &free_off, short_name, ATTR_ARCHIVE, 0)) != 0) return r;
+        file->entry_lba = free_lba; file->entry_offset = free_off;
+        file->attributes = ATTR_ARCHIVE;
+        return fat32_sync(); // The directory may have grown
+    }
+
+    if (e.attributes & ATTR_DIRECTORY) return -2;
+    file->entry_lba = lba; file->entry_offset = off;
+    file->attributes = e.attributes;
+    file->first_cluster = ((uint32_t)e.first_cluster_high << 16) | e.first_cluster_low;
+    file->size = e.file_size;
+    // Walk the chain once for its length and tail
+    for (uint32_t c = file->first_cluster; valid_cluster(c); c = fat_get(c)) {
+        file->last_cluster = c;
+        if (++file->clusters > volume_info.total_clusters) return -3; // Loop in the chain
+    }
+    if (file->size > file->clusters * volume_info.bytes_per_cluster) file->size = file->clusters * volume_info.bytes_per_cluster;
+    if (flags & FAT32_OPEN_TRUNCATE) return fat32_truncate(file, 0);
+    return 0;
+}
+
+static int fat32_read_locked(Fat32File *file, void *buffer, uint32_t count) {
+    if (!is_initialized || !file || !buffer) return -1;
+    uint8_t *buf = (uint8_t*)buffer;
+    count = min_u32(count, file->size - file->position);
+    uint32_t done = 0, allocated = file->clusters * volume_info.bytes_per_cluster;
+    if (file->position < allocated && count > 0) {
+        uint32_t len = min_u32(count, allocated - file->position);
+        int r = file_io(file, BLK_READ, file->position, buf, len);
+        if (r != 0) return r;
+        done = len;
+    }
+    if (done < count) { // The rest is still in a write-back slot
+        int slot = wb_find(file);
+        if (slot < 0) return -3;
+        memcpy(buf + done, wb_buffer[slot] + (file->position + done - allocated), count - done);
+        done = count;
+    }
+    file->position += done;
+    return (int)done;
+}
+
+static int fat32_write_locked(Fat32File *file, const void *buffer, uint32_t count) {
+    if (!is_initialized || !file || !buffer) return -1;
+    const uint8_t *buf = (const uint8_t*)buffer;
+    uint32_t done = 0, start = file->position, bpc = volume_info.bytes_per_cluster, cap = wb_capacity();
+    int r = 0;
+
+    while (done < count) {
+        uint32_t allocated = file->clusters * bpc, left = count - done, chunk;
+        if (file->position < allocated) {
+            // Overwrite inside clusters the file already has
+            chunk = min_u32(left, allocated - file->position);
+            if ((r = file_io(file, BLK_WRITE, file->position, (uint8_t*)buf + done, chunk)) != 0) break;
+        } else {
+            // Past the allocated clusters: buffer now, allocate at flush
+            int slot = wb_claim(file);
+            if (slot < 0) { r = slot; break; }
+            WritebackSlot *w = &wb_slots[slot];
+            uint32_t off = file->position - allocated; // <= w->len since position <= size
+            if (off == 0 && w->len == 0 && left >= cap) {
+                // Nothing buffered and more than a buffer's worth: allocate
+                // for all whole clusters at once, straight from the caller
+                chunk = (left / bpc) * bpc;
+                if ((r = file_append_clusters(file, buf + done, chunk / bpc)) != 0) break;
+            } else if (off == cap) {
+                if ((r = wb_flush(slot)) != 0) break;
+                continue;
+            } else {
+                chunk = min_u32(left, cap - off);
+                memcpy(wb_buffer[slot] + off, buf + done, chunk);
+                if (off + chunk > w->len) w->len = off + chunk;
+            }
+        }
+        done += chunk;
+        file->position += chunk;
+        if (file->position > file->size) { file->size = file->position; file->entry_dirty = 1; }
+    }
+    pagecache_write(file->first_cluster, start, buf, done); // Mapped views see the new bytes
+    if (r != 0 && done == 0) return r;
+    return (int)done;
+}
+
+int fat32_seek(Fat32File *file, uint32_t position) {
+    if (!file || position > file->size) return -1;
+    file->position = position;
+    return 0;
+}
+
+static int fat32_truncate_locked(Fat32File *file, uint32_t size) {
+    if (!is_initialized || !file || size > file->size) return -1;
+    if (size < file->size && file->first_cluster && fat32_is_mapped(file->first_cluster)) return -5; // Views read the chain
+    uint32_t bpc = volume_info.bytes_per_cluster, allocated = file->clusters * bpc;
+    pagecache_truncate(file->first_cluster, size); // Before the chain (and with it the cache key) goes
+    int slot = wb_find(file);
+    if (slot >= 0) {
+        if (size >= allocated) { // Only buffered bytes go
+            wb_slots[slot].len = size - allocated;
+            goto done;
+        }
+        wb_slots[slot].owner = NULL; wb_slots[slot].len = 0;
+    }
+
+    uint32_t keep = (size + bpc - 1) / bpc;
+    if (keep < file->clusters) {
+        uint32_t c;
+        if (keep == 0) {
+            c = file->first_cluster;
+            file->first_cluster = file->last_cluster = 0;
+            file->cursor_cluster = 0;
+        } else {
+            uint32_t tail = file_cluster_at(file, keep - 1);
+            if (!tail) return -3;
+            c = fat_get(tail);
+            if (fat_set(tail, FAT32_EOC) != 0) return -3;
+            file->last_cluster = tail;
+        }
+        for (uint32_t n = file->clusters - keep; n > 0 && valid_cluster(c); --n) {
+            uint32_t next = fat_get(c);
+            if (fat_set(c, FAT32_FREE_CLUSTER) != 0) return -3;
+            if (c < volume_info.next_free_cluster) volume_info.next_free_cluster = c;
+            c = next;
+        }
+        file->clusters = keep;
+    }
+done:
+    file->size = size;
+    if (file->position > size) file->position = size;
+    file->entry_dirty = 1;
+    return 0;
+}
+
+static int fat32_close_locked(Fat32File *file) {
+    if (!is_initialized || !file) return -1;
+    int r = 0, slot = wb_find(file);
+    if (slot >= 0 && (r = wb_flush(slot)) != 0) {
+        // The handle goes away with the slot: the file ends where its clusters do
+        wb_slots[slot].owner = NULL; wb_slots[slot].len = 0;
+        file->size = file->clusters * volume_info.bytes_per_cluster;
+        if (file->position > file->size) file->position = file->size;
+        file->entry_dirty = 1;
+        pagecache_truncate(file->first_cluster, file->size);
+    }
+    // Data first, then the FAT that links it, then the entry that points at it
+    int s = fat32_sync();
+    if (r == 0) r = s;
+    if (file->entry_dirty && entry_update(file) != 0 && r == 0) r = -3;
+    if (blkdev_flush(volume_info.device) != 0 && r == 0) r = -3;
+    return r;
+}
+
+static int fat32_mkdir_locked(uint32_t dir_cluster, const char *name) {
+    char short_name[11];
+    Fat32DirectoryEntry e;
+    uint32_t lba, off, free_lba, free_off, last, c;
+    if (!is_initialized || !valid_cluster(dir_cluster) || make_short_name(name, short_name) != 0) return -1;
+    int r = dir_lookup(dir_cluster, short_name, &e, &lba, &off, &free_lba, &free_off, &last);
+    if (r != 0) return r < 0 ? r : -2;
+
+    // New cluster with "." and ".." ('..' of a root child is cluster 0)
+    if (fat_find_run(1, 0, &c) == 0) return -4;
+    if (zero_cluster(c) != 0) return -3;
+    memset(sector_buffer, 0, 512);
+    Fat32DirectoryEntry *dot = (Fat32DirectoryEntry*)sector_buffer;
+    uint32_t parent = dir_cluster == volume_info.bpb.root_dir_cluster ? 0 : dir_cluster;
+    memcpy(dot[0].short_name, ".          ", 11);
+    memcpy(dot[1].short_name, "..         ", 11);
+    dot[0].attributes = dot[1].attributes = ATTR_DIRECTORY;
+    dot[0].first_cluster_high = (uint16_t)(c >> 16); dot[0].first_cluster_low = (uint16_t)(c & 0xFFFF);
+    dot[1].first_cluster_high = (uint16_t)(parent >> 16); dot[1].first_cluster_low = (uint16_t)(parent & 0xFFFF);
+    dot[0].creation_date = dot[1].creation_date = dot[0].last_write_date = dot[1].last_write_date = FAT_DEFAULT_DATE;
+    if (blkdev_write(volume_info.device, fat32_cluster_to_lba(c), 1, sector_buffer) != 0) return -3;
+    if (fat_set(c, FAT32_EOC) != 0) return -3;
+    volume_info.next_free_cluster = valid_cluster(c + 1) ? c + 1 : 2;
+
+    if ((r = fat32_sync()) != 0) return r; // Cluster is in use before anything points at it
+    if ((r = dir_add_entry(last, &free_lba, &free_off, short_name, ATTR_DIRECTORY, c)) != 0) return r;
+    if ((r = fat32_sync()) != 0) return r;
+    return blkdev_flush(volume_info.device) == 0 ? 0 : -3;
+}
+
+static int fat32_defrag_locked(Fat32File *file) {
+    if (!is_initialized || !file || (file->attributes & ATTR_DIRECTORY)) return -1;
+    if (file->first_cluster && fat32_is_mapped(file->first_cluster)) return -5; // Views read the old clusters
+    int r = fat32_sync(); // Buffered data gets its clusters, and every write-back buffer is free after
+    if (r != 0) return r;
+    if (fat32_chain_extents_locked(file->first_cluster, NULL) <= 1) return 0;
+    uint32_t count = file->clusters, spc = volume_info.bpb.sectors_per_cluster, start;
+    if (fat_find_run(count, 0, &start) < count) return -4;
+
+    // 1. Copy, up to a write-back buffer's worth of one extent per transfer
+    uint32_t per_copy = WRITEBACK_SIZE / volume_info.bytes_per_cluster, c = file->first_cluster, n;
+    for (uint32_t done = 0; done < count; ) {
+        if (!valid_cluster(c)) return -3;
+        uint32_t next = fat_get(c);
+        for (n = 1; n < per_copy && done + n < count && next == c + n; ++n) next = fat_get(c + n);
+        if (blkdev_read(volume_info.device, fat32_cluster_to_lba(c), n * spc, wb_buffer[0]) != 0 ||
+            blkdev_write(volume_info.device, fat32_cluster_to_lba(start + done), n * spc, wb_buffer[0]) != 0) return -3;
+        done += n; c = next;
+    }
+    if (blkdev_flush(volume_info.device) != 0) return -3;
+
+    // 2. The copy becomes a chain of its own (orphaned if we stop here), then the entry switches to it
+    for (uint32_t k = 0; k < count; ++k) {
+        if (fat_set(start + k, k + 1 < count ? start + k + 1 : FAT32_EOC) != 0) return -3;
+    }
+    if ((r = fat32_sync()) != 0) return r;
+    if (blkdev_flush(volume_info.device) != 0) return -3;
+    uint32_t old = file->first_cluster, old_last = file->last_cluster;
+    file->first_cluster = start; file->last_cluster = start + count - 1; file->cursor_cluster = 0;
+    if (entry_update(file) != 0 || blkdev_flush(volume_info.device) != 0) {
+        file->first_cluster = old; file->last_cluster = old_last; // The new chain is the orphan
+        return -3;
+    }
+    pagecache_truncate(old, 0); // Cached pages are keyed by the old first cluster
+
+    // 3. Free the old clusters
+    c = old;
+    for (n = 0; n < count && valid_cluster(c); ++n) {
+        uint32_t next = fat_get(c);
+        if (fat_set(c, FAT32_FREE_CLUSTER) != 0) return -3;
+        if (c < volume_info.next_free_cluster) volume_info.next_free_cluster = c;
+        c = next;
+    }
+    if ((r = fat32_sync()) != 0) return r;
+    return blkdev_flush(volume_info.device) == 0 ? 1 : -3;
+}
+
+static int fat32_flush_locked(Fat32File *file) {
+    if (!is_initialized || !file) return -1;
+    int slot = wb_find(file);
+    return slot >= 0 ? wb_flush(slot) : 0;
+}
+
+static int fat32_sync_locked(void) {
+    if (!is_initialized) return -1;
+    int r = 0;
+    for (int i = 0; i < WRITEBACK_SLOTS; ++i) { int f = wb_flush(i); if (r == 0) r = f; }
+    int w = fat_cache_writeback();
+    if (r == 0) r = w;
+    if (fsinfo_dirty && volume_info.bpb.fsinfo_sector != 0 && volume_info.bpb.fsinfo_sector != 0xFFFF) {
+        uint32_t lba = volume_info.partition_start_lba + volume_info.bpb.fsinfo_sector;
+        if (blkdev_read(volume_info.device, lba, 1, sector_buffer) == 0 && *(uint32_t*)&sector_buffer[0] == FSINFO_LEAD_SIG) {
+            *(uint32_t*)&sector_buffer[488] = volume_info.free_clusters;
+            *(uint32_t*)&sector_buffer[492] = volume_info.next_free_cluster;
+            if (blkdev_write(volume_info.device, lba, 1, sector_buffer) != 0 && r == 0) r = -3;
+        }
+        fsinfo_dirty = 0;
+    }
+    return r;
+}
+
+// --- Locked Entry Points ---
+int fat32_init(blkdev_t *dev, uint32_t partition_start_lba) {
+    fat32_lock();
+    int r = fat32_init_locked(dev, partition_start_lba);
+    fat32_unlock();
+    return r;
+}
+
+uint32_t fat32_get_next_cluster(uint32_t current_cluster) {
+    fat32_lock();
+    uint32_t r = fat32_get_next_cluster_locked(current_cluster);
+    fat32_unlock();
+    return r;
+}
+
+uint32_t fat32_chain_extents(uint32_t first_cluster, uint32_t *clusters) {
+    fat32_lock();
+    uint32_t r = fat32_chain_extents_locked(first_cluster, clusters);
+    fat32_unlock();
+    return r;
+}
+
+int fat32_dir_read(Fat32DirCursor *cursor, Fat32DirEntryInfo *out, int max) {
+    fat32_lock();
+    int r = fat32_dir_read_locked(cursor, out, max);
+    fat32_unlock();
+    return r;
+}
+
+int fat32_open(uint32_t dir_cluster, const char *name, int flags, Fat32File *file) {
+    fat32_lock();
+    int r = fat32_open_locked(dir_cluster, name, flags, file);
+    fat32_unlock();
+    return r;
+}
+
+int fat32_read(Fat32File *file, void *buffer, uint32_t count) {
+    fat32_lock();
+    int r = fat32_read_locked(file, buffer, count);
+    fat32_unlock();
+    return r;
+}
+
+int fat32_write(Fat32File *file, const void *buffer, uint32_t count) {
+    fat32_lock();
+    int r = fat32_write_locked(file, buffer, count);
+    fat32_unlock();
+    return r;
+}
+
+int fat32_truncate(Fat32File *file, uint32_t size) {
+    fat32_lock();
+    int r = fat32_truncate_locked(file, size);
+    fat32_unlock();
+    return r;
+}
+
+int fat32_close(Fat32File *file) {
+    fat32_lock();
+    int r = fat32_close_locked(file);
+    fat32_unlock();
+    return r;
+}
+
+int fat32_mkdir(uint32_t dir_cluster, const char *name) {
+    fat32_lock();
+    int r = fat32_mkdir_locked(dir_cluster, name);
+    fat32_unlock();
+    return r;
+}
+
+int fat32_defrag(Fat32File *file) {
+    fat32_lock();
+    int r = fat32_defrag_locked(file);
+    fat32_unlock();
+    return r;
+}
+
+int fat32_flush(Fat32File *file) {
+    fat32_lock();
+    int r = fat32_flush_locked(file);
+    fat32_unlock();
+    return r;
+}
+
+int fat32_sync(void) {
+    fat32_lock();
+    int r = fat32_sync_locked();
+    fat32_unlock();
+    return r;
+}
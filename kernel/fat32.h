@@ -6,6 +6,7 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include "blkdev.h"
 
 // --- FAT32 On-Disk Structures ---
 typedef struct __attribute__((packed)) { // Fat32BiosParameterBlock
@@ -18,12 +19,17 @@ typedef struct __attribute__((packed)) { // Fat32BiosParameterBlock
     uint32_t volume_id; char volume_label[11]; char fs_type[8];
 } Fat32BiosParameterBlock;
 
-typedef struct __attribute__((packed)) { // Fat32DirectoryEntry
-     union { char short_name[11]; struct { uint8_t sequence_number; uint16_t name1[5]; uint8_t attributes; uint8_t type; uint8_t checksum; uint16_t name2[6]; uint16_t first_cluster_low; uint16_t name3[2]; } lfn; };
-    uint8_t attributes; uint8_t reserved_nt; uint8_t creation_time_tenths; uint16_t creation_time; uint16_t creation_date;
-    uint16_t last_access_date; uint16_t first_cluster_high; uint16_t last_write_time; uint16_t last_write_date;
-    uint16_t first_cluster_low; uint32_t file_size;
+typedef struct __attribute__((packed)) { // Fat32DirectoryEntry (32 bytes; the LFN view overlays the whole entry)
+    union {
+        struct __attribute__((packed)) {
+            char short_name[11]; uint8_t attributes; uint8_t reserved_nt; uint8_t creation_time_tenths; uint16_t creation_time;
+            uint16_t creation_date; uint16_t last_access_date; uint16_t first_cluster_high; uint16_t last_write_time;
+            uint16_t last_write_date; uint16_t first_cluster_low; uint32_t file_size;
+        };
+        struct __attribute__((packed)) { uint8_t sequence_number; uint16_t name1[5]; uint8_t attributes; uint8_t type; uint8_t checksum; uint16_t name2[6]; uint16_t first_cluster_low; uint16_t name3[2]; } lfn;
+    };
 } Fat32DirectoryEntry;
+_Static_assert(sizeof(Fat32DirectoryEntry) == 32, "directory entries are 32 bytes");
 
 // Directory Entry Attributes
 #define ATTR_READ_ONLY  0x01
@@ -34,13 +40,10 @@ typedef struct __attribute__((packed)) { // Fat32DirectoryEntry
 #define ATTR_ARCHIVE    0x20
 #define ATTR_LONG_NAME  (ATTR_READ_ONLY | ATTR_HIDDEN | ATTR_SYSTEM | ATTR_VOLUME_ID)
 
-// --- Assumed Disk Driver Interface ---
-int read_sectors(uint32_t lba, uint16_t count, void* buffer);
-int write_sectors(uint32_t lba, uint16_t count, const void* buffer);
-
 // --- FAT32 Driver State ---
 // *** CORRECTED Member Names ***
 typedef struct {
+    blkdev_t *device;               // Block device the volume is mounted from
     uint32_t partition_start_lba;   // LBA partition start sector
     Fat32BiosParameterBlock bpb;    // Parsed BPB
     uint32_t fat_start_lba;         // LBA of first sector of first FAT
@@ -49,16 +52,116 @@ typedef struct {
     uint32_t total_sectors;         // Total sectors in the partition
     uint32_t total_clusters;        // Total data clusters in the partition
     uint32_t bytes_per_cluster;     // Bytes per allocation cluster
+    uint32_t free_clusters;         // FSInfo free count (0xFFFFFFFF = unknown), kept up to date
+    uint32_t next_free_cluster;     // FSInfo allocation hint (0xFFFFFFFF = none)
 } Fat32VolumeInfo;
 
+// FAT entry values (low 28 bits)
+#define FAT32_FREE_CLUSTER  0x00000000
+#define FAT32_BAD_CLUSTER   0x0FFFFFF7
+#define FAT32_EOC_MIN       0x0FFFFFF8 // End of chain: any value >= this
+#define FAT32_EOC           0x0FFFFFFF // What the driver writes
+
+// Open file. Written data is held in a write-back buffer and only gets
+// clusters when it is flushed (buffer full, close, sync), so each flush
+// allocates one contiguous run for everything buffered. The driver keeps a
+// pointer to it while data is buffered: it must stay put until closed.
+typedef struct {
+    uint32_t dir_cluster;           // Directory holding the entry
+    uint32_t entry_lba;             // Sector holding the short directory entry
+    uint32_t entry_offset;          // Byte offset of the entry within that sector
+    uint8_t attributes;
+    int entry_dirty;                // Size / first cluster changed since the entry was written
+    uint32_t first_cluster;         // 0 while nothing is allocated
+    uint32_t last_cluster;          // Tail of the chain
+    uint32_t clusters;              // Clusters in the chain
+    uint32_t size;                  // Bytes, including data still buffered
+    uint32_t position;              // Read/write offset (0..size)
+    uint32_t cursor_index;          // Chain position of the last cluster looked up, so
+    uint32_t cursor_cluster;        // forward seeks resume there (0: walk from the head)
+} Fat32File;
+
+// fat32_open() flags
+#define FAT32_OPEN_CREATE   0x01    // Create the file if it does not exist
+#define FAT32_OPEN_TRUNCATE 0x02    // Cut an existing file to 0 bytes
+
 // --- Function Prototypes ---
-int fat32_init(uint32_t partition_start_lba);
+// All calls below (except the trivial getters) hold the driver lock.
+// fat32_lock() takes it across several calls, e.g. to check the volume
+// while nobody changes it; it is recursive. Thread context only.
+void fat32_lock(void);
+void fat32_unlock(void);
+// Mounts the FAT32 volume starting at 'partition_start_lba' on 'dev'
+// (0 for a device holding a bare partition image, e.g. a RAM disk).
+// Replaces any previously mounted volume. Returns 0 on success, -7 (and
+// leaves the old volume mounted) while files of it are mapped.
+int fat32_init(blkdev_t *dev, uint32_t partition_start_lba);
 const Fat32VolumeInfo* fat32_get_volume_info(void); // Corrected name usage needed here too if accessed directly
 uint32_t fat32_cluster_to_lba(uint32_t cluster);
 uint32_t fat32_get_next_cluster(uint32_t current_cluster);
-typedef void (*fat32_dir_entry_callback)(Fat32DirectoryEntry *entry, const char* short_name, void *user_data);
-int fat32_read_directory(uint32_t directory_cluster, fat32_dir_entry_callback callback, void *user_data);
+// Runs of consecutive clusters in the chain from 'first_cluster' (0 for
+// none); its length goes to *clusters unless that is NULL.
+uint32_t fat32_chain_extents(uint32_t first_cluster, uint32_t *clusters);
+
+// --- Directory Iteration ---
+// getdents-style: a cursor remembers where the last call stopped, and each
+// fat32_dir_read() fills an array with decoded entries from there on, so a
+// long directory is paged through without rescanning from the start.
+#define FAT32_NAME_MAX 255
+
+typedef struct {                    // Opaque to callers: set up by fat32_dir_open()
+    uint32_t cluster;               // Cluster holding the next entry to look at (0 = end reached)
+    uint32_t index;                 // Entry index within that cluster
+} Fat32DirCursor;
+
+typedef struct {
+    char name[FAT32_NAME_MAX + 1];  // Long name if present (non-ASCII as '?'), else the 8.3 name
+    char short_name[13];            // 8.3 name, "NAME.EXT"
+    uint8_t attributes;
+    uint32_t size;
+    uint32_t first_cluster;
+} Fat32DirEntryInfo;
+
+// Positions 'cursor' at the first entry of the directory at 'directory_cluster'.
+int fat32_dir_open(uint32_t directory_cluster, Fat32DirCursor *cursor);
+// Decodes up to 'max' entries (deleted entries, volume labels and "."/".."
+// skipped) into 'out' and advances the cursor past them. Returns the count,
+// 0 once the end of the directory is reached, or negative on error.
+int fat32_dir_read(Fat32DirCursor *cursor, Fat32DirEntryInfo *out, int max);
 uint32_t fat32_get_current_directory_cluster(void);
 void fat32_set_current_directory_cluster(uint32_t cluster);
 
+// --- Write Path ---
+// Names are 8.3 short names ("readme.txt"), looked up case-insensitively in
+// the directory starting at 'dir_cluster'. All calls return 0 (or a byte
+// count) on success and a negative value on error: -1 bad argument / not
+// found, -2 exists / wrong type, -3 I/O error, -4 volume or directory full,
+// -5 the file is mapped (shrinking it, FAT32_OPEN_TRUNCATE included).
+int fat32_open(uint32_t dir_cluster, const char *name, int flags, Fat32File *file);
+int fat32_read(Fat32File *file, void *buffer, uint32_t count);
+int fat32_write(Fat32File *file, const void *buffer, uint32_t count);
+int fat32_seek(Fat32File *file, uint32_t position);         // position <= size
+int fat32_truncate(Fat32File *file, uint32_t size);         // Shrink only
+// Flushes buffered data, syncs the FAT and rewrites the directory entry.
+int fat32_close(Fat32File *file);
+int fat32_mkdir(uint32_t dir_cluster, const char *name);
+// Moves a fragmented file into one free contiguous run: the data is copied
+// first, then the copy gets a chain of its own, then the directory entry
+// switches to it, and only then are the old clusters freed, each step on
+// disk before the next. A crash leaves the old or the new file intact plus
+// at most one orphaned chain. Returns 1 if moved, 0 if already contiguous,
+// -4 if no free run is long enough, -5 if the file is mapped. The driver
+// keeps no table of open handles, so it cannot refuse a file that is open
+// through another handle: that handle would go on reading the old, freed
+// clusters. Callers must rule that out themselves.
+int fat32_defrag(Fat32File *file);
+// Gives the data 'file' has buffered its clusters and writes it out, so
+// other handles can read it. Leaves the FAT and the entry to fat32_sync()
+// and fat32_close().
+int fat32_flush(Fat32File *file);
+// Flushes all write-back buffers, then writes every dirty FAT sector to all
+// FAT copies (one sorted pass, contiguous dirty sectors in a single transfer
+// per copy) and FSInfo. Directory entries are updated by fat32_close().
+int fat32_sync(void);
+
 #endif // FAT32_H
\ No newline at end of file
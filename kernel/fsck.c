@@ -0,0 +1,302 @@
+// kernel/fsck.c
+// FAT32 consistency check. Readably formatted.
+
+#include "fsck.h"
+#include "fat32.h"
+#include "mmap.h"
+#include "paging.h"
+#include "string.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define ENTRIES_PER_PAGE (PAGE_SIZE / 4)
+#define BITS_PER_PAGE    (PAGE_SIZE * 8)
+
+// Why mark_chain() stopped early
+#define CHAIN_OK        0
+#define CHAIN_CROSS     1   // Ran into a cluster already reached
+#define CHAIN_BAD_END   2   // Next value is free, reserved or out of range
+
+typedef struct { uint32_t first, clusters; } PendingDir;
+
+// --- Module State ---
+static const Fat32VolumeInfo *vol;
+static uint32_t *fat_pages[FSCK_MAX_FAT_PAGES];             // Pool frames (identity-mapped)
+static uint8_t fat_dirty[FSCK_MAX_FAT_PAGES];
+static uint32_t *used_pages[FSCK_MAX_FAT_PAGES / 32];       // One bit per cluster
+static uint32_t fat_page_count, used_page_count;
+static uint8_t batch[FSCK_BATCH_SECTORS * 512];             // FAT batch or one directory cluster
+static PendingDir dirs[FSCK_MAX_DIRS];
+static uint32_t dir_count;
+static int repair;
+static fsck_report_t *rep;
+static int wrote;                                          // Some block was (or may have been) written
+
+// --- FAT Copy and Bitmap ---
+static int valid_cluster(uint32_t c) { return c >= 2 && c < vol->total_clusters + 2; }
+static uint32_t fat_at(uint32_t c) { return fat_pages[c / ENTRIES_PER_PAGE][c % ENTRIES_PER_PAGE] & 0x0FFFFFFF; }
+
+static void fat_put(uint32_t c, uint32_t value) {
+    uint32_t *e = &fat_pages[c / ENTRIES_PER_PAGE][c % ENTRIES_PER_PAGE];
+    *e = (*e & 0xF0000000) | value;
+    fat_dirty[c / ENTRIES_PER_PAGE] = 1;
+}
+
+static int is_used(uint32_t c) { return (used_pages[c / BITS_PER_PAGE][(c % BITS_PER_PAGE) / 32] >> (c % 32)) & 1; }
+static void set_used(uint32_t c, int on) {
+    uint32_t *w = &used_pages[c / BITS_PER_PAGE][(c % BITS_PER_PAGE) / 32];
+    if (on) *w |= 1u << (c % 32); else *w &= ~(1u << (c % 32));
+}
+
+static void release_pages(void) {
+    for (uint32_t i = 0; i < fat_page_count; ++i) frame_free((uint32_t)fat_pages[i]);
+    for (uint32_t i = 0; i < used_page_count; ++i) frame_free((uint32_t)used_pages[i]);
+    fat_page_count = used_page_count = 0;
+}
+
+// Every write goes through here, so the driver's caches get dropped after
+// any change to the disk, even a repair that stops halfway.
+static int write_blocks(uint32_t lba, uint32_t count, const void *buffer) {
+    wrote = 1;
+    return blkdev_write(vol->device, lba, count, buffer);
+}
+
+// Reads the active FAT front to back, FSCK_BATCH_SECTORS at a time, and
+// sets up an empty bitmap.
+static int load_fat(void) {
+    uint32_t entries = vol->total_clusters + 2;
+    uint32_t pages = (entries + ENTRIES_PER_PAGE - 1) / ENTRIES_PER_PAGE;
+    uint32_t bitmap_pages = (entries + BITS_PER_PAGE - 1) / BITS_PER_PAGE;
+    if (pages > FSCK_MAX_FAT_PAGES) return -4;
+    for (; fat_page_count < pages; ++fat_page_count) {
+        if (!(fat_pages[fat_page_count] = (uint32_t*)frame_alloc())) return -4;
+    }
+    for (; used_page_count < bitmap_pages; ++used_page_count) {
+        if (!(used_pages[used_page_count] = (uint32_t*)frame_alloc())) return -4;
+        memset(used_pages[used_page_count], 0, PAGE_SIZE);
+    }
+    memset(fat_dirty, 0, sizeof(fat_dirty));
+
+    uint32_t fat = (vol->bpb.flags & 0x80) ? (vol->bpb.flags & 0x0F) : 0;
+    uint32_t lba = vol->fat_start_lba + fat * vol->sectors_per_fat;
+    uint32_t total = pages * (PAGE_SIZE / 512), readable = total < vol->sectors_per_fat ? total : vol->sectors_per_fat;
+    for (uint32_t s = 0; s < total; ) {
+        uint32_t n = total - s < FSCK_BATCH_SECTORS ? total - s : FSCK_BATCH_SECTORS;
+        if (s < readable) {
+            uint32_t r = readable - s < n ? readable - s : n;
+            if (blkdev_read(vol->device, lba + s, r, batch) != 0) return -3;
+            memset(batch + r * 512, 0, (n - r) * 512);
+            rep->fat_reads++;
+        } else {
+            memset(batch, 0, n * 512);
+        }
+        for (uint32_t k = 0; k < n; ++k) {
+            uint32_t sector = s + k;
+            memcpy((uint8_t*)fat_pages[sector / 8] + (sector % 8) * 512, batch + k * 512, 512);
+        }
+        s += n;
+    }
+    return 0;
+}
+
+// Writes the FAT pages repairs changed to every FAT copy, runs of dirty
+// pages gathered into one transfer each.
+static int store_fat(void) {
+    int mirrored = !(vol->bpb.flags & 0x80);
+    uint32_t first_fat = mirrored ? 0 : (vol->bpb.flags & 0x0F);
+    uint32_t last_fat = mirrored ? vol->bpb.num_fats : first_fat + 1;
+    uint32_t per_batch = FSCK_BATCH_SECTORS / 8;
+    for (uint32_t p = 0; p < fat_page_count; ) {
+        if (!fat_dirty[p]) { ++p; continue; }
+        uint32_t q = p;
+        while (q < fat_page_count && q - p < per_batch && fat_dirty[q]) {
+            memcpy(batch + (q - p) * PAGE_SIZE, fat_pages[q], PAGE_SIZE);
+            ++q;
+        }
+        uint32_t first = p * 8, count = (q - p) * 8;
+        if (first + count > vol->sectors_per_fat) count = vol->sectors_per_fat - first;
+        for (uint32_t fat = first_fat; fat < last_fat; ++fat) {
+            if (write_blocks(vol->fat_start_lba + fat * vol->sectors_per_fat + first, count, batch) != 0) return -3;
+        }
+        p = q;
+    }
+    return 0;
+}
+
+// --- Tree Walk ---
+// Marks the chain from 'first' as used, stopping at its end or at the
+// first problem (returned). *clusters gets the clusters marked, *last the
+// final one of them (0 if none).
+static int mark_chain(uint32_t first, uint32_t *clusters, uint32_t *last) {
+    uint32_t c = first, n = 0;
+    *last = 0;
+    for (;;) {
+        if (is_used(c)) { *clusters = n; return CHAIN_CROSS; }
+        set_used(c, 1);
+        n++; *last = c;
+        uint32_t next = fat_at(c);
+        if (next >= FAT32_EOC_MIN) break;
+        if (!valid_cluster(next)) { *clusters = n; return CHAIN_BAD_END; }
+        c = next;
+    }
+    *clusters = n;
+    return CHAIN_OK;
+}
+
+// Cuts the chain from 'first' after 'keep' clusters and frees the rest.
+static void trim_chain(uint32_t first, uint32_t keep) {
+    uint32_t c = first;
+    for (uint32_t i = 1; i < keep; ++i) c = fat_at(c);
+    uint32_t next = fat_at(c);
+    fat_put(c, FAT32_EOC);
+    while (valid_cluster(next) && is_used(next)) {
+        c = next; next = fat_at(c);
+        fat_put(c, FAT32_FREE_CLUSTER);
+        set_used(c, 0);
+    }
+}
+
+// Checks one short entry and its chain. Returns 1 if the entry was changed.
+static int check_entry(Fat32DirectoryEntry *e) {
+    uint32_t bpc = vol->bytes_per_cluster, clusters = 0, last = 0;
+    uint32_t first = ((uint32_t)e->first_cluster_high << 16) | e->first_cluster_low;
+    int is_dir = (e->attributes & ATTR_DIRECTORY) != 0, changed = 0;
+    if (is_dir) rep->directories++; else rep->files++;
+
+    if (first != 0 && !valid_cluster(first)) {
+        rep->bad_entries++;
+        if (repair) { first = 0; changed = 1; }
+    } else if (first != 0) {
+        int problem = mark_chain(first, &clusters, &last);
+        if (problem == CHAIN_CROSS) {
+            rep->cross_links++;
+            if (repair) { if (last) fat_put(last, FAT32_EOC); else { first = 0; changed = 1; } }
+        } else if (problem == CHAIN_BAD_END) {
+            rep->bad_chain_ends++;
+            if (repair) fat_put(last, FAT32_EOC);
+        }
+    }
+
+    if (is_dir) {
+        if (e->file_size != 0) { rep->size_mismatches++; if (repair) { e->file_size = 0; changed = 1; } }
+        if (clusters > 0) {
+            if (dir_count == FSCK_MAX_DIRS) return -4;
+            dirs[dir_count].first = first; dirs[dir_count].clusters = clusters; dir_count++;
+        }
+    } else {
+        uint32_t expected = e->file_size / bpc + (e->file_size % bpc != 0);
+        if (clusters != expected) {
+            rep->size_mismatches++;
+            if (repair && clusters < expected) {
+                e->file_size = clusters * bpc; changed = 1;
+            } else if (repair) {
+                if (expected == 0) { // Nothing to keep: the whole chain goes
+                    for (uint32_t c = first, i = 0; i < clusters; ++i) { uint32_t n = fat_at(c); fat_put(c, FAT32_FREE_CLUSTER); set_used(c, 0); c = n; }
+                    first = 0; changed = 1;
+                } else {
+                    trim_chain(first, expected);
+                }
+            }
+        }
+    }
+    if (changed) {
+        e->first_cluster_high = (uint16_t)(first >> 16);
+        e->first_cluster_low = (uint16_t)(first & 0xFFFF);
+    }
+    return changed;
+}
+
+// Scans one directory's clusters, queueing its subdirectories.
+static int scan_dir(const PendingDir *d) {
+    uint32_t spc = vol->bpb.sectors_per_cluster, c = d->first;
+    for (uint32_t i = 0; i < d->clusters; ++i, c = fat_at(c)) {
+        uint32_t lba = fat32_cluster_to_lba(c), dirty = 0;
+        if (blkdev_read(vol->device, lba, spc, batch) != 0) return -3;
+        Fat32DirectoryEntry *e = (Fat32DirectoryEntry*)batch;
+        uint32_t count = vol->bytes_per_cluster / sizeof(Fat32DirectoryEntry), k;
+        for (k = 0; k < count; ++k, ++e) {
+            uint8_t fb = (uint8_t)e->short_name[0];
+            if (fb == 0x00) break;
+            if (fb == 0xE5 || e->attributes == ATTR_LONG_NAME || (e->attributes & ATTR_VOLUME_ID)) continue;
+            if (fb == '.' && (e->short_name[1] == ' ' || e->short_name[1] == '.')) continue;
+            int r = check_entry(e);
+            if (r < 0) return r;
+            dirty |= (uint32_t)r;
+        }
+        if (dirty && write_blocks(lba, spc, batch) != 0) return -3;
+        if (k < count) break; // End marker
+    }
+    return 0;
+}
+
+// Rewrites the FSInfo free count.
+static int store_fsinfo(uint32_t free_count) {
+    uint32_t lba = vol->partition_start_lba + vol->bpb.fsinfo_sector;
+    if (vol->bpb.fsinfo_sector == 0 || vol->bpb.fsinfo_sector == 0xFFFF) return 0;
+    if (blkdev_read(vol->device, lba, 1, batch) != 0) return -3;
+    *(uint32_t*)&batch[488] = free_count;
+    return write_blocks(lba, 1, batch) == 0 ? 0 : -3;
+}
+
+static int check(void) {
+    int r = load_fat();
+    if (r != 0) return r;
+
+    uint32_t root = vol->bpb.root_dir_cluster, clusters, last;
+    if (!valid_cluster(root)) return -3;
+    int problem = mark_chain(root, &clusters, &last);
+    if (problem == CHAIN_BAD_END) { rep->bad_chain_ends++; if (repair) fat_put(last, FAT32_EOC); }
+    dirs[0].first = root; dirs[0].clusters = clusters; dir_count = 1;
+    while (dir_count > 0) {
+        PendingDir d = dirs[--dir_count];
+        if ((r = scan_dir(&d)) != 0) return r;
+    }
+
+    // One pass over the whole FAT: allocated but unreached is lost
+    for (uint32_t c = 2; c < vol->total_clusters + 2; ++c) {
+        uint32_t v = fat_at(c);
+        if (is_used(c)) rep->used_clusters++;
+        else if (v == FAT32_FREE_CLUSTER) rep->free_clusters++;
+        else if (v != FAT32_BAD_CLUSTER) {
+            rep->lost_clusters++;
+            if (repair) { fat_put(c, FAT32_FREE_CLUSTER); rep->free_clusters++; }
+        }
+    }
+    int fsinfo_wrong = rep->fsinfo_free != 0xFFFFFFFF && rep->fsinfo_free != rep->free_clusters;
+    int problems = rep->cross_links || rep->lost_clusters || rep->bad_chain_ends || rep->size_mismatches || rep->bad_entries || fsinfo_wrong;
+    if (!problems) return 0;
+    if (!repair) return 1;
+
+    // Directory entries are already written: the FAT changes only free what they no longer use
+    if ((r = store_fat()) != 0 || (r = store_fsinfo(rep->free_clusters)) != 0) return r;
+    if (blkdev_flush(vol->device) != 0) return -3;
+    rep->repaired = 1;
+    return 0;
+}
+
+static int fsck_run_locked(int flags, fsck_report_t *report) {
+    if (!report || !fat32_get_volume_info()) return -1;
+    memset(report, 0, sizeof(*report));
+    if ((flags & FSCK_REPAIR) && fat32_mmap_count()) return -5; // Repairs end in a remount
+    int r = fat32_sync(); // The FAT on disk must be the current one
+    if (r != 0) return r;
+    vol = fat32_get_volume_info();
+    rep = report;
+    repair = (flags & FSCK_REPAIR) != 0;
+    wrote = 0;
+    rep->fsinfo_free = vol->free_clusters;
+    r = check();
+    release_pages();
+    // Drop everything the driver cached about the old state, also when a
+    // repair stopped halfway
+    if (wrote && fat32_init(vol->device, vol->partition_start_lba) != 0) return -3;
+    return r;
+}
+
+// --- Public Functions ---
+int fsck_run(int flags, fsck_report_t *report) {
+    fat32_lock(); // Nobody changes the volume while it is checked
+    int r = fsck_run_locked(flags, report);
+    fat32_unlock();
+    return r;
+}
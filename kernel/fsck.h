@@ -0,0 +1,44 @@
+// kernel/fsck.h
+// FAT32 consistency check. The active FAT is read into pool frames in large
+// sequential batches, then the directory tree is walked against that copy
+// while a used-cluster bitmap is built: a cluster reached twice is
+// cross-linked, and one final linear pass over the FAT finds allocated
+// clusters nothing reached and counts the free ones. Readably formatted.
+
+#ifndef FSCK_H
+#define FSCK_H
+
+#include <stdint.h>
+
+#define FSCK_MAX_FAT_PAGES 1024 // FAT held in memory, 4 KiB each: up to 1M clusters
+#define FSCK_BATCH_SECTORS 128  // FAT sectors per read; also fits the largest cluster
+#define FSCK_MAX_DIRS      512  // Directories found but not yet scanned
+
+// fsck_run() flags
+#define FSCK_REPAIR 0x01
+
+typedef struct {
+    uint32_t files, directories;
+    uint32_t used_clusters;     // Reached from the root directory
+    uint32_t free_clusters;     // FAT entries that are free (after repairs)
+    uint32_t fsinfo_free;       // FSInfo free count (0xFFFFFFFF = unknown)
+    uint32_t cross_links;       // Chains running into a cluster already reached
+    uint32_t lost_clusters;     // Allocated, but reached from no directory entry
+    uint32_t bad_chain_ends;    // Chains ending in a free, reserved or out-of-range value
+    uint32_t size_mismatches;   // File size vs chain length, or a directory with a size
+    uint32_t bad_entries;       // First cluster out of range
+    uint32_t fat_reads;         // Read requests for the whole FAT
+    int repaired;               // Fixes were written and the volume remounted
+} fsck_report_t;
+
+// Checks the mounted volume, holding the FAT32 driver lock throughout. With
+// FSCK_REPAIR, cross-linked and overlong chains are cut, bad chain ends get
+// an end-of-chain marker, file sizes are clipped to their chains, lost
+// clusters are freed and FSInfo gets the real free count; then the volume
+// is remounted (also after a repair that failed partway through). Returns 0 if the volume is clean or was repaired, 1 if
+// problems remain, -1 if nothing is mounted, -3 on I/O error, -4 if the
+// FAT does not fit in memory or the tree has too many directories, -5 if
+// repairs were asked for while files are mapped.
+int fsck_run(int flags, fsck_report_t *report);
+
+#endif // FSCK_H
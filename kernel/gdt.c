@@ -0,0 +1,69 @@
+// kernel/gdt.c
+// Kernel-owned Global Descriptor Table (flat 4 GiB code/data, ring 0). Readably formatted.
+
+#include "gdt.h"
+#include <stdint.h>
+
+// --- GDT Structures ---
+typedef struct __attribute__((packed)) {
+    uint16_t limit_low;
+    uint16_t base_low;
+    uint8_t  base_mid;
+    uint8_t  access;
+    uint8_t  granularity; // High nibble: flags (G, D/B), low nibble: limit bits 16-19
+    uint8_t  base_high;
+} GdtEntry;
+
+typedef struct __attribute__((packed)) {
+    uint16_t limit;
+    uint32_t base;
+} GdtPointer;
+
+// --- Module State ---
+#define GDT_ENTRIES (GDT_FIRST_CPU_ENTRY + MAX_CPUS)
+static GdtEntry gdt[GDT_ENTRIES];
+static GdtPointer gdt_ptr;
+
+// --- Helpers ---
+static void gdt_set_entry(int i, uint32_t base, uint32_t limit, uint8_t access, uint8_t flags) {
+    gdt[i].limit_low = limit & 0xFFFF;
+    gdt[i].base_low = base & 0xFFFF;
+    gdt[i].base_mid = (base >> 16) & 0xFF;
+    gdt[i].access = access;
+    gdt[i].granularity = (uint8_t)((flags & 0xF0) | ((limit >> 16) & 0x0F));
+    gdt[i].base_high = (base >> 24) & 0xFF;
+}
+
+// --- Public Functions ---
+void gdt_init(void) {
+    gdt_set_entry(0, 0, 0, 0, 0);                // Null descriptor
+    gdt_set_entry(1, 0, 0xFFFFF, 0x9A, 0xC0);    // Code: P=1, DPL=0, Execute/Read; G=1, D=1
+    gdt_set_entry(2, 0, 0xFFFFF, 0x92, 0xC0);    // Data: P=1, DPL=0, Read/Write;   G=1, D=1
+
+    gdt_ptr.limit = sizeof(gdt) - 1;
+    gdt_ptr.base = (uint32_t)&gdt;
+    gdt_load();
+}
+
+void gdt_load(void) {
+    asm volatile (
+        "lgdt %0\n\t"
+        "ljmp %1, $1f\n"       // Reload CS with a far jump
+        "1:\n\t"
+        "movw %2, %%ax\n\t"
+        "movw %%ax, %%ds\n\t"
+        "movw %%ax, %%es\n\t"
+        "movw %%ax, %%fs\n\t"
+        "movw %%ax, %%gs\n\t"
+        "movw %%ax, %%ss\n\t"
+        : : "m"(gdt_ptr), "i"(GDT_KERNEL_CODE), "i"(GDT_KERNEL_DATA) : "eax", "memory");
+}
+
+void gdt_set_cpu_segment(uint32_t index, uint32_t base, uint32_t limit) {
+    // Byte-granular data segment: P=1, DPL=0, Read/Write; G=0, D=1
+    gdt_set_entry(GDT_FIRST_CPU_ENTRY + index, base, limit, 0x92, 0x40);
+}
+
+uint16_t gdt_cpu_selector(uint32_t index) {
+    return (uint16_t)((GDT_FIRST_CPU_ENTRY + index) * sizeof(GdtEntry));
+}
@@ -0,0 +1,27 @@
+// kernel/gdt.h
+// Kernel-owned Global Descriptor Table. Readably formatted.
+
+#ifndef GDT_H
+#define GDT_H
+
+#include <stdint.h>
+#include "cpu.h"
+
+// Segment selectors (same layout the bootloader used, so nothing changes for CS/DS)
+#define GDT_KERNEL_CODE 0x08
+#define GDT_KERNEL_DATA 0x10
+#define GDT_FIRST_CPU_ENTRY 3 // Entries 3.. are per-CPU data segments (GS), see cpu.c
+
+// Loads the kernel GDT and reloads all segment registers.
+// The bootloader's GDT lives inside the boot sector at 0x7C00, which is
+// reclaimed by the kernel's .bss, so this must run before interrupts are enabled.
+void gdt_init(void);
+
+// Reloads the (already built) kernel GDT on an application processor.
+void gdt_load(void);
+
+// Installs the per-CPU data segment for CPU 'index' (base = its cpu_t).
+void gdt_set_cpu_segment(uint32_t index, uint32_t base, uint32_t limit);
+uint16_t gdt_cpu_selector(uint32_t index);
+
+#endif // GDT_H
@@ -1,28 +1,50 @@
 // kernel/ide.c
-// Complete File - Basic IDE/PATA PIO Driver Implementation. Readably formatted.
+// Complete File - Basic IDE/PATA PIO Driver Implementation behind a request queue. Readably formatted.
 
 #include "ide.h"
 #include "io.h"     // For inb, outb, insw, outsw, term_*
+#include "blkq.h"
+#include "blkdev.h"
+#include "string.h"
+#include "thread.h"
 #include <stdint.h>
 
+// --- Module State ---
+typedef struct {
+    int present;
+    uint16_t io;            // Channel command block base (IDE_PRIMARY_IO / IDE_SECONDARY_IO)
+    uint16_t ctrl;          // Channel control block base
+    uint8_t select;         // IDE_DRIVE_SLAVE or 0
+    mutex_t *channel;       // Shared with the other drive on the same channel
+    uint32_t sectors;       // LBA28 capacity from IDENTIFY
+    blk_queue_t queue;      // All I/O for this drive goes through here
+    blkdev_t dev;           // "hd<n>" in the block-device registry
+} ide_drive_t;
+
+// One lock per channel: master and slave share the task-file registers, so
+// only one of them may have a command in progress. The channels themselves
+// are independent and their queues' dispatch threads run side by side.
+static mutex_t ide_channel_lock[2];
+static ide_drive_t ide_drives[IDE_MAX_DRIVES];
+
 // --- Helper Functions ---
 
 // Reads the status register with appropriate delay
-static inline uint8_t ide_read_status() {
+static inline uint8_t ide_read_status(ide_drive_t *d) {
     // Reading alternate status multiple times provides a needed delay
     // (approx 400ns) without affecting interrupts.
-    inb(IDE_ALT_STATUS_REG);
-    inb(IDE_ALT_STATUS_REG);
-    inb(IDE_ALT_STATUS_REG);
-    inb(IDE_ALT_STATUS_REG);
-    return inb(IDE_STATUS_REG); // Read actual status
+    inb(d->ctrl + IDE_ALT_STATUS_REG);
+    inb(d->ctrl + IDE_ALT_STATUS_REG);
+    inb(d->ctrl + IDE_ALT_STATUS_REG);
+    inb(d->ctrl + IDE_ALT_STATUS_REG);
+    return inb(d->io + IDE_STATUS_REG); // Read actual status
 }
 
 // Polls the IDE status register until BSY (Busy) bit clears.
 // Returns status byte on success, or -1 on timeout.
-static int ide_poll_busy_clear() {
+static int ide_poll_busy_clear(ide_drive_t *d) {
     for(int i = 0; i < 100000; ++i) { // Basic timeout loop
-        uint8_t status = ide_read_status();
+        uint8_t status = ide_read_status(d);
         if (!(status & IDE_STATUS_BSY)) {
             return status; // Return status byte when not busy
         }
@@ -35,8 +57,8 @@ static int ide_poll_busy_clear() {
 // Polls the IDE status register after a command for data transfer readiness (DRQ).
 // Waits for BSY clear, then checks ERR/DF, then waits for DRQ.
 // Returns 0 if DRQ is set, negative on error/timeout.
-static int ide_poll_data_request() {
-    int status = ide_poll_busy_clear();
+static int ide_poll_data_request(ide_drive_t *d) {
+    int status = ide_poll_busy_clear(d);
     if (status < 0) {
         // BSY timeout already reported
         return -1;
@@ -56,7 +78,7 @@ static int ide_poll_data_request() {
 
     // Now wait specifically for DRQ to be set
     for(int i = 0; i < 100000; ++i) {
-        status = ide_read_status();
+        status = ide_read_status(d);
         // Check for errors again while waiting
         if (status & IDE_STATUS_ERR) {
             term_writestring("Error: IDE ERR set while waiting for DRQ!\n");
@@ -80,109 +102,157 @@ static int ide_poll_data_request() {
 
 // --- Public Driver Functions ---
 
-// Initialize the IDE driver. Basic version does little.
-int ide_initialize() {
-    // A real driver would:
-    // - Disable IDE interrupts using IDE_DEV_CTRL_REG if using polling.
-    // - Send IDENTIFY command to both master/slave on primary/secondary buses.
-    // - Parse IDENTIFY data to detect drive type, capabilities (LBA support, DMA modes etc).
-    // - Store drive information.
-    // For now, just assume primary master exists and supports LBA28 PIO.
-    term_writestring("IDE: Basic PIO driver initialized (polling, primary master assumed).\n");
-    return 0; // Assume success
-}
-
-// Reads 'count' sectors using PIO mode.
-int read_sectors(uint32_t lba, uint16_t count, void* buffer) {
-    if (count == 0) return 0;
+// Transfers one merged request chain with a single multi-sector PIO command.
+// The drive raises DRQ once per sector; each sector goes to/from the buffer of
+// whichever request in the chain it belongs to.
+// Caller holds the drive's channel lock.
+static int ide_pio_transfer(ide_drive_t *d, blk_request_t *rq) {
+    uint32_t lba = rq->lba;
+    uint32_t total = rq->merged_count; // 1..256 (0 in the count register means 256)
+    int poll_result;
 
-    uint8_t* current_buf_ptr = (uint8_t*)buffer;
+    poll_result = ide_poll_busy_clear(d); // Wait until the channel is not busy
+    if (poll_result < 0) return -1;
 
-    for (uint16_t i = 0; i < count; ++i) {
-        uint32_t current_lba = lba + i;
-        int poll_result;
+    // Setup LBA28 parameters
+    outb(d->io + IDE_DRIVE_HEAD_REG, IDE_LBA_MODE_BASE | d->select | ((lba >> 24) & 0x0F)); // Drive, LBA mode, LBA bits 24-27
+    if (ide_poll_busy_clear(d) < 0) return -1;                      // Let the drive select settle
+    outb(d->io + IDE_SECTOR_COUNT_REG, (uint8_t)(total & 0xFF));    // Whole chain in one command
+    outb(d->io + IDE_LBA_LOW_REG, (uint8_t)(lba & 0xFF));           // LBA bits 0-7
+    outb(d->io + IDE_LBA_MID_REG, (uint8_t)((lba >> 8) & 0xFF));    // LBA bits 8-15
+    outb(d->io + IDE_LBA_HIGH_REG, (uint8_t)((lba >> 16) & 0xFF));  // LBA bits 16-23
+    outb(d->io + IDE_COMMAND_REG, rq->op == BLK_WRITE ? IDE_CMD_WRITE_PIO : IDE_CMD_READ_PIO);
 
-        // --- Send READ command ---
-        poll_result = ide_poll_busy_clear(); // Wait until drive is not busy
-        if (poll_result < 0) return -1;
+    for (blk_request_t *seg = rq; seg; seg = seg->merge_next) {
+        uint8_t *buf = (uint8_t*)seg->buffer;
+        for (uint32_t i = 0; i < seg->count; ++i, buf += 512) {
+            // Wait for drive to be ready to send/receive the next sector (DRQ)
+            poll_result = ide_poll_data_request(d);
+            if (poll_result != 0) {
+                term_writestring(rq->op == BLK_WRITE ? "IDE Write" : "IDE Read");
+                term_writestring(": Error polling for DRQ.\n");
+                return poll_result;
+            }
+            if (rq->op == BLK_WRITE) outsw(d->io + IDE_DATA_REG, buf, 256);
+            else insw(d->io + IDE_DATA_REG, buf, 256); // 512 bytes (256 words)
+        }
+    }
 
-        // Setup LBA28 parameters
-        outb(IDE_DRIVE_HEAD_REG, IDE_LBA_MODE_BASE | ((current_lba >> 24) & 0x0F)); // Select Master, LBA mode, LBA bits 24-27
-        outb(IDE_SECTOR_COUNT_REG, 1); // We process one sector at a time
-        outb(IDE_LBA_LOW_REG, (uint8_t)(current_lba & 0xFF));           // LBA bits 0-7
-        outb(IDE_LBA_MID_REG, (uint8_t)((current_lba >> 8) & 0xFF));    // LBA bits 8-15
-        outb(IDE_LBA_HIGH_REG, (uint8_t)((current_lba >> 16) & 0xFF)); // LBA bits 16-23
+    if (rq->op == BLK_WRITE) {
+        // --- Flush Cache ---
+        // Crucial step after writing! Once per command rather than per sector.
+        outb(d->io + IDE_COMMAND_REG, IDE_CMD_FLUSH_CACHE);
+        // Wait for the flush to complete (poll until BSY clear)
+        poll_result = ide_poll_busy_clear(d);
+        if (poll_result < 0) {
+            term_writestring("IDE Write: Timeout polling after FLUSH CACHE.\n");
+            return -1;
+        }
+        // Check for errors after flush
+        if (poll_result & (IDE_STATUS_ERR | IDE_STATUS_DF)) {
+            term_writestring("Error: IDE ERR/DF set after FLUSH CACHE.\n");
+            return -6;
+        }
+    }
+    return 0; // Success
+}
 
-        // Issue the read command
-        outb(IDE_COMMAND_REG, IDE_CMD_READ_PIO);
+// IDENTIFY DEVICE on drive 'd'. Returns 0 and the LBA28 capacity in
+// d->sectors, or negative if no ATA disk answers (floating bus, ATAPI, timeout).
+static int ide_identify(ide_drive_t *d) {
+    uint16_t id[256];
+    if (inb(d->io + IDE_STATUS_REG) == 0xFF) return -1; // Floating bus: no channel at all
+    outb(d->io + IDE_DRIVE_HEAD_REG, 0xA0 | d->select);
+    outb(d->io + IDE_SECTOR_COUNT_REG, 0);
+    outb(d->io + IDE_LBA_LOW_REG, 0);
+    outb(d->io + IDE_LBA_MID_REG, 0);
+    outb(d->io + IDE_LBA_HIGH_REG, 0);
+    outb(d->io + IDE_COMMAND_REG, IDE_CMD_IDENTIFY);
+    if (ide_read_status(d) == 0 || ide_read_status(d) == 0xFF) return -1; // No drive
+    if (ide_poll_busy_clear(d) < 0) return -1;
+    if (inb(d->io + IDE_LBA_MID_REG) != 0 || inb(d->io + IDE_LBA_HIGH_REG) != 0) return -2; // Not ATA
+    if (ide_poll_data_request(d) != 0) return -3;
+    insw(d->io + IDE_DATA_REG, id, 256);
+    d->sectors = id[60] | ((uint32_t)id[61] << 16);
+    return 0;
+}
 
-        // --- Transfer Data ---
-        poll_result = ide_poll_data_request(); // Wait for drive to be ready to send data (DRQ)
-        if (poll_result != 0) {
-            term_writestring("IDE Read: Error polling for DRQ.\n");
-            return poll_result;
-        }
+static int ide_geometry(blkdev_t *dev, blkdev_geometry_t *out) {
+    ide_drive_t *d = (ide_drive_t*)dev->driver_data;
+    out->sector_size = BLK_SECTOR_SIZE;
+    out->sector_count = d->sectors;
+    return 0;
+}
 
-        // Read 512 bytes (256 words) from the data port
-        insw(IDE_DATA_REG, current_buf_ptr, 256);
+static const blkdev_ops_t ide_ops = { blkdev_queue_read, blkdev_queue_write, blkdev_queue_flush, ide_geometry };
 
-        // Move to next buffer position
-        current_buf_ptr += 512;
-    }
-    return 0; // Success
+// Queue issue hook: PIO is synchronous, so complete before returning.
+// Runs on the drive queue's dispatch thread, not the submitter's; the
+// channel lock makes the other drive's thread wait its turn.
+static void ide_issue(blk_queue_t *q, blk_request_t *rq) {
+    ide_drive_t *d = (ide_drive_t*)q->driver_data;
+    mutex_lock(d->channel);
+    int status = ide_pio_transfer(d, rq);
+    mutex_unlock(d->channel);
+    blk_queue_complete(q, rq, status);
 }
 
-// Writes 'count' sectors using PIO mode.
-int write_sectors(uint32_t lba, uint16_t count, const void* buffer) {
-     if (count == 0) return 0;
 
-    const uint8_t* current_buf_ptr = (const uint8_t*)buffer;
+// --- Public Driver Functions ---
 
-    for (uint16_t i = 0; i < count; ++i) {
-        uint32_t current_lba = lba + i;
-        int poll_result;
+// Initialize the IDE driver and a request queue per drive found.
+int ide_initialize() {
+    static const uint16_t io[2] = { IDE_PRIMARY_IO, IDE_SECONDARY_IO };
+    static const uint16_t ctrl[2] = { IDE_PRIMARY_CTRL, IDE_SECONDARY_CTRL };
+    int found = 0;
 
-        // --- Send WRITE command ---
-        poll_result = ide_poll_busy_clear(); // Wait until not busy
-        if (poll_result < 0) return -1;
+    // Interrupts stay disabled (nIEN) on both channels: transfers are polled.
+    for (int c = 0; c < 2; ++c) {
+        mutex_init(&ide_channel_lock[c]);
+        outb(ctrl[c] + IDE_DEV_CTRL_REG, 0x02);
+    }
 
-        // Setup LBA28 parameters (same as read)
-        outb(IDE_DRIVE_HEAD_REG, IDE_LBA_MODE_BASE | ((current_lba >> 24) & 0x0F));
-        outb(IDE_SECTOR_COUNT_REG, 1);
-        outb(IDE_LBA_LOW_REG, (uint8_t)(current_lba & 0xFF));
-        outb(IDE_LBA_MID_REG, (uint8_t)((current_lba >> 8) & 0xFF));
-        outb(IDE_LBA_HIGH_REG, (uint8_t)((current_lba >> 16) & 0xFF));
+    for (int i = 0; i < IDE_MAX_DRIVES; ++i) {
+        ide_drive_t *d = &ide_drives[i];
+        memset(d, 0, sizeof(*d));
+        d->io = io[i / 2];
+        d->ctrl = ctrl[i / 2];
+        d->select = (i & 1) ? IDE_DRIVE_SLAVE : 0;
+        d->channel = &ide_channel_lock[i / 2];
+        if (ide_identify(d) != 0 || d->sectors == 0) continue;
 
-        // Issue write command
-        outb(IDE_COMMAND_REG, IDE_CMD_WRITE_PIO);
+        strncpy(d->dev.name, "hd0", BLKDEV_NAME_LEN - 1);
+        d->dev.name[2] = (char)('0' + i);
+        if (blk_queue_init(&d->queue, d->dev.name, ide_issue, d, IDE_MAX_SECTORS, 1) != 0) continue;
+        d->dev.ops = &ide_ops;
+        d->dev.driver_data = d;
+        d->dev.queue = &d->queue;
+        if (blkdev_register(&d->dev) != 0) continue;
+        d->present = 1;
+        found++;
 
-        // --- Transfer Data ---
-        poll_result = ide_poll_data_request(); // Wait for drive ready to RECEIVE data (DRQ)
-        if (poll_result != 0) {
-             term_writestring("IDE Write: Error polling for DRQ.\n");
-            return poll_result;
-        }
+        term_writestring("IDE: ");
+        term_writestring(d->dev.name);
+        term_writestring(i / 2 ? " (secondary " : " (primary ");
+        term_writestring(d->select ? "slave), " : "master), ");
+        term_print_dec(d->sectors / 2048);
+        term_writestring(" MiB\n");
+    }
 
-        // Write 512 bytes (256 words) to the data port
-        outsw(IDE_DATA_REG, current_buf_ptr, 256);
+    if (!found) {
+        term_writestring("IDE: no ATA disks found\n");
+        return -1;
+    }
+    term_writestring("IDE: Basic PIO driver initialized (polling, one queue per drive).\n");
+    return 0;
+}
 
-        // --- Flush Cache ---
-        // Crucial step after writing!
-        outb(IDE_COMMAND_REG, IDE_CMD_FLUSH_CACHE);
-        // Wait for the flush to complete (poll until BSY clear)
-        poll_result = ide_poll_busy_clear();
-        if (poll_result < 0) {
-             term_writestring("IDE Write: Timeout polling after FLUSH CACHE.\n");
-             return -1;
-        }
-        // Check for errors after flush
-        if (poll_result & (IDE_STATUS_ERR | IDE_STATUS_DF)) {
-             term_writestring("Error: IDE ERR/DF set after FLUSH CACHE.\n");
-             return -6;
-        }
+blk_queue_t *ide_get_queue(int index) {
+    if (index < 0 || index >= IDE_MAX_DRIVES || !ide_drives[index].present) return NULL;
+    return &ide_drives[index].queue;
+}
 
-        // Move to next buffer position
-        current_buf_ptr += 512;
-     }
-     return 0; // Success
-}
\ No newline at end of file
+blkdev_t *ide_get_device(int index) {
+    if (index < 0 || index >= IDE_MAX_DRIVES || !ide_drives[index].present) return NULL;
+    return &ide_drives[index].dev;
+}
@@ -6,25 +6,35 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include "blkq.h"
+#include "blkdev.h"
 
 // --- Constants ---
 
-// Primary IDE Bus I/O Ports (Standard PC Addresses)
-#define IDE_DATA_REG        0x1F0 // Read/Write Data Register (16-bit)
-#define IDE_ERROR_REG       0x1F1 // Read Error Register
-#define IDE_FEATURES_REG    0x1F1 // Write Features Register
-#define IDE_SECTOR_COUNT_REG 0x1F2 // Read/Write Sector Count (Number of sectors to transfer)
-#define IDE_LBA_LOW_REG     0x1F3 // Read/Write LBA bits 0-7
-#define IDE_LBA_MID_REG     0x1F4 // Read/Write LBA bits 8-15
-#define IDE_LBA_HIGH_REG    0x1F5 // Read/Write LBA bits 16-23
-#define IDE_DRIVE_HEAD_REG  0x1F6 // Read/Write Drive Select & LBA bits 24-27
-#define IDE_STATUS_REG      0x1F7 // Read Status Register
-#define IDE_COMMAND_REG     0x1F7 // Write Command Register
+// Channel Base Ports (Standard PC Addresses). The two channels are
+// independent buses; each holds a master and a slave drive.
+#define IDE_PRIMARY_IO      0x1F0
+#define IDE_PRIMARY_CTRL    0x3F6
+#define IDE_SECONDARY_IO    0x170
+#define IDE_SECONDARY_CTRL  0x376
 
-#define IDE_ALT_STATUS_REG  0x3F6 // Read Alternate Status Register (doesn't clear interrupt)
-#define IDE_DEV_CTRL_REG    0x3F6 // Write Device Control Register (reset, disable IRQ)
+// Command Block Registers (offsets from the channel's I/O base)
+#define IDE_DATA_REG        0 // Read/Write Data Register (16-bit)
+#define IDE_ERROR_REG       1 // Read Error Register
+#define IDE_FEATURES_REG    1 // Write Features Register
+#define IDE_SECTOR_COUNT_REG 2 // Read/Write Sector Count (Number of sectors to transfer)
+#define IDE_LBA_LOW_REG     3 // Read/Write LBA bits 0-7
+#define IDE_LBA_MID_REG     4 // Read/Write LBA bits 8-15
+#define IDE_LBA_HIGH_REG    5 // Read/Write LBA bits 16-23
+#define IDE_DRIVE_HEAD_REG  6 // Read/Write Drive Select & LBA bits 24-27
+#define IDE_STATUS_REG      7 // Read Status Register
+#define IDE_COMMAND_REG     7 // Write Command Register
 
-// Status Register Bits (Read from 0x1F7 or 0x3F6)
+// Control Block Register (offset from the channel's control base)
+#define IDE_ALT_STATUS_REG  0 // Read Alternate Status Register (doesn't clear interrupt)
+#define IDE_DEV_CTRL_REG    0 // Write Device Control Register (reset, disable IRQ)
+
+// Status Register Bits (Read from STATUS or ALT_STATUS)
 #define IDE_STATUS_ERR      (1 << 0) // Error occurred (check Error Register)
 #define IDE_STATUS_IDX      (1 << 1) // Index mark (unused)
 #define IDE_STATUS_CORR     (1 << 2) // Corrected data (unused)
@@ -34,37 +44,39 @@
 #define IDE_STATUS_RDY      (1 << 6) // Drive Ready (Spinup complete, ready for commands)
 #define IDE_STATUS_BSY      (1 << 7) // Busy (Controller is processing command)
 
-// Command Register Codes (Write to 0x1F7)
+// Command Register Codes (Write to COMMAND)
 #define IDE_CMD_READ_PIO    0x20 // Read Sectors with Retry (PIO)
 #define IDE_CMD_WRITE_PIO   0x30 // Write Sectors with Retry (PIO)
 #define IDE_CMD_FLUSH_CACHE 0xE7 // Write Cache Flush (essential after writes)
 #define IDE_CMD_IDENTIFY    0xEC // Identify Drive (get drive parameters)
 
-// Drive/Head Register Bits (Write to 0x1F6)
+// Drive/Head Register Bits (Write to DRIVE_HEAD)
 // For LBA28 mode:
 // Bit 7: Must be 1
 // Bit 6: LBA mode select (1=LBA, 0=CHS) -> Must be 1
 // Bit 5: Must be 1
 // Bit 4: Drive select (0=Master, 1=Slave)
 // Bits 3-0: LBA bits 24-27
-#define IDE_LBA_MODE_BASE   0xE0 // Sets bits 7, 6, 5 for LBA mode (master assumed initially)
+#define IDE_LBA_MODE_BASE   0xE0 // Sets bits 7, 6, 5 for LBA mode (master)
+#define IDE_DRIVE_SLAVE     0x10 // Bit 4: select the slave
+
+#define IDE_MAX_SECTORS     256  // LBA28 sector count register (0 means 256)
+#define IDE_MAX_DRIVES      4    // hd0 primary master, hd1 primary slave, hd2 secondary master, hd3 secondary slave
 
 
 // --- Function Prototypes ---
 
-// Initialize the IDE driver (basic checks/setup). Returns 0 on success.
+// Initialize the IDE driver: identify all four drive positions, start a
+// request queue per drive found and register it as block device hd<n>
+// (n = channel * 2 + slave, QEMU's -drive index). Drives on different
+// channels transfer in parallel; master and slave share their channel.
+// Needs the scheduler (queues have dispatch threads). Returns 0 if at
+// least one drive was found.
 int ide_initialize();
 
-// Reads 'count' sectors starting from LBA 'lba' into 'buffer'.
-// Assumes buffer is large enough (count * 512 bytes).
-// Uses Primary Master drive via PIO polling. Blocking call.
-// Returns 0 on success, negative error code on failure.
-int read_sectors(uint32_t lba, uint16_t count, void* buffer);
-
-// Writes 'count' sectors starting from LBA 'lba' from 'buffer'.
-// Assumes buffer contains valid data (count * 512 bytes).
-// Uses Primary Master drive via PIO polling. Blocking call. Includes cache flush.
-// Returns 0 on success, negative error code on failure.
-int write_sectors(uint32_t lba, uint16_t count, const void* buffer);
+// Request queue / block device of drive 'index' (0..IDE_MAX_DRIVES-1),
+// or NULL if there is no drive there.
+blk_queue_t *ide_get_queue(int index);
+blkdev_t *ide_get_device(int index);
 
-#endif // IDE_H
\ No newline at end of file
+#endif // IDE_H
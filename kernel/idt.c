@@ -0,0 +1,144 @@
+// kernel/idt.c
+// IDT setup, CPU exception reporting and hardware IRQ dispatch. Readably formatted.
+
+#include "idt.h"
+#include "gdt.h"
+#include "pic.h"
+#include "apic.h"
+#include "cpu.h"
+#include "thread.h"
+#include "io.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// --- IDT Structures ---
+typedef struct __attribute__((packed)) {
+    uint16_t offset_low;
+    uint16_t selector;
+    uint8_t  zero;
+    uint8_t  type_attr; // P=1, DPL=0, 32-bit interrupt gate = 0x8E
+    uint16_t offset_high;
+} IdtEntry;
+
+typedef struct __attribute__((packed)) {
+    uint16_t limit;
+    uint32_t base;
+} IdtPointer;
+
+#define IDT_ENTRIES     256
+#define IDT_STUB_COUNT  (LOCAL_VECTOR_BASE + LOCAL_VECTOR_COUNT) // Stubs provided by isr.asm
+#define IDT_GATE_INT32  0x8E
+
+// --- Module State ---
+static IdtEntry idt[IDT_ENTRIES];
+static IdtPointer idt_ptr;
+static irq_handler_t irq_handlers[IRQ_COUNT];
+static irq_handler_t local_handlers[LOCAL_VECTOR_COUNT];
+static exception_handler_t exception_handlers[IRQ_BASE_VECTOR];
+static int apic_mode = 0; // 0: 8259 PIC, 1: I/O APIC + local APIC EOI
+
+extern uint32_t isr_stub_table[IDT_STUB_COUNT]; // Defined in isr.asm
+extern void isr_spurious(void);                 // Defined in isr.asm
+
+static const char *exception_names[32] = {
+    "Divide Error", "Debug", "NMI", "Breakpoint", "Overflow", "BOUND Range", "Invalid Opcode", "Device Not Available",
+    "Double Fault", "Coprocessor Overrun", "Invalid TSS", "Segment Not Present", "Stack Fault", "General Protection", "Page Fault", "Reserved",
+    "x87 FP Error", "Alignment Check", "Machine Check", "SIMD FP Error", "Virtualization", "Control Protection", "Reserved", "Reserved",
+    "Reserved", "Reserved", "Reserved", "Reserved", "Hypervisor Injection", "VMM Communication", "Security", "Reserved"
+};
+
+// --- Helpers ---
+static void idt_set_gate(int vector, uint32_t handler, uint16_t selector, uint8_t type_attr) {
+    idt[vector].offset_low = handler & 0xFFFF;
+    idt[vector].selector = selector;
+    idt[vector].zero = 0;
+    idt[vector].type_attr = type_attr;
+    idt[vector].offset_high = (handler >> 16) & 0xFFFF;
+}
+
+// Unhandled CPU exception: report and halt this CPU.
+static void exception_panic(interrupt_frame_t *frame) {
+    term_setcolor(VGA_COLOR_RED, VGA_COLOR_BLACK);
+    term_writestring("\nEXCEPTION: "); term_writestring(exception_names[frame->int_no & 31]);
+    term_writestring(" (vec "); term_print_dec(frame->int_no);
+    term_writestring(", err "); term_print_hex(frame->err_code);
+    term_writestring(") at EIP "); term_print_hex(frame->eip);
+    term_writestring(" in thread '"); term_writestring(thread_current() ? thread_current()->name : "?");
+    term_writestring("'\nSystem halted.\n");
+    asm volatile("cli");
+    for (;;) asm volatile("hlt");
+}
+
+// --- Public Functions ---
+void idt_init(void) {
+    for (int i = 0; i < IDT_STUB_COUNT; ++i) {
+        idt_set_gate(i, isr_stub_table[i], GDT_KERNEL_CODE, IDT_GATE_INT32);
+    }
+    idt_set_gate(VECTOR_SPURIOUS, (uint32_t)isr_spurious, GDT_KERNEL_CODE, IDT_GATE_INT32);
+    pic_remap(IRQ_BASE_VECTOR, IRQ_BASE_VECTOR + 8);
+
+    idt_ptr.limit = sizeof(idt) - 1;
+    idt_ptr.base = (uint32_t)&idt;
+    idt_load();
+}
+
+void idt_load(void) {
+    asm volatile("lidt %0" : : "m"(idt_ptr));
+}
+
+void irq_register_handler(uint8_t irq, irq_handler_t handler) {
+    if (irq >= IRQ_COUNT) return;
+    uint32_t flags = irq_save();
+    irq_handlers[irq] = handler;
+    if (apic_mode) ioapic_unmask(irq); else pic_unmask(irq);
+    irq_restore(flags);
+}
+
+void local_vector_register_handler(uint8_t vector, irq_handler_t handler) {
+    if (vector < LOCAL_VECTOR_BASE || vector >= LOCAL_VECTOR_BASE + LOCAL_VECTOR_COUNT) return;
+    local_handlers[vector - LOCAL_VECTOR_BASE] = handler;
+}
+
+void exception_register_handler(uint8_t vector, exception_handler_t handler) {
+    if (vector >= IRQ_BASE_VECTOR) return;
+    exception_handlers[vector] = handler;
+}
+
+void irq_switch_to_apic(void) {
+    uint32_t flags = irq_save();
+    for (uint8_t irq = 0; irq < IRQ_COUNT; ++irq) {
+        pic_mask(irq);
+        if (irq_handlers[irq]) ioapic_unmask(irq);
+    }
+    pic_mask(IRQ_CASCADE);
+    apic_mode = 1;
+    irq_restore(flags);
+}
+
+int irq_in_handler(void) { return this_cpu()->irq_nesting > 0; }
+
+void interrupt_dispatch(interrupt_frame_t *frame) {
+    if (frame->int_no < IRQ_BASE_VECTOR) {
+        exception_handler_t h = exception_handlers[frame->int_no];
+        if (!h || h(frame) != 0) exception_panic(frame);
+        return;
+    }
+
+    cpu_t *cpu = this_cpu();
+    cpu->irq_nesting++;
+    if (frame->int_no >= LOCAL_VECTOR_BASE) {
+        irq_handler_t h = local_handlers[frame->int_no - LOCAL_VECTOR_BASE];
+        if (h) h(frame);
+        cpu->irq_nesting--;
+        lapic_eoi();
+    } else {
+        uint8_t irq = (uint8_t)(frame->int_no - IRQ_BASE_VECTOR);
+        if (irq_handlers[irq]) irq_handlers[irq](frame);
+        cpu->irq_nesting--;
+        if (apic_mode) lapic_eoi(); else pic_send_eoi(irq);
+    }
+
+    // Preempt on the way out, after EOI so the next tick can still arrive.
+    // The interrupted context stays on its own stack and resumes via iret later.
+    thread_preempt_check();
+}
@@ -0,0 +1,69 @@
+// kernel/idt.h
+// Interrupt Descriptor Table, CPU exceptions and hardware IRQ dispatch. Readably formatted.
+
+#ifndef IDT_H
+#define IDT_H
+
+#include <stdint.h>
+
+// Vector layout: 0-31 CPU exceptions, 32-47 ISA IRQs 0-15 (PIC or I/O APIC),
+// 48-51 local APIC vectors (timer, IPIs, MSI), 255 APIC spurious.
+#define IRQ_BASE_VECTOR 32
+#define IRQ_COUNT       16
+#define VECTOR_LAPIC_TIMER 48
+#define VECTOR_RESCHED_IPI 49
+#define VECTOR_MSI_BASE    50 // MSI-capable PCI devices, delivered straight to a local APIC
+#define VECTOR_MSI_COUNT   2
+#define LOCAL_VECTOR_BASE  VECTOR_LAPIC_TIMER
+#define LOCAL_VECTOR_COUNT 4
+#define VECTOR_SPURIOUS    0xFF
+
+#define IRQ_TIMER    0
+#define IRQ_KEYBOARD 1
+#define IRQ_CASCADE  2
+#define IRQ_ATA_PRIMARY   14
+#define IRQ_ATA_SECONDARY 15
+
+// Register state pushed by isr.asm (isr_common_stub) before calling C.
+// Order matters: it mirrors the pushes in reverse.
+typedef struct {
+    uint32_t gs, fs, es, ds;                          // Pushed last by the stub
+    uint32_t edi, esi, ebp, esp_dummy, ebx, edx, ecx, eax; // pusha
+    uint32_t int_no, err_code;                        // Pushed by the per-vector stub
+    uint32_t eip, cs, eflags;                         // Pushed by the CPU
+} interrupt_frame_t;
+
+typedef void (*irq_handler_t)(interrupt_frame_t *frame);
+
+// Handles a CPU exception. Returns 0 if the faulting instruction can be
+// resumed (the frame may be edited to resume elsewhere), non-zero to panic.
+typedef int (*exception_handler_t)(interrupt_frame_t *frame);
+
+// Builds the IDT, remaps the PIC and loads IDTR. Interrupts stay disabled.
+void idt_init(void);
+
+// Loads the shared IDT on an application processor.
+void idt_load(void);
+
+// Installs 'handler' for hardware IRQ line 'irq' (0-15) and unmasks the line.
+void irq_register_handler(uint8_t irq, irq_handler_t handler);
+
+// Installs 'handler' for a local APIC vector (LOCAL_VECTOR_BASE..).
+void local_vector_register_handler(uint8_t vector, irq_handler_t handler);
+
+// Installs 'handler' for CPU exception 'vector' (0-31). Exceptions without
+// a handler, or whose handler fails, halt the CPU with a report.
+void exception_register_handler(uint8_t vector, exception_handler_t handler);
+
+// Moves ISA IRQ delivery from the 8259 PIC to the I/O APIC (already
+// programmed by ioapic_init): registered lines are unmasked there, the PIC is
+// masked, and EOIs go to the local APIC from now on.
+void irq_switch_to_apic(void);
+
+// Returns non-zero while the calling CPU is inside a hardware IRQ handler.
+int irq_in_handler(void);
+
+// Called from isr.asm for every vector.
+void interrupt_dispatch(interrupt_frame_t *frame);
+
+#endif // IDT_H
@@ -3,11 +3,14 @@
 
 #include "io.h"
 #include "string.h" // For strlen AND NOW itoa/uitoa
+#include "spinlock.h"
 #include <stddef.h>
 #include <stdint.h>
 
 // --- VGA Globals ---
 size_t term_row; size_t term_column; uint8_t term_color; uint16_t* term_buffer;
+static spinlock_t term_lock = SPINLOCK_INIT; // One CPU updates the cursor/screen at a time
+static uint32_t term_bytes = 0; // Under term_lock
 
 // --- VGA Helpers ---
 static inline uint16_t vga_entry(unsigned char uc, uint8_t color){return (uint16_t)uc|(uint16_t)color<<8;}
@@ -20,9 +23,11 @@ void term_clear(void){for(size_t y=0;y<VGA_HEIGHT;y++)for(size_t x=0;x<VGA_WIDTH
 void term_setcolor(uint8_t fg, uint8_t bg){term_color=vga_entry_color((enum vga_color)fg,(enum vga_color)bg);}
 void term_putentryat(char c, uint8_t color, size_t x, size_t y){if(y>=VGA_HEIGHT||x>=VGA_WIDTH)return;term_buffer[y*VGA_WIDTH+x]=vga_entry(c,color);}
 void term_scroll(void){for(size_t y=0;y<VGA_HEIGHT-1;y++)for(size_t x=0;x<VGA_WIDTH;x++)term_buffer[y*VGA_WIDTH+x]=term_buffer[(y+1)*VGA_WIDTH+x];const size_t last= (VGA_HEIGHT-1)*VGA_WIDTH;for(size_t x=0;x<VGA_WIDTH;x++)term_buffer[last+x]=vga_entry(' ',term_color);term_row=VGA_HEIGHT-1;}
-void term_putchar(char c){unsigned char uc=(unsigned char)c;switch(uc){case '\n':term_column=0;term_row++;break;case '\r':term_column=0;break;case '\b':if(term_column>0){term_column--;term_putentryat(' ',term_color,term_column,term_row);}else if(term_row>0){term_row--;term_column=VGA_WIDTH-1;term_putentryat(' ',term_color,term_column,term_row);}break;default:term_putentryat(uc,term_color,term_column,term_row);term_column++;break;}if(term_column>=VGA_WIDTH){term_column=0;term_row++;}if(term_row>=VGA_HEIGHT){term_scroll();}update_cursor(term_row,term_column);}
-void term_write(const char*d, size_t s){for(size_t i=0;i<s;i++)term_putchar(d[i]);}
+static void term_putchar_unlocked(char c){unsigned char uc=(unsigned char)c;term_bytes++;switch(uc){case '\n':term_column=0;term_row++;break;case '\r':term_column=0;break;case '\b':if(term_column>0){term_column--;term_putentryat(' ',term_color,term_column,term_row);}else if(term_row>0){term_row--;term_column=VGA_WIDTH-1;term_putentryat(' ',term_color,term_column,term_row);}break;default:term_putentryat(uc,term_color,term_column,term_row);term_column++;break;}if(term_column>=VGA_WIDTH){term_column=0;term_row++;}if(term_row>=VGA_HEIGHT){term_scroll();}update_cursor(term_row,term_column);}
+void term_putchar(char c){uint32_t f=spin_lock_irqsave(&term_lock);term_putchar_unlocked(c);spin_unlock_irqrestore(&term_lock,f);}
+void term_write(const char*d, size_t s){uint32_t f=spin_lock_irqsave(&term_lock);for(size_t i=0;i<s;i++)term_putchar_unlocked(d[i]);spin_unlock_irqrestore(&term_lock,f);}
 void term_writestring(const char*d){term_write(d,strlen(d));}
+uint32_t term_bytes_written(void){return term_bytes;}
 
 // --- NEW: Number Printing Function Implementations ---
 void term_print_dec(int value) {
@@ -16,6 +16,16 @@ static inline void outl(uint16_t port, uint32_t val) { asm volatile ("outl %0, %
 static inline uint32_t inl(uint16_t port) { uint32_t ret; asm volatile ("inl %1, %0" : "=a"(ret) : "Nd"(port)); return ret; }
 static inline void outsw(uint16_t port, const void *addr, uint32_t count) { asm volatile ("rep outsw" : "+S"(addr), "+c"(count) : "d"(port)); }
 static inline void insw(uint16_t port, void *addr, uint32_t count) { asm volatile ("rep insw" : "+D"(addr), "+c"(count) : "d"(port) : "memory"); }
+static inline void io_wait(void) { outb(0x80, 0); } // Short delay for slow devices (PIC, PIT)
+static inline uint64_t rdtsc(void) { uint32_t lo, hi; asm volatile ("rdtsc" : "=a"(lo), "=d"(hi)); return ((uint64_t)hi << 32) | lo; } // CPU cycles
+
+// --- Interrupt Flag Helpers ---
+// irq_save() disables interrupts and returns the previous EFLAGS; irq_restore()
+// puts IF back the way it was. Use them around short critical sections.
+static inline uint32_t irq_save(void) { uint32_t flags; asm volatile ("pushfl; popl %0; cli" : "=r"(flags) : : "memory"); return flags; }
+static inline void irq_restore(uint32_t flags) { if (flags & 0x200) asm volatile ("sti" : : : "memory"); }
+static inline void irq_enable(void) { asm volatile ("sti" : : : "memory"); }
+static inline void irq_disable(void) { asm volatile ("cli" : : : "memory"); }
 
 // --- VGA Text Mode Definitions --- (from user ioh.txt)
 #define VGA_WIDTH 80
@@ -39,6 +49,7 @@ void term_writestring(const char* data);
 void term_clear(void);
 void term_scroll(void);
 void update_cursor(int row, int col);
+uint32_t term_bytes_written(void); // Characters output since boot (wraps)
 
 // --- NEW: Number Printing Function Prototypes ---
 void term_print_dec(int value);
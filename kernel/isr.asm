@@ -0,0 +1,145 @@
+; kernel/isr.asm
+; NASM syntax
+; Interrupt entry stubs. Every vector pushes (err_code, int_no) and jumps to
+; isr_common_stub, which saves the rest of interrupt_frame_t (see idt.h) and
+; calls interrupt_dispatch() in idt.c.
+
+bits 32
+
+section .text
+extern interrupt_dispatch
+
+; Exception without CPU-pushed error code: push a dummy 0 to keep the frame uniform.
+%macro ISR_NOERR 1
+isr%1:
+    push dword 0
+    push dword %1
+    jmp isr_common_stub
+%endmacro
+
+; Exception with CPU-pushed error code.
+%macro ISR_ERR 1
+isr%1:
+    push dword %1
+    jmp isr_common_stub
+%endmacro
+
+; Hardware IRQ, remapped to vector 32 + n.
+%macro IRQ 1
+irq%1:
+    push dword 0
+    push dword 32 + %1
+    jmp isr_common_stub
+%endmacro
+
+; Local APIC vector (timer, IPIs), vector given directly.
+%macro LOCAL_VECTOR 1
+vec%1:
+    push dword 0
+    push dword %1
+    jmp isr_common_stub
+%endmacro
+
+ISR_NOERR 0
+ISR_NOERR 1
+ISR_NOERR 2
+ISR_NOERR 3
+ISR_NOERR 4
+ISR_NOERR 5
+ISR_NOERR 6
+ISR_NOERR 7
+ISR_ERR   8
+ISR_NOERR 9
+ISR_ERR   10
+ISR_ERR   11
+ISR_ERR   12
+ISR_ERR   13
+ISR_ERR   14
+ISR_NOERR 15
+ISR_NOERR 16
+ISR_ERR   17
+ISR_NOERR 18
+ISR_NOERR 19
+ISR_NOERR 20
+ISR_ERR   21
+ISR_NOERR 22
+ISR_NOERR 23
+ISR_NOERR 24
+ISR_NOERR 25
+ISR_NOERR 26
+ISR_NOERR 27
+ISR_NOERR 28
+ISR_ERR   29
+ISR_ERR   30
+ISR_NOERR 31
+
+IRQ 0
+IRQ 1
+IRQ 2
+IRQ 3
+IRQ 4
+IRQ 5
+IRQ 6
+IRQ 7
+IRQ 8
+IRQ 9
+IRQ 10
+IRQ 11
+IRQ 12
+IRQ 13
+IRQ 14
+IRQ 15
+
+LOCAL_VECTOR 48 ; VECTOR_LAPIC_TIMER
+LOCAL_VECTOR 49 ; VECTOR_RESCHED_IPI
+LOCAL_VECTOR 50 ; VECTOR_MSI_BASE (PCI message-signalled interrupts)
+LOCAL_VECTOR 51
+
+; Local APIC spurious interrupt: no EOI, no state to save.
+global isr_spurious
+isr_spurious:
+    iret
+
+isr_common_stub:
+    pusha                   ; edi, esi, ebp, esp, ebx, edx, ecx, eax
+    push ds
+    push es
+    push fs
+    push gs
+
+    mov ax, 0x10            ; Kernel data selector (GDT_KERNEL_DATA)
+    mov ds, ax
+    mov es, ax
+    mov fs, ax              ; GS is left alone: it is the per-CPU segment (cpu.h)
+
+    cld                     ; C code expects DF=0
+    push esp                ; interrupt_frame_t *frame
+    call interrupt_dispatch
+    add esp, 4
+
+    pop gs
+    pop fs
+    pop es
+    pop ds
+    popa
+    add esp, 8              ; Drop int_no and err_code
+    iret
+
+; Table of stub addresses, indexed by vector, consumed by idt_init().
+section .data
+global isr_stub_table
+isr_stub_table:
+%assign i 0
+%rep 32
+    dd isr%+i
+%assign i i+1
+%endrep
+%assign i 0
+%rep 16
+    dd irq%+i
+%assign i i+1
+%endrep
+    dd vec48
+    dd vec49
+    dd vec50
+    dd vec51
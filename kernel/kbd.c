@@ -1,8 +1,10 @@
 // kernel/kbd.c
-// Complete File - Basic PS/2 Keyboard Driver (Polling)
+// Complete File - Basic PS/2 Keyboard Driver (IRQ1-driven, blocking reads)
 
 #include "kbd.h"     // Our keyboard header
 #include "io.h"      // Include io.h for inb() function !!
+#include "idt.h"     // irq_register_handler()
+#include "thread.h"  // wait queues for blocking reads
 #include <stdint.h>  // For uint8_t etc.
 #include <stddef.h>  // For NULL (potentially used later)
 
@@ -37,74 +39,71 @@ const char scancode_map[128] = {
       0, /*KP 1*/ 0, /*KP 2*/ 0, /*KP 3*/ 0, /*KP 0*/ '.', /*KP .*/           // 0x4F - 0x53
       0, 0, 0, 0, /* F11, F12 */ 0, 0,                                       // 0x54 - 0x58
     // --- বাকি সব 0 ---
-    // Release codes (scancode | 0x80) are ignored by kbd_getchar currently.
+    // Release codes (scancode | 0x80) are ignored by kbd_translate.
 };
 
 
-// --- Public Keyboard Functions ---
-
-// Initializes keyboard (currently does nothing for basic polling).
-// Could be used later for setting scan code sets or enabling interrupts.
-void kbd_init(void) {
-    // Future: Can add code here to reset keyboard controller, set LEDs, etc.
-}
+// --- Input Ring Buffer (filled by IRQ1) ---
+#define KBD_BUFFER_SIZE 64
+static volatile char kbd_buffer[KBD_BUFFER_SIZE];
+static volatile uint32_t kbd_head = 0; // Next slot to write (IRQ handler)
+static volatile uint32_t kbd_tail = 0; // Next slot to read (kbd_getchar)
+static wait_queue_t kbd_waiters = WAIT_QUEUE_INIT;
 
-// Checks if data is available from the keyboard.
+// Checks if data is available from the keyboard controller.
 // Returns non-zero if data ready, 0 otherwise.
-int kbd_is_data_ready(void) {
+static int kbd_is_data_ready(void) {
     // Read status port and check the Output Buffer Full bit
     return inb(KBD_STATUS_PORT) & KBD_STATUS_OBF;
 }
 
-// Reads a raw scancode from the keyboard data port.
-// NOTE: This function assumes data is ready; call kbd_is_data_ready() first,
-// or use kbd_getchar() which handles polling.
-uint8_t kbd_read_scancode(void) {
-    // Read byte from data port
-    return inb(KBD_DATA_PORT);
+// Translates a raw Set 1 scancode to ASCII.
+// Returns 0 for key releases (bit 7 set), modifiers and unmapped keys.
+static char kbd_translate(uint8_t scancode) {
+    if (scancode & 0x80) return 0;                 // Key release event
+    if (scancode >= sizeof(scancode_map)) return 0; // Outside our map's range
+    return scancode_map[scancode];
 }
 
-// Blocking function to get the next ASCII character from the keyboard.
-// - Waits (polls) until a key is pressed.
-// - Reads the scancode.
-// - Ignores key release events (scancodes >= 0x80).
-// - Translates known press scancodes using `scancode_map`.
-// - Ignores modifier keys (Shift, Ctrl, Alt) and unmapped keys.
-// - Returns the ASCII character (or special chars like '\n', '\b', '\t').
-char kbd_getchar(void) {
-    uint8_t scancode;
-    char ascii_char;
-
-    while (1) {
-        // --- Poll Status Port ---
-        // Wait until the Output Buffer Full bit (OBF) is set in the status register.
-        while (!kbd_is_data_ready()) {
-            // Yield CPU slightly while polling (optional but good practice)
-            asm volatile("pause" ::: "memory");
-        }
+// IRQ1: read the scancode, queue the character and wake any reader.
+// Characters are dropped when the buffer is full.
+static void kbd_irq(interrupt_frame_t *frame) {
+    (void)frame;
+    uint8_t scancode = inb(KBD_DATA_PORT);
+    char c = kbd_translate(scancode);
+    if (c == 0) return;
+    uint32_t flags = wait_queue_lock(&kbd_waiters); // Also guards the ring buffer
+    uint32_t next = (kbd_head + 1) % KBD_BUFFER_SIZE;
+    if (next != kbd_tail) {
+        kbd_buffer[kbd_head] = c;
+        kbd_head = next;
+        wait_queue_wake_one_locked(&kbd_waiters);
+    }
+    wait_queue_unlock(&kbd_waiters, flags);
+}
 
-        // --- Read Scancode ---
-        // Data is ready, read the scancode byte from the data port.
-        scancode = kbd_read_scancode(); // Uses inb() via io.h
 
-        // --- Process Scancode ---
-        // Check if it's a key press event (release codes have the highest bit set)
-        if (!(scancode & 0x80)) { // If highest bit (0x80) is NOT set... it's a press event
-            // Translate scancode to ASCII using the map, if valid index
-            if (scancode < sizeof(scancode_map)) {
-                ascii_char = scancode_map[scancode];
+// --- Public Keyboard Functions ---
 
-                // Check if the scancode mapped to a valid character (not 0)
-                if (ascii_char != 0) {
-                    // Valid character found, return it.
-                    return ascii_char;
-                }
-                // else: Scancode mapped to 0 (e.g., Shift key, F-key), ignore and continue loop.
-            }
-            // else: Scancode is outside our map's range, ignore and continue loop.
-        }
-        // else: Scancode had highest bit set (>= 0x80), meaning it's a key release event.
-        // Ignore release events in this simple driver and continue loop.
+// Initializes the keyboard: drains stale bytes left by the BIOS and
+// switches to interrupt-driven input on IRQ1.
+void kbd_init(void) {
+    while (kbd_is_data_ready()) { (void)inb(KBD_DATA_PORT); }
+    irq_register_handler(IRQ_KEYBOARD, kbd_irq);
+}
 
-    } // End while(1) loop - continues until a valid character is returned
-}
\ No newline at end of file
+// Blocking function to get the next ASCII character from the keyboard.
+// - Sleeps the calling thread until IRQ1 queues a character (no polling).
+// - Key releases, modifier keys (Shift, Ctrl, Alt) and unmapped keys are
+//   filtered out by the IRQ handler, so anything queued is returned as-is
+//   (including special chars like '\n', '\b', '\t').
+char kbd_getchar(void) {
+    uint32_t flags = wait_queue_lock(&kbd_waiters);
+    while (kbd_tail == kbd_head) {
+        wait_queue_sleep(&kbd_waiters);
+    }
+    char c = kbd_buffer[kbd_tail];
+    kbd_tail = (kbd_tail + 1) % KBD_BUFFER_SIZE;
+    wait_queue_unlock(&kbd_waiters, flags);
+    return c;
+}
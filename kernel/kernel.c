@@ -4,8 +4,23 @@
 #include "io.h"
 #include "kbd.h"
 #include "ide.h"
+#include "ahci.h"
+#include "blkdev.h"
+#include "ramdisk.h"
+#include "stripe.h"
 #include "fat32.h"
+#include "paging.h"
+#include "elf.h"
+#include "pagecache.h"
+#include "mmap.h"
+#include "fsck.h"
 #include "string.h"
+#include "gdt.h"
+#include "idt.h"
+#include "timer.h"
+#include "thread.h"
+#include "cpu.h"
+#include "smp.h"
 #include <stddef.h>
 #include <stdint.h>
 
@@ -16,66 +31,483 @@
 // --- Decls ---
 void cmd_version(char *args); void cmd_echo(char *args); void cmd_help(char *args);
 void cmd_ls(char *args); void cmd_cd(char *args); void cmd_mkdir(char *args);
-void cmd_touch(char *args);
+void cmd_touch(char *args); void cmd_ps(char *args); void cmd_sleep(char *args); void cmd_iostat(char *args);
+void cmd_cpus(char *args); void cmd_smpbench(char *args); void cmd_iobench(char *args);
+void cmd_devs(char *args); void cmd_mount(char *args); void cmd_ramdisk(char *args);
+void cmd_mkstripe(char *args); void cmd_seqbench(char *args);
+void cmd_write(char *args); void cmd_cat(char *args); void cmd_truncate(char *args); void cmd_fill(char *args);
+void cmd_exec(char *args); void cmd_pcache(char *args); void cmd_mmscan(char *args);
+void cmd_frag(char *args); void cmd_defrag(char *args); void cmd_fsck(char *args);
+void cmd_run(char *args); void cmd_time(char *args); void process_command(char *line);
 typedef struct { const char *name; void (*func)(char *args); } command_t;
-command_t commands[] = { { "version", cmd_version }, { "echo", cmd_echo }, { "help", cmd_help }, { "ls", cmd_ls }, { "cd", cmd_cd }, { "mkdir", cmd_mkdir }, { "touch", cmd_touch }, { NULL, NULL } };
+command_t commands[] = { { "version", cmd_version }, { "echo", cmd_echo }, { "help", cmd_help }, { "ls", cmd_ls }, { "cd", cmd_cd }, { "mkdir", cmd_mkdir }, { "touch", cmd_touch }, { "ps", cmd_ps }, { "sleep", cmd_sleep }, { "iostat", cmd_iostat }, { "cpus", cmd_cpus }, { "smpbench", cmd_smpbench }, { "iobench", cmd_iobench }, { "devs", cmd_devs }, { "mount", cmd_mount }, { "ramdisk", cmd_ramdisk }, { "mkstripe", cmd_mkstripe }, { "seqbench", cmd_seqbench }, { "write", cmd_write }, { "cat", cmd_cat }, { "truncate", cmd_truncate }, { "fill", cmd_fill }, { "exec", cmd_exec }, { "pcache", cmd_pcache }, { "mmscan", cmd_mmscan }, { "frag", cmd_frag }, { "defrag", cmd_defrag }, { "fsck", cmd_fsck }, { "run", cmd_run }, { "time", cmd_time }, { NULL, NULL } };
 
 // --- Impls ---
+// Argument helpers: next space-separated word (NUL-terminated in place), decimal number
+static char *next_word(char **p){char *w=*p;if(!w)return NULL;while(*w==' ')w++;if(!*w){*p=NULL;return NULL;}char *e=w;while(*e&&*e!=' ')e++;if(*e){*e='\0';*p=e+1;}else *p=NULL;return w;}
+static uint32_t parse_dec(const char *w,uint32_t def){if(!w||*w<'0'||*w>'9')return def;uint32_t v=0;for(;*w>='0'&&*w<='9';++w)v=v*10+(uint32_t)(*w-'0');return v;}
 void cmd_version(char *a){(void)a;term_writestring("MyOS v");term_writestring(KERNEL_VERSION);term_putchar('\n');}
 void cmd_echo(char *a){if(a)term_writestring(a);term_putchar('\n');}
 void cmd_help(char *a){(void)a;term_writestring("Cmds:\n");for(int i=0;commands[i].name;++i){term_writestring("  ");term_writestring(commands[i].name);term_putchar('\n');}}
 
-// LS Callback (using user_data flag)
-void ls_callback(Fat32DirectoryEntry *entry, const char* fname, void *ud) {
-    if(!fname||!fname[0])return;
-    int *flag=(int*)ud; if(flag)*flag=1; // Set flag passed via user_data
-    term_writestring("  "); term_writestring(fname);
-    if(entry->attributes&ATTR_DIRECTORY)term_writestring("/");
-    // Could add size printing here later using term_print_dec(entry->file_size);
-    term_putchar('\n');
-}
-// ls Command (using flag to print (empty))
+// ls: pages through the directory LS_BATCH entries at a time
+#define LS_BATCH 8
+static Fat32DirEntryInfo ls_entries[LS_BATCH];
 void cmd_ls(char *args) {
-    uint32_t cluster; int found = 0; // Flag to check if callback fired
-    if(args&&strlen(args)>0){term_writestring("ls paths N/I\n");cluster=fat32_get_current_directory_cluster();}
-    else{cluster=fat32_get_current_directory_cluster();}
-    if(cluster<2){term_writestring("ls: Bad CWD:");term_print_dec(cluster);term_writestring("\n");return;} // Use print
-    term_writestring("Contents C");term_print_dec(cluster);term_writestring(":\n"); // Use print
-    // Pass address of 'found' flag as user_data to the callback
-    int r=fat32_read_directory(cluster,ls_callback,&found);
-    if(r<0){term_writestring("ls: Read err ");term_print_dec(r);term_writestring("\n");} // Use print
-    else if(!found){term_writestring("  (empty)\n");} // Print empty if flag wasn't set
+    uint32_t cluster=fat32_get_current_directory_cluster(); Fat32DirCursor cur; int n,total=0;
+    if(args&&strlen(args)>0)term_writestring("ls paths N/I\n");
+    if(fat32_dir_open(cluster,&cur)<0){term_writestring("ls: Bad CWD:");term_print_dec(cluster);term_writestring("\n");return;}
+    term_writestring("Contents C");term_print_dec(cluster);term_writestring(":\n");
+    while((n=fat32_dir_read(&cur,ls_entries,LS_BATCH))>0){
+        for(int i=0;i<n;++i){
+            const Fat32DirEntryInfo *e=&ls_entries[i];
+            term_writestring("  ");term_writestring(e->name);
+            if(e->attributes&ATTR_DIRECTORY)term_writestring("/");
+            else{term_writestring("  ");term_print_dec(e->size);}
+            term_putchar('\n');
+        }
+        total+=n;
+    }
+    if(n<0){term_writestring("ls: Read err ");term_print_dec(n);term_writestring("\n");}
+    else if(!total){term_writestring("  (empty)\n");}
 }
 // Stubs
 void cmd_cd(char*a){(void)a;term_writestring("cd: N/I\n");}
-void cmd_mkdir(char*a){(void)a;term_writestring("mkdir: N/I\n");}
-void cmd_touch(char*a){(void)a;term_writestring("touch: N/I\n");}
+
+// File commands (8.3 names in the current directory)
+static void fs_error(const char *cmd,int r){term_writestring(cmd);term_writestring(": ");
+    term_writestring(r==-1?"not found / bad name":r==-2?"exists / is a directory":r==-4?"no space":r==-5?"file is mapped":"I/O error");term_putchar('\n');}
+void cmd_mkdir(char*a){
+    char *name=next_word(&a); if(!name){term_writestring("usage: mkdir <name>\n");return;}
+    int r=fat32_mkdir(fat32_get_current_directory_cluster(),name); if(r<0)fs_error("mkdir",r);
+}
+void cmd_touch(char*a){
+    char *name=next_word(&a); Fat32File f; if(!name){term_writestring("usage: touch <name>\n");return;}
+    int r=fat32_open(fat32_get_current_directory_cluster(),name,FAT32_OPEN_CREATE,&f);
+    if(r<0){fs_error("touch",r);return;} fat32_close(&f);
+}
+// write <name> <text>: appends the text and a newline, creating the file.
+void cmd_write(char*a){
+    char *name=next_word(&a); Fat32File f; if(!name){term_writestring("usage: write <name> <text>\n");return;}
+    int r=fat32_open(fat32_get_current_directory_cluster(),name,FAT32_OPEN_CREATE,&f); if(r<0){fs_error("write",r);return;}
+    fat32_seek(&f,f.size);
+    if((a&&(r=fat32_write(&f,a,strlen(a)))<0)||(r=fat32_write(&f,"\n",1))<0)fs_error("write",r);
+    if((r=fat32_close(&f))<0)fs_error("write",r);
+}
+void cmd_cat(char*a){
+    char *name=next_word(&a); Fat32File f; char buf[128]; int n;
+    if(!name){term_writestring("usage: cat <name>\n");return;}
+    int r=fat32_open(fat32_get_current_directory_cluster(),name,0,&f); if(r<0){fs_error("cat",r);return;}
+    while((n=fat32_read(&f,buf,sizeof(buf)))>0)term_write(buf,(size_t)n);
+    if(n<0)fs_error("cat",n);
+    fat32_close(&f);
+}
+void cmd_truncate(char*a){
+    char *name=next_word(&a); Fat32File f; uint32_t size=parse_dec(next_word(&a),0xFFFFFFFF);
+    if(!name||size==0xFFFFFFFF){term_writestring("usage: truncate <name> <bytes>\n");return;}
+    int r=fat32_open(fat32_get_current_directory_cluster(),name,0,&f); if(r<0){fs_error("truncate",r);return;}
+    if((r=fat32_truncate(&f,size))==-1)term_writestring("truncate: can only shrink\n"); else if(r<0)fs_error("truncate",r);
+    if((r=fat32_close(&f))<0)fs_error("truncate",r);
+}
+// fill <name> <KiB>: rewrites the file with KiB of data in 1 KiB writes, to
+// watch delayed allocation turn small writes into large sequential ones.
+static uint8_t fill_buf[1024];
+void cmd_fill(char*a){
+    char *name=next_word(&a); uint32_t kib=parse_dec(next_word(&a),0); Fat32File f;
+    if(!name||kib==0){term_writestring("usage: fill <name> <KiB>\n");return;}
+    int r=fat32_open(fat32_get_current_directory_cluster(),name,FAT32_OPEN_CREATE|FAT32_OPEN_TRUNCATE,&f); if(r<0){fs_error("fill",r);return;}
+    blkdev_t *d=fat32_get_volume_info()->device; uint32_t w0=d->stats.writes,start=timer_ticks();
+    for(uint32_t i=0;i<kib&&r>=0;++i){for(int k=0;k<1024;++k)fill_buf[k]=(uint8_t)('a'+(i+k)%26);r=fat32_write(&f,fill_buf,1024);}
+    if(r<0)fs_error("fill",r);
+    if((r=fat32_close(&f))<0)fs_error("fill",r);
+    term_print_dec(kib);term_writestring(" KiB in ");term_print_dec((timer_ticks()-start)*1000/TIMER_HZ);term_writestring(" ms, ");
+    term_print_dec(d->stats.writes-w0);term_writestring(" device writes, ");term_print_dec(f.clusters);term_writestring(" clusters\n");
+}
+
+// exec <file> [args]: runs an ELF32 program; its pages are read on first touch
+void cmd_exec(char*a){
+    char *name=next_word(&a); ElfExecStats st; int status=0;
+    if(!name){term_writestring("usage: exec <file> [args]\n");return;}
+    blkdev_t *d=fat32_get_volume_info()->device; uint32_t r0=d->stats.reads,start=timer_ticks();
+    int r=elf_exec(fat32_get_current_directory_cluster(),name,a,&status,&st);
+    if(r==ELF_ERR_FORMAT)term_writestring("exec: not an i386 executable for the user window\n");
+    else if(r==ELF_ERR_BUSY)term_writestring("exec: another program is running\n");
+    else if(r<0&&r!=ELF_ERR_CRASHED)fs_error("exec",r);
+    if(r!=0&&r!=ELF_ERR_CRASHED)return;
+    if(r==0){term_writestring("exit status ");term_print_dec(status);term_writestring(", ");}
+    term_print_dec(st.faults);term_writestring(" of ");term_print_dec(st.image_pages);term_writestring(" pages loaded (");
+    term_print_dec(st.zero_pages);term_writestring(" zero-filled, ");term_print_dec(st.shared_pages);term_writestring(" shared, ");
+    term_print_dec(st.cache_hits);term_writestring(" cached), ");term_print_dec(d->stats.reads-r0);term_writestring(" device reads, ");
+    term_print_dec((timer_ticks()-start)*1000/TIMER_HZ);term_writestring(" ms\n");
+}
+void cmd_pcache(char*a){
+    (void)a; pagecache_stats_t st; pagecache_get_stats(&st); uint32_t lookups=st.hits+st.misses;
+    term_writestring("page cache: ");term_print_dec(st.resident);term_writestring(" pages (");term_print_dec(st.resident*4);term_writestring(" KiB) resident, ");
+    term_print_dec(st.pinned);term_writestring(" pinned, ");term_print_dec(st.hits);term_writestring(" hits, ");term_print_dec(st.misses);term_writestring(" misses (");
+    term_print_dec(lookups?st.hits*100/lookups:0);term_writestring("% hit), ");term_print_dec(st.evictions);term_writestring(" evictions\n");
+}
+// mmscan <file> [passes]: sums a mapped file; later passes should read nothing
+void cmd_mmscan(char*a){
+    char *name=next_word(&a); uint32_t passes=parse_dec(next_word(&a),2); Fat32File f; const void *view;
+    if(!name||passes==0){term_writestring("usage: mmscan <file> [passes]\n");return;}
+    int r=fat32_open(fat32_get_current_directory_cluster(),name,0,&f); if(r<0){fs_error("mmscan",r);return;}
+    r=fat32_mmap(&f,0,f.size,&view); fat32_close(&f); if(r<0){fs_error("mmscan",r);return;}
+    blkdev_t *d=fat32_get_volume_info()->device;
+    for(uint32_t p=0;p<passes;++p){
+        pagecache_stats_t s0,s1; pagecache_get_stats(&s0); uint32_t r0=d->stats.reads,start=timer_ticks(),sum=0;
+        const volatile uint8_t *b=(const volatile uint8_t*)view; for(uint32_t i=0;i<f.size;++i)sum+=b[i];
+        pagecache_get_stats(&s1);
+        term_writestring("pass ");term_print_dec(p+1);term_writestring(": sum ");term_print_dec(sum);term_writestring(", ");
+        term_print_dec((timer_ticks()-start)*1000/TIMER_HZ);term_writestring(" ms, ");term_print_dec(s1.hits-s0.hits);term_writestring(" hits, ");
+        term_print_dec(s1.misses-s0.misses);term_writestring(" misses, ");term_print_dec(d->stats.reads-r0);term_writestring(" device reads\n");
+    }
+    fat32_munmap(view);
+}
+
+// Volume walk for frag/defrag: 'visit' sees every entry below 'dir', depth
+// first, WALK_BATCH entries per read; levels below WALK_DEPTH are skipped.
+#define WALK_DEPTH 8
+#define WALK_BATCH 4
+static Fat32DirEntryInfo walk_entries[WALK_DEPTH][WALK_BATCH];
+static int walk_tree(uint32_t dir,int depth,void (*visit)(uint32_t dir,const Fat32DirEntryInfo *e,int depth)){
+    Fat32DirCursor cur; int n;
+    if(depth>=WALK_DEPTH||fat32_dir_open(dir,&cur)<0)return -1;
+    while((n=fat32_dir_read(&cur,walk_entries[depth],WALK_BATCH))>0){
+        for(int i=0;i<n;++i){const Fat32DirEntryInfo *e=&walk_entries[depth][i];visit(dir,e,depth);
+            if((e->attributes&ATTR_DIRECTORY)&&e->first_cluster>=2)walk_tree(e->first_cluster,depth+1,visit);}
+    }
+    return n;
+}
+// frag: extents per file and for the whole volume
+static uint32_t frag_files,frag_clusters,frag_extents,frag_fragmented;
+static void frag_visit(uint32_t dir,const Fat32DirEntryInfo *e,int depth){
+    (void)dir; uint32_t clusters,extents=fat32_chain_extents(e->first_cluster,&clusters); if(!clusters)return;
+    for(int i=0;i<=depth;++i)term_writestring("  ");
+    term_writestring(e->name);if(e->attributes&ATTR_DIRECTORY)term_putchar('/');
+    term_writestring(": ");term_print_dec(clusters);term_writestring(" clusters, ");term_print_dec(extents);term_writestring(extents==1?" extent\n":" extents\n");
+    frag_files++;frag_clusters+=clusters;frag_extents+=extents;if(extents>1)frag_fragmented++;
+}
+void cmd_frag(char*a){
+    (void)a; const Fat32VolumeInfo *v=fat32_get_volume_info(); if(!v){term_writestring("frag: no volume\n");return;}
+    frag_files=frag_clusters=frag_extents=frag_fragmented=0;
+    if(walk_tree(v->bpb.root_dir_cluster,0,frag_visit)<0)term_writestring("frag: read error, totals are partial\n");
+    term_writestring("volume: ");term_print_dec(frag_files);term_writestring(" files and directories, ");term_print_dec(frag_clusters);term_writestring(" clusters in ");
+    term_print_dec(frag_extents);term_writestring(" extents (");term_print_dec(frag_files?frag_extents*100/frag_files:0);term_writestring("/100 per file), ");
+    term_print_dec(frag_fragmented);term_writestring(" fragmented\n");
+}
+// defrag [file]: makes the file (default: every fragmented file) contiguous
+static uint32_t defrag_moved,defrag_failed;
+static int script_is_open(uint32_t first_cluster); // A running script's handle would read the old clusters
+static void defrag_one(uint32_t dir,const char *name){
+    Fat32File f; int r=fat32_open(dir,name,0,&f); if(r<0){fs_error("defrag",r);defrag_failed++;return;}
+    uint32_t before,clusters; before=fat32_chain_extents(f.first_cluster,&clusters);
+    if(f.first_cluster&&script_is_open(f.first_cluster))r=-6;
+    else if((r=fat32_defrag(&f))==1)defrag_moved++; else if(r<0&&r!=-5)defrag_failed++;
+    int c=fat32_close(&f); if(r>=0&&c<0)r=c;
+    term_writestring("  ");term_writestring(name);term_writestring(": ");term_print_dec(before);
+    term_writestring(r==1?" extents -> 1\n":r==0?" extent, already contiguous\n":r==-4?" extents, no free run large enough\n":r==-5?" extents, mapped, skipped\n":
+        r==-6?" extents, running script, skipped\n":" extents, I/O error\n");
+}
+static void defrag_visit(uint32_t dir,const Fat32DirEntryInfo *e,int depth){
+    (void)depth; uint32_t clusters; if(e->attributes&ATTR_DIRECTORY)return;
+    if(fat32_chain_extents(e->first_cluster,&clusters)>1)defrag_one(dir,e->short_name);
+}
+void cmd_defrag(char*a){
+    char *name=next_word(&a); const Fat32VolumeInfo *v=fat32_get_volume_info(); if(!v){term_writestring("defrag: no volume\n");return;}
+    uint32_t start=timer_ticks(); defrag_moved=defrag_failed=0;
+    if(name)defrag_one(fat32_get_current_directory_cluster(),name);
+    else if(walk_tree(v->bpb.root_dir_cluster,0,defrag_visit)<0)term_writestring("defrag: read error, stopped early\n");
+    term_print_dec(defrag_moved);term_writestring(" files moved, ");term_print_dec(defrag_failed);term_writestring(" failed, ");
+    term_print_dec((timer_ticks()-start)*1000/TIMER_HZ);term_writestring(" ms\n");
+}
+// fsck [-r]: checks the mounted volume, -r repairs what it finds
+static void fsck_print(const fsck_report_t *f,int r,uint32_t ticks){
+    if(r==-4){term_writestring("fsck: FAT too large or too many directories\n");return;}
+    if(r==-5){term_writestring("fsck: files are mapped; unmap them before repairing\n");return;}
+    if(r<0){fs_error("fsck",r);return;}
+    term_writestring("fsck: ");term_print_dec(f->files);term_writestring(" files, ");term_print_dec(f->directories);term_writestring(" dirs, ");
+    term_print_dec(f->used_clusters);term_writestring(" used, ");term_print_dec(f->free_clusters);term_writestring(" free (FSInfo ");
+    if(f->fsinfo_free==0xFFFFFFFF)term_writestring("unknown");else term_print_dec(f->fsinfo_free);term_writestring("), FAT in ");
+    term_print_dec(f->fat_reads);term_writestring(" reads, ");term_print_dec(ticks*1000/TIMER_HZ);term_writestring(" ms\n");
+    if(f->cross_links||f->lost_clusters||f->bad_chain_ends||f->size_mismatches||f->bad_entries){
+        term_writestring("  ");term_print_dec(f->cross_links);term_writestring(" cross-links, ");term_print_dec(f->lost_clusters);term_writestring(" lost clusters, ");
+        term_print_dec(f->bad_chain_ends);term_writestring(" bad chain ends, ");term_print_dec(f->size_mismatches);term_writestring(" size mismatches, ");
+        term_print_dec(f->bad_entries);term_writestring(" bad entries\n");
+    }
+    term_writestring(f->repaired?"  repaired, volume remounted\n":r==1?"  volume has errors, run 'fsck -r'\n":"  clean\n");
+}
+void cmd_fsck(char*a){
+    char *opt=next_word(&a); fsck_report_t f; uint32_t start=timer_ticks();
+    int r=fsck_run(opt&&strcmp(opt,"-r")==0?FSCK_REPAIR:0,&f);
+    fsck_print(&f,r,timer_ticks()-start);
+}
+
+// run <file>: feeds each line of a script in the current directory to
+// process_command, as if typed. Blank lines and '#' comments are skipped.
+#define RUN_MAX_DEPTH 4 // Scripts may run scripts, but not forever
+static int run_depth=0;
+static uint32_t run_open[RUN_MAX_DEPTH]; // First clusters of the scripts being run
+static int script_is_open(uint32_t first_cluster){for(int i=0;i<run_depth;++i)if(run_open[i]==first_cluster)return 1;return 0;}
+static int run_script(uint32_t dir,const char *name){
+    Fat32File f; char chunk[512],line[MAX_CMD_LEN]; int n,r; uint32_t len=0,lineno=0,too_long=0;
+    if(run_depth==RUN_MAX_DEPTH){term_writestring("run: scripts nested too deeply\n");return 0;}
+    if((r=fat32_open(dir,name,0,&f))<0)return r;
+    run_open[run_depth++]=f.first_cluster;
+    while((n=fat32_read(&f,chunk,sizeof(chunk)))>0){
+        for(int i=0;i<n;++i){
+            char c=chunk[i];
+            if(c!='\n'){if(c=='\r')continue;if(len<MAX_CMD_LEN-1)line[len++]=c;else too_long=1;continue;}
+            line[len]='\0';lineno++;
+            if(too_long){term_writestring("run: line ");term_print_dec(lineno);term_writestring(" too long, skipped\n");}
+            else if(len>0&&line[0]!='#'){term_writestring("> ");term_writestring(line);term_putchar('\n');process_command(line);}
+            len=0;too_long=0;
+        }
+    }
+    if(n==0&&len>0&&!too_long&&line[0]!='#'){line[len]='\0';term_writestring("> ");term_writestring(line);term_putchar('\n');process_command(line);} // No final newline
+    run_depth--;
+    fat32_close(&f);
+    return n<0?n:0;
+}
+void cmd_run(char*a){
+    char *name=next_word(&a); if(!name){term_writestring("usage: run <file>\n");return;}
+    int r=run_script(fat32_get_current_directory_cluster(),name); if(r<0)fs_error("run",r);
+}
+// time <cmd>: CPU cycles, sectors read per device and console bytes for one command
+static void print_u64(uint64_t v){ // 32-bit steps only: no libgcc for 64-bit division
+    char d[21]; int i=20; d[i]='\0';
+    uint32_t hi=(uint32_t)(v>>32),lo=(uint32_t)v;
+    do{uint32_t r=hi%10,t;hi/=10;t=(r<<16)|(lo>>16);uint32_t q1=t/10;r=t%10;t=(r<<16)|(lo&0xFFFF);lo=(q1<<16)|(t/10);d[--i]=(char)('0'+t%10);}while(hi||lo);
+    term_writestring(&d[i]);
+}
+// Sectors device 'i' read off its medium: queued disks count what they
+// transferred, so md0's pieces show up on its members and md0 counts none.
+static uint32_t leaf_sectors_read(int i){
+    blkdev_t *d=blkdev_get(i); if(!d||stripe_is_volume(d))return 0;
+    return d->queue?d->queue->stats.sectors_read:d->stats.sectors_read;
+}
+void cmd_time(char*a){
+    if(!a){term_writestring("usage: time <command>\n");return;}
+    uint32_t sectors[BLKDEV_MAX];
+    for(int i=0;i<BLKDEV_MAX;++i)sectors[i]=leaf_sectors_read(i);
+    uint32_t out0=term_bytes_written(),t0=timer_ticks(); uint64_t c0=rdtsc();
+    process_command(a);
+    uint64_t cycles=rdtsc()-c0; uint32_t ticks=timer_ticks()-t0,out=term_bytes_written()-out0,total=0;
+    term_writestring("time: ");print_u64(cycles);term_writestring(" cycles (");term_print_dec(ticks*1000/TIMER_HZ);term_writestring(" ms), ");
+    for(int i=0;i<BLKDEV_MAX;++i)total+=leaf_sectors_read(i)-sectors[i];
+    term_print_dec(total);term_writestring(" sectors read");
+    for(int i=0;i<BLKDEV_MAX&&total;++i){uint32_t n=leaf_sectors_read(i)-sectors[i];
+        if(n){term_writestring(" ");term_writestring(blkdev_get(i)->name);term_writestring(":");term_print_dec(n);}}
+    term_writestring(", ");term_print_dec(out);term_writestring(" console bytes\n");
+}
+
+// Threads
+void cmd_ps(char *a) {
+    (void)a; term_writestring("  ID  STATE     CPU  TICKS  NAME\n");
+    for(int i=0;i<MAX_THREADS;++i){
+        const thread_t *t=thread_get_slot(i); if(!t)continue;
+        const char *st=thread_state_name(t->state);
+        term_writestring("  ");term_print_dec(t->id);term_writestring(t->id<10?"   ":"  ");
+        term_writestring(st);for(size_t k=strlen(st);k<10;++k)term_putchar(' ');
+        term_print_dec(t->cpu);term_writestring("    ");
+        term_print_dec(t->cpu_ticks);term_writestring("  ");term_writestring(t->name);term_putchar('\n');
+    }
+}
+void cmd_sleep(char *a) {
+    uint32_t ms=0; if(!a){term_writestring("usage: sleep <ms>\n");return;}
+    for(;*a>='0'&&*a<='9';++a)ms=ms*10+(uint32_t)(*a-'0');
+    thread_sleep_ms(ms);
+}
+
+// CPUs
+void cmd_cpus(char *a) {
+    (void)a; term_writestring("  CPU  APIC  TICKS  IDLE%  SWITCHES  STEALS  QUEUED  RUNNING\n");
+    for(uint32_t i=0;i<MAX_CPUS;++i){
+        const cpu_t *c=&cpus[i]; if(!c->online)continue;
+        uint32_t idle=c->ticks?c->idle_ticks*100/c->ticks:0;
+        term_writestring("  ");term_print_dec(c->index);term_writestring("    ");term_print_dec(c->apic_id);term_writestring("     ");
+        term_print_dec(c->ticks);term_writestring("  ");term_print_dec(idle);term_writestring("%    ");
+        term_print_dec(c->switches);term_writestring("  ");term_print_dec(c->steals);term_writestring("  ");term_print_dec(c->nr_ready);term_writestring("  ");
+        term_writestring(c->current?c->current->name:"-");term_putchar('\n');
+    }
+}
+// smpbench <n>: splits a fixed amount of busy work over n threads and reports
+// the wall-clock ticks, so runs with n = 1 and n = #CPUs show the scaling.
+#define SMPBENCH_WORK 400000000u
+static volatile uint32_t smpbench_sink;
+static void smpbench_worker(void *arg){uint32_t n=(uint32_t)arg,x=0;for(uint32_t i=0;i<n;++i)x+=i^(x>>3);smpbench_sink+=x;}
+void cmd_smpbench(char *a) {
+    uint32_t n=0; thread_t *t[MAX_CPUS*2];
+    if(a)for(;*a>='0'&&*a<='9';++a)n=n*10+(uint32_t)(*a-'0');
+    if(n==0||n>MAX_CPUS*2){term_writestring("usage: smpbench <threads 1-16>\n");return;}
+    uint32_t start=timer_ticks(),made=0;
+    for(;made<n;++made){t[made]=thread_create("bench",smpbench_worker,(void*)(SMPBENCH_WORK/n));if(!t[made])break;}
+    for(uint32_t i=0;i<made;++i)thread_join(t[i]);
+    uint32_t el=timer_ticks()-start;
+    term_print_dec(made);term_writestring(" thread(s) on ");term_print_dec(cpu_online_count());term_writestring(" CPU(s): ");
+    term_print_dec(el*1000/TIMER_HZ);term_writestring(" ms\n");
+}
+
+// Block queue statistics
+void print_queue_stats(const blk_queue_t *q) {
+    const blk_queue_stats_t *st=&q->stats;
+    term_writestring(q->name);term_writestring(": submitted ");term_print_dec(st->submitted);
+    term_writestring(", merged ");term_print_dec(st->merged);term_writestring(" (");term_print_dec(st->submitted?st->merged*100/st->submitted:0);term_writestring("%)");
+    term_writestring(", dispatched ");term_print_dec(st->dispatched);term_putchar('\n');
+    uint32_t avg10=st->dispatched?st->depth_sum*10/st->dispatched:0;
+    term_writestring("  depth now ");term_print_dec(st->depth);term_writestring(", avg ");term_print_dec(avg10/10);term_putchar('.');term_print_dec(avg10%10);
+    term_writestring(", max ");term_print_dec(st->depth_max);term_writestring(", deadline hits ");term_print_dec(st->deadline_hits);term_putchar('\n');
+    term_writestring("  sectors read ");term_print_dec(st->sectors_read);term_writestring(", written ");term_print_dec(st->sectors_written);
+    term_writestring(", errors ");term_print_dec(st->errors);term_putchar('\n');
+}
+void cmd_iostat(char *a){(void)a;for(int i=0;i<BLKDEV_MAX;++i){blkdev_t *d=blkdev_get(i);if(d&&d->queue)print_queue_stats(d->queue);}}
+
+
+// Block devices
+void cmd_devs(char *a) {
+    (void)a; term_writestring("  NAME   SECTORS    MiB  READS  WRITES  ERRORS\n");
+    for(int i=0;i<BLKDEV_MAX;++i){
+        blkdev_t *d=blkdev_get(i); if(!d)continue;
+        term_writestring("  ");term_writestring(d->name);for(size_t k=strlen(d->name);k<7;++k)term_putchar(' ');
+        term_print_dec(d->geometry.sector_count);term_writestring("  ");term_print_dec(d->geometry.sector_count/2048);term_writestring("  ");
+        term_print_dec(d->stats.sectors_read);term_writestring("  ");term_print_dec(d->stats.sectors_written);term_writestring("  ");term_print_dec(d->stats.errors);
+        if(fat32_get_volume_info()&&d==fat32_get_volume_info()->device)term_writestring("  (mounted)");
+        term_putchar('\n');
+    }
+}
+// Where the FAT32 volume starts on 'd': 0 for a bare partition image (FAT32
+// boot sector at LBA 0), else the first FAT32 entry of the MBR, else 2048.
+static uint8_t probe_sector[512];
+static uint32_t fat32_probe_start(blkdev_t *d) {
+    if(blkdev_read(d,0,1,probe_sector)!=0)return 2048;
+    if(memcmp(probe_sector+82,"FAT32   ",8)==0)return 0;
+    if(probe_sector[510]==0x55&&probe_sector[511]==0xAA){
+        for(int i=0;i<4;++i){uint8_t *e=probe_sector+446+i*16;if(e[4]==0x0B||e[4]==0x0C)return e[8]|(e[9]<<8)|(e[10]<<16)|((uint32_t)e[11]<<24);}
+    }
+    return 2048;
+}
+void cmd_mount(char *a) {
+    char *name=next_word(&a); blkdev_t *d=blkdev_find(name);
+    if(!d){term_writestring("usage: mount <dev> [start_lba]   (see 'devs')\n");return;}
+    uint32_t start=parse_dec(next_word(&a),fat32_probe_start(d));
+    int r=fat32_init(d,start);
+    if(r==-7){term_writestring("mount: files are mapped; unmap them first\n");return;}
+    if(r!=0){term_writestring("mount: no FAT32 volume on ");term_writestring(d->name);term_putchar('\n');return;}
+    term_writestring("mounted ");term_writestring(d->name);term_writestring(" at LBA ");term_print_dec(start);term_putchar('\n');
+}
+// ramdisk: copies the mounted volume into RAM disk ram0 and mounts that.
+void cmd_ramdisk(char *a) {
+    (void)a; const Fat32VolumeInfo *v=fat32_get_volume_info();
+    if(!v){term_writestring("ramdisk: nothing mounted\n");return;}
+    if(blkdev_find("ram0")){term_writestring("ramdisk: ram0 exists, use 'mount ram0'\n");return;}
+    if(fat32_mmap_count()){term_writestring("ramdisk: files are mapped; unmap them first\n");return;}
+    fat32_sync(); // The copy must include everything still cached
+    blkdev_t *src=v->device; uint32_t start=v->partition_start_lba, sectors=v->total_sectors;
+    blkdev_t *rd=ramdisk_create(sectors); if(!rd)return;
+    uint32_t t0=timer_ticks();
+    if(ramdisk_load(rd,src,start)!=0){term_writestring("ramdisk: read error while loading\n");return;}
+    term_writestring("ramdisk: loaded ");term_print_dec(sectors/2048);term_writestring(" MiB from ");term_writestring(src->name);
+    term_writestring(" in ");term_print_dec((timer_ticks()-t0)*1000/TIMER_HZ);term_writestring(" ms\n");
+    if(fat32_init(rd,0)!=0)term_writestring("ramdisk: mount failed\n");
+}
+
+// iobench [dev] [n]: n random 4 KiB reads, IOBENCH_DEPTH of them submitted at a
+// time on queued devices (one after another otherwise), to compare IOPS
+// between disk controllers and the RAM disk. Defaults: mounted device, 1024.
+#define IOBENCH_DEPTH 32
+#define IOBENCH_SECTORS 8
+typedef struct { wait_queue_t wait; uint32_t pending; uint32_t errors; } iobench_state_t;
+static uint8_t iobench_buf[IOBENCH_DEPTH][IOBENCH_SECTORS*512] __attribute__((aligned(16)));
+static void iobench_done(blk_request_t *rq,int status){iobench_state_t *s=(iobench_state_t*)rq->private_data;uint32_t f=wait_queue_lock(&s->wait);if(status<0)s->errors++;if(--s->pending==0)wait_queue_wake_all_locked(&s->wait);wait_queue_unlock(&s->wait,f);}
+void cmd_iobench(char *a) {
+    char *w=next_word(&a); blkdev_t *d=blkdev_find(w);
+    if(d)w=next_word(&a); else d=fat32_get_volume_info()?fat32_get_volume_info()->device:NULL;
+    if(!d){term_writestring("usage: iobench [dev] [n]\n");return;}
+    uint32_t n=parse_dec(w,1024); if(n==0)n=1024;
+    uint32_t span=d->geometry.sector_count/IOBENCH_SECTORS, seed=0x1234567u;
+    blk_request_t rqs[IOBENCH_DEPTH]; iobench_state_t st={WAIT_QUEUE_INIT,0,0};
+    uint32_t start=timer_ticks();
+    for(uint32_t done=0;done<n;){
+        uint32_t batch=n-done<IOBENCH_DEPTH?n-done:IOBENCH_DEPTH;
+        st.pending=batch;
+        for(uint32_t i=0;i<batch;++i){
+            seed=seed*1103515245u+12345u;
+            uint32_t lba=((seed>>8)%span)*IOBENCH_SECTORS;
+            if(!d->queue){if(blkdev_read(d,lba,IOBENCH_SECTORS,iobench_buf[i])!=0)st.errors++;st.pending--;continue;}
+            memset(&rqs[i],0,sizeof(rqs[i]));
+            rqs[i].lba=lba; rqs[i].count=IOBENCH_SECTORS;
+            rqs[i].buffer=iobench_buf[i]; rqs[i].op=BLK_READ; rqs[i].done=iobench_done; rqs[i].private_data=&st;
+            if(blk_submit(d->queue,&rqs[i])!=0){uint32_t f=wait_queue_lock(&st.wait);st.errors++;st.pending--;wait_queue_unlock(&st.wait,f);}
+        }
+        uint32_t f=wait_queue_lock(&st.wait); while(st.pending>0)wait_queue_sleep(&st.wait); wait_queue_unlock(&st.wait,f);
+        done+=batch;
+    }
+    uint32_t ms=(timer_ticks()-start)*1000/TIMER_HZ; if(ms==0)ms=1;
+    term_writestring(d->name);term_writestring(": ");term_print_dec(n);term_writestring(" random 4K reads in ");term_print_dec(ms);
+    term_writestring(" ms = ");term_print_dec(n*1000/ms);term_writestring(" IOPS, errors ");term_print_dec(st.errors);term_putchar('\n');
+}
+
+// mkstripe <stripe_kib> <dev> <dev> [...]: striped volume md0 over the devices.
+void cmd_mkstripe(char *a) {
+    uint32_t kib=parse_dec(next_word(&a),0); blkdev_t *m[STRIPE_MAX_MEMBERS]; int n=0; char *w;
+    while((w=next_word(&a))!=NULL){
+        if(n==STRIPE_MAX_MEMBERS||!(m[n]=blkdev_find(w))){term_writestring("mkstripe: bad device ");term_writestring(w);term_putchar('\n');return;}
+        const Fat32VolumeInfo *v=fat32_get_volume_info();
+        if((v&&v->device==m[n])||stripe_is_member(m[n])){term_writestring("mkstripe: ");term_writestring(w);term_writestring(v&&v->device==m[n]?" holds the mounted volume\n":" is already striped\n");return;}
+        n++;
+    }
+    if(kib==0||n<2){term_writestring("usage: mkstripe <stripe_kib> <dev> <dev> [...]   e.g. mkstripe 64 hd1 hd2\n");return;}
+    blkdev_t *d=stripe_create("md0",m,n,kib*2);
+    if(!d){term_writestring("mkstripe: failed (stripe size a power of two? members queued and distinct? only one stripe set)\n");return;}
+    term_writestring("md0: ");term_print_dec(n);term_writestring(" members, ");term_print_dec(kib);term_writestring(" KiB stripes\n");
+}
+
+// seqbench <dev> [MiB]: sequential reads of SEQBENCH_SECTORS at a time from
+// the start of the device, for throughput (md0 against one of its members).
+#define SEQBENCH_SECTORS 512
+static uint8_t seqbench_buf[SEQBENCH_SECTORS*512] __attribute__((aligned(16)));
+void cmd_seqbench(char *a) {
+    blkdev_t *d=blkdev_find(next_word(&a));
+    if(!d){term_writestring("usage: seqbench <dev> [MiB]\n");return;}
+    uint32_t mib=parse_dec(next_word(&a),16), total=mib*2048;
+    if(total==0||total>d->geometry.sector_count)total=d->geometry.sector_count-d->geometry.sector_count%SEQBENCH_SECTORS;
+    uint32_t errors=0, start=timer_ticks();
+    for(uint32_t lba=0;lba<total;lba+=SEQBENCH_SECTORS){
+        uint32_t n=total-lba<SEQBENCH_SECTORS?total-lba:SEQBENCH_SECTORS;
+        if(blkdev_read(d,lba,n,seqbench_buf)!=0)errors++;
+    }
+    uint32_t ms=(timer_ticks()-start)*1000/TIMER_HZ; if(ms==0)ms=1;
+    term_writestring(d->name);term_writestring(": ");term_print_dec(total/2048);term_writestring(" MiB sequential read in ");term_print_dec(ms);
+    term_writestring(" ms = ");term_print_dec(total/2*1000/ms);term_writestring(" KiB/s, errors ");term_print_dec(errors);term_putchar('\n');
+}
 
 // Readline
 void readline(char *b, size_t max){size_t i=0;char c;b[0]='\0';while(i<max-1){c=kbd_getchar();if(c=='\n'){term_putchar('\n');break;}else if(c=='\b'){if(i>0){i--;term_putchar('\b');}}else if(c>=' '&&c<='~'){b[i++]=c;term_putchar(c);}}b[i]='\0';}
 
 // Process Command (with debug checks before loop)
 void process_command(char *line){
-    char *cmd=line; char *arg=NULL; int f=0;
-    term_writestring("\nDBG: Line:'");term_writestring(line);term_writestring("'\n");
+    char *cmd=line; char *arg=NULL;
     while(*cmd==' ')cmd++; if(*cmd=='\0'){return;} char* s=cmd; while(*s!='\0'&&*s!=' ')s++;
     if(*s==' '){*s='\0';arg=s+1;while(*arg==' ')arg++;if(*arg=='\0')arg=NULL;}
-    term_writestring("DBG: Cmd:'");term_writestring(cmd);term_writestring("' Arg:'");term_writestring(arg?arg:"null");term_writestring("'\n");
-    // Check commands array right before loop
-    term_writestring("DEBUG: Just before loop: commands[0].name = '"); if(commands[0].name)term_writestring(commands[0].name);else term_writestring("(NULL!)"); term_writestring("'\n");
-    // Loop through commands
     for(int j=0;commands[j].name!=NULL;j++){
-        //term_writestring("DBG: Check ");term_writestring(commands[j].name);term_putchar('\n'); // Keep commented for now
-        if(strcmp(cmd,commands[j].name)==0){term_writestring("DBG: Match! Run\n");commands[j].func(arg);f=1;return;} // Using return from user file
+        if(strcmp(cmd,commands[j].name)==0){commands[j].func(arg);return;}
     }
-    if(!f){term_writestring("ERR: Cmd not found:'");term_writestring(cmd);term_writestring("'\n");}
+    term_writestring("ERR: Cmd not found:'");term_writestring(cmd);term_writestring("'\n");
 }
 
 // Kernel Main (No location/time)
 void kernel_main(void){
     char buf[MAX_CMD_LEN]; term_init(); term_writestring("Kernel starting...\n");
-    ide_initialize(); uint32_t pstart=2048; if(fat32_init(pstart)!=0){term_setcolor(VGA_COLOR_RED,VGA_COLOR_BLACK);term_writestring("PANIC: FAT32 FAIL\n");asm volatile("cli;hlt");}
+    gdt_init(); cpu_setup(0,0); idt_init(); paging_init(); pagecache_init(); thread_init(); timer_init(); irq_enable(); // Preemptive scheduling from here on
+    smp_init(); // APIC routing, per-CPU LAPIC timers, application processors
+    blkdev_t *boot=NULL; // SATA disk if there is one, else PATA
+    if(ahci_initialize()==0)boot=ahci_get_device(); else if(ide_initialize()==0)boot=ide_get_device(0);
+    uint32_t pstart=2048; if(fat32_init(boot,pstart)!=0){term_setcolor(VGA_COLOR_RED,VGA_COLOR_BLACK);term_writestring("PANIC: FAT32 FAIL\n");asm volatile("cli;hlt");}
+    { fsck_report_t f; uint32_t t0=timer_ticks(); int r=fsck_run(0,&f); fsck_print(&f,r,timer_ticks()-t0); } // Check only: repairs are 'fsck -r'
+#ifdef RAMDISK_AT_BOOT
+    cmd_ramdisk(NULL); // 'make RAMDISK=1': run the volume from memory
+#endif
     kbd_init(); term_setcolor(VGA_COLOR_LIGHT_GREEN,VGA_COLOR_BLACK); term_writestring("\nWelcome MyOS ");term_writestring(KERNEL_VERSION);term_writestring("!\nFAT32 OK. Type 'help'.\n\n");term_setcolor(VGA_COLOR_LIGHT_GREY,VGA_COLOR_BLACK);
     // No strcmp test call here
+    { const Fat32VolumeInfo *v=fat32_get_volume_info(); if(v)run_script(v->bpb.root_dir_cluster,"autoexec"); } // Optional: skipped if absent
     while(1){term_writestring("> ");readline(buf,MAX_CMD_LEN);process_command(buf);}
 }
\ No newline at end of file
@@ -0,0 +1,188 @@
+// kernel/mmap.c
+// Memory-mapped FAT32 files on top of the page cache. Readably formatted.
+
+#include "mmap.h"
+#include "pagecache.h"
+#include "paging.h"
+#include "thread.h"
+#include "string.h"
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    uint32_t start, pages;  // View [start, start + pages * PAGE_SIZE); start 0: slot free
+    uint32_t first_index;   // File page shown at 'start'
+    uint32_t faults;        // Faults in progress that looked the region up
+    int dying;              // Being unmapped: no new faults, address range still taken
+    Fat32File file;         // Private copy: the caller may close its handle
+} mmap_region_t;
+
+// --- Module State ---
+// mmap_wait.lock guards the region table (not the files in it); munmap
+// sleeps on it until the region's faults are done.
+static wait_queue_t mmap_wait = WAIT_QUEUE_INIT;
+static mmap_region_t regions[MMAP_MAX_REGIONS];
+static int fault_range_registered = 0;
+
+// --- Helpers ---
+// Page-cache fill callback: the file's bytes, zeros past the end.
+static int fill_from_file(void *ctx, uint32_t index, uint8_t *page) {
+    Fat32File *f = (Fat32File*)ctx;
+    uint32_t offset = index * PAGE_SIZE, n = 0;
+    if (offset < f->size) {
+        n = f->size - offset < PAGE_SIZE ? f->size - offset : PAGE_SIZE;
+        if (fat32_seek(f, offset) != 0 || fat32_read(f, page, n) != (int)n) return -3;
+    }
+    memset(page + n, 0, PAGE_SIZE - n);
+    return 0;
+}
+
+// Live region holding 'vaddr'. Caller holds mmap_wait.lock.
+static mmap_region_t *region_at(uint32_t vaddr) {
+    for (int i = 0; i < MMAP_MAX_REGIONS; ++i) {
+        mmap_region_t *r = &regions[i];
+        if (r->start && !r->dying && vaddr >= r->start && vaddr < r->start + r->pages * PAGE_SIZE) return r;
+    }
+    return NULL;
+}
+
+// First gap of 'pages' pages in the mmap window, or 0. Caller holds mmap_wait.lock.
+static uint32_t find_gap(uint32_t pages) {
+    uint32_t start = MMAP_BASE, size = pages * PAGE_SIZE;
+    for (int moved = 1; moved; ) {
+        moved = 0;
+        for (int i = 0; i < MMAP_MAX_REGIONS; ++i) {
+            const mmap_region_t *r = &regions[i];
+            uint32_t end = r->start + r->pages * PAGE_SIZE;
+            if (r->start && start < end && start + size > r->start) { start = end; moved = 1; }
+        }
+    }
+    return start + size <= MMAP_TOP && start + size > start ? start : 0;
+}
+
+// Faults in the mmap window: map the cached page read-only. Writes fault
+// again with PF_PROTECTION and are refused. The region counts the fault
+// until the page is mapped, so munmap cannot remove it underneath.
+static int mmap_fault(uint32_t addr, uint32_t err, interrupt_frame_t *frame) {
+    (void)frame;
+    uint32_t page = addr & PAGE_MASK, frame_phys;
+    if (err & PF_PROTECTION) return -1;
+    uint32_t flags = wait_queue_lock(&mmap_wait);
+    mmap_region_t *r = region_at(page);
+    Fat32File file; // Own handle: faults on other CPUs move theirs independently
+    uint32_t index = 0;
+    if (r) {
+        r->faults++;
+        file = r->file;
+        index = r->first_index + (page - r->start) / PAGE_SIZE;
+    }
+    wait_queue_unlock(&mmap_wait, flags);
+    if (!r) return -1;
+
+    int result = 0;
+    if (!page_lookup(page)) { // Else mapped meanwhile (stale TLB entry)
+        if (fat32_page_get(&file, index, &frame_phys) < 0) result = -1;
+        else if ((result = page_map(page, frame_phys, PTE_SHARED)) != 0) {
+            pagecache_put(frame_phys); // -2: another CPU mapped it first, with its own pin
+            result = result == -2 ? 0 : -1;
+        }
+    }
+    flags = wait_queue_lock(&mmap_wait);
+    if (!r->dying) { // Keep the chain cursor so the next fault starts near here
+        r->file.cursor_index = file.cursor_index;
+        r->file.cursor_cluster = file.cursor_cluster;
+    }
+    if (--r->faults == 0 && r->dying) wait_queue_wake_all_locked(&mmap_wait);
+    wait_queue_unlock(&mmap_wait, flags);
+    return result;
+}
+
+// --- Public Functions ---
+int fat32_page_get(Fat32File *file, uint32_t index, uint32_t *frame) {
+    if (!file || !file->first_cluster) return -1;
+    return pagecache_get(file->first_cluster, index, fill_from_file, file, frame);
+}
+
+static int fat32_mmap_locked(Fat32File *file, uint32_t offset, uint32_t length, const void **addr) {
+    if (!file || !addr || offset % PAGE_SIZE || offset >= file->size) return -1;
+    if (length > file->size - offset) length = file->size - offset;
+    if (length == 0) return -1;
+    int r = fat32_flush(file); // Buffered tail data must be on disk for the view's own handle
+    if (r != 0) return r;
+    if (!file->first_cluster) return -1;
+
+    uint32_t flags = wait_queue_lock(&mmap_wait);
+    if (!fault_range_registered) {
+        if (paging_register_fault_range(MMAP_BASE, MMAP_TOP, mmap_fault) != 0) {
+            wait_queue_unlock(&mmap_wait, flags);
+            return -4;
+        }
+        fault_range_registered = 1;
+    }
+    mmap_region_t *slot = NULL;
+    for (int i = 0; i < MMAP_MAX_REGIONS && !slot; ++i) {
+        if (!regions[i].start) slot = &regions[i];
+    }
+    uint32_t pages = (length + PAGE_SIZE - 1) / PAGE_SIZE, start = slot ? find_gap(pages) : 0;
+    if (start) {
+        slot->start = start;
+        slot->pages = pages;
+        slot->first_index = offset / PAGE_SIZE;
+        slot->faults = 0;
+        slot->dying = 0;
+        slot->file = *file;
+    }
+    wait_queue_unlock(&mmap_wait, flags);
+    if (!start) return -4;
+    *addr = (const void*)start;
+    return 0;
+}
+
+int fat32_mmap(Fat32File *file, uint32_t offset, uint32_t length, const void **addr) {
+    fat32_lock(); // No remount between checking the file and adding the region
+    int r = fat32_mmap_locked(file, offset, length, addr);
+    fat32_unlock();
+    return r;
+}
+
+uint32_t fat32_mmap_count(void) {
+    uint32_t flags = wait_queue_lock(&mmap_wait), n = 0;
+    for (int i = 0; i < MMAP_MAX_REGIONS; ++i) {
+        if (regions[i].start) n++;
+    }
+    wait_queue_unlock(&mmap_wait, flags);
+    return n;
+}
+
+int fat32_is_mapped(uint32_t first_cluster) {
+    uint32_t flags = wait_queue_lock(&mmap_wait);
+    int mapped = 0;
+    for (int i = 0; i < MMAP_MAX_REGIONS && !mapped; ++i) {
+        mapped = regions[i].start && regions[i].file.first_cluster == first_cluster;
+    }
+    wait_queue_unlock(&mmap_wait, flags);
+    return mapped;
+}
+
+int fat32_munmap(const void *addr) {
+    uint32_t flags = wait_queue_lock(&mmap_wait);
+    mmap_region_t *r = region_at((uint32_t)addr);
+    if (!r || r->start != (uint32_t)addr) {
+        wait_queue_unlock(&mmap_wait, flags);
+        return -1;
+    }
+    r->dying = 1; // New faults in the range fail; the range stays taken until unmapped
+    while (r->faults) wait_queue_sleep(&mmap_wait);
+    uint32_t start = r->start, pages = r->pages;
+    wait_queue_unlock(&mmap_wait, flags);
+
+    for (uint32_t i = 0; i < pages; ++i) {
+        uint32_t pte = page_unmap(start + i * PAGE_SIZE);
+        if (pte) pagecache_put(pte & PAGE_MASK);
+    }
+    flags = wait_queue_lock(&mmap_wait);
+    r->start = 0;
+    r->dying = 0;
+    wait_queue_unlock(&mmap_wait, flags);
+    return 0;
+}
@@ -0,0 +1,39 @@
+// kernel/mmap.h
+// Memory-mapped FAT32 files. A mapping is a read-only view in the mmap
+// part of the user window whose pages are page-cache frames, mapped on
+// first touch: scanning a mapped file twice reads the disk once and copies
+// nothing. Readably formatted.
+
+#ifndef MMAP_H
+#define MMAP_H
+
+#include <stdint.h>
+#include "fat32.h"
+
+// User window layout: program image [USER_BASE, MMAP_BASE), mappings
+// [MMAP_BASE, MMAP_TOP), program stack below USER_TOP.
+#define MMAP_BASE        0x60000000
+#define MMAP_TOP         0x7F000000
+#define MMAP_MAX_REGIONS 16
+
+// Maps 'length' bytes of 'file' from 'offset' (a multiple of PAGE_SIZE),
+// clipped to the file size. The file may be closed afterwards; writes made
+// through other handles show up in the view. Returns 0 and the view's
+// address in *addr, -1 for bad arguments or an empty file, -4 when no
+// address space or mapping slot is left.
+int fat32_mmap(Fat32File *file, uint32_t offset, uint32_t length, const void **addr);
+
+// Mappings not yet removed. The volume cannot be remounted while any exist.
+uint32_t fat32_mmap_count(void);
+
+// Nonzero if some mapping views the file whose chain starts at 'first_cluster'.
+int fat32_is_mapped(uint32_t first_cluster);
+
+// Removes the mapping starting at 'addr'. Returns 0, or -1 if there is none.
+int fat32_munmap(const void *addr);
+
+// Page 'index' of 'file' from the page cache, filled from the file on a
+// miss, pinned until pagecache_put(*frame). Returns as pagecache_get().
+int fat32_page_get(Fat32File *file, uint32_t index, uint32_t *frame);
+
+#endif // MMAP_H
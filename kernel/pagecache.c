@@ -0,0 +1,249 @@
+// kernel/pagecache.c
+// Unified page cache. Readably formatted.
+
+#include "pagecache.h"
+#include "paging.h"
+#include "thread.h"
+#include "string.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Hash links hold slot + 1, so that zeroed .bss is an empty table.
+typedef struct {
+    uint32_t file;          // Key; 0 while the slot holds no page
+    uint32_t index;
+    uint32_t frame;         // 0: slot has no frame
+    uint32_t last_use;      // LRU clock
+    uint16_t refs;          // Pins: mappings plus copies in progress
+    uint8_t loading;        // Being filled; lookups sleep on cache_wait
+    uint8_t detached;       // Truncated away while pinned: freed at the last put
+    uint16_t key_next;      // Key hash chain
+    uint16_t frame_next;    // Frame hash chain (for pagecache_put)
+} cache_page_t;
+
+// --- Module State ---
+// cache_wait.lock guards everything below.
+static wait_queue_t cache_wait = WAIT_QUEUE_INIT;
+static cache_page_t pages[PAGECACHE_MAX_PAGES];
+static uint16_t key_heads[PAGECACHE_HASH];
+static uint16_t frame_heads[PAGECACHE_HASH];
+static uint32_t use_clock = 0;
+static pagecache_stats_t stats;
+
+// --- Helpers (cache lock held) ---
+static uint32_t key_hash(uint32_t file, uint32_t index) { return (file * 31 + index) & (PAGECACHE_HASH - 1); }
+static uint32_t frame_hash(uint32_t frame) { return (frame / PAGE_SIZE) & (PAGECACHE_HASH - 1); }
+
+static int key_lookup(uint32_t file, uint32_t index) {
+    for (uint16_t l = key_heads[key_hash(file, index)]; l; l = pages[l - 1].key_next) {
+        if (pages[l - 1].file == file && pages[l - 1].index == index) return l - 1;
+    }
+    return -1;
+}
+
+static void key_link(int s) {
+    uint32_t h = key_hash(pages[s].file, pages[s].index);
+    pages[s].key_next = key_heads[h];
+    key_heads[h] = (uint16_t)(s + 1);
+}
+
+static void key_unlink(int s) {
+    uint16_t *l = &key_heads[key_hash(pages[s].file, pages[s].index)];
+    while (*l && *l != s + 1) l = &pages[*l - 1].key_next;
+    if (*l) *l = pages[s].key_next;
+    pages[s].file = 0;
+}
+
+static int frame_lookup(uint32_t frame) {
+    for (uint16_t l = frame_heads[frame_hash(frame)]; l; l = pages[l - 1].frame_next) {
+        if (pages[l - 1].frame == frame) return l - 1;
+    }
+    return -1;
+}
+
+static void frame_link(int s) {
+    uint32_t h = frame_hash(pages[s].frame);
+    pages[s].frame_next = frame_heads[h];
+    frame_heads[h] = (uint16_t)(s + 1);
+}
+
+// Empties slot 's' (not pinned) and returns its frame to the pool.
+static void release_slot(int s) {
+    cache_page_t *p = &pages[s];
+    if (p->file) key_unlink(s);
+    uint16_t *l = &frame_heads[frame_hash(p->frame)];
+    while (*l && *l != s + 1) l = &pages[*l - 1].frame_next;
+    if (*l) *l = p->frame_next;
+    frame_free(p->frame);
+    memset(p, 0, sizeof(*p));
+    stats.resident--;
+}
+
+// Least recently used page nobody holds, or -1.
+static int pick_victim(void) {
+    int victim = -1;
+    for (int s = 0; s < PAGECACHE_MAX_PAGES; ++s) {
+        const cache_page_t *p = &pages[s];
+        if (!p->frame || p->refs || p->loading) continue;
+        if (victim < 0 || p->last_use < pages[victim].last_use) victim = s;
+    }
+    return victim;
+}
+
+// A slot with a frame for a new page, not yet keyed. May drop the lock to
+// allocate (frame_alloc() can call back into pagecache_reclaim()).
+static int claim_slot(uint32_t *irq) {
+    if (stats.resident < PAGECACHE_MAX_PAGES) {
+        wait_queue_unlock(&cache_wait, *irq);
+        uint32_t frame = frame_alloc();
+        *irq = wait_queue_lock(&cache_wait);
+        if (frame) {
+            for (int s = 0; s < PAGECACHE_MAX_PAGES; ++s) {
+                if (pages[s].frame) continue;
+                pages[s].frame = frame;
+                frame_link(s);
+                stats.resident++;
+                return s;
+            }
+            frame_free(frame); // Others filled the table meanwhile
+        }
+    }
+    int s = pick_victim();
+    if (s < 0) return -1;
+    if (pages[s].file) key_unlink(s);
+    stats.evictions++;
+    return s;
+}
+
+static void unpin(int s) {
+    if (--pages[s].refs == 0 && pages[s].detached) release_slot(s);
+}
+
+// --- Public Functions ---
+void pagecache_init(void) {
+    paging_set_reclaim_handler(pagecache_reclaim);
+}
+
+int pagecache_get(uint32_t file, uint32_t index, pagecache_fill_t fill, void *ctx, uint32_t *frame) {
+    if (!file) return -1;
+    uint32_t irq = wait_queue_lock(&cache_wait);
+    int s;
+    for (;;) {
+        while ((s = key_lookup(file, index)) >= 0 && pages[s].loading) wait_queue_sleep(&cache_wait);
+        if (s >= 0) {
+            pages[s].refs++;
+            pages[s].last_use = ++use_clock;
+            stats.hits++;
+            *frame = pages[s].frame;
+            wait_queue_unlock(&cache_wait, irq);
+            return 1;
+        }
+        s = claim_slot(&irq);
+        if (s < 0) { wait_queue_unlock(&cache_wait, irq); return -4; }
+        if (key_lookup(file, index) < 0) break;
+        pages[s].last_use = 0; // Someone else loaded it while the lock was dropped
+    }
+
+    cache_page_t *p = &pages[s];
+    p->file = file; p->index = index;
+    p->refs = 1; p->loading = 1; p->detached = 0;
+    p->last_use = ++use_clock;
+    key_link(s);
+    stats.misses++;
+    wait_queue_unlock(&cache_wait, irq);
+
+    int r = fill(ctx, index, (uint8_t*)p->frame); // Pool frames are identity-mapped
+
+    irq = wait_queue_lock(&cache_wait);
+    p->loading = 0;
+    if (r != 0) {
+        p->refs = 0;
+        release_slot(s);
+    } else {
+        *frame = p->frame;
+    }
+    wait_queue_wake_all_locked(&cache_wait);
+    wait_queue_unlock(&cache_wait, irq);
+    return r;
+}
+
+void pagecache_put(uint32_t frame) {
+    uint32_t irq = wait_queue_lock(&cache_wait);
+    int s = frame_lookup(frame);
+    if (s >= 0 && pages[s].refs > 0) unpin(s);
+    wait_queue_unlock(&cache_wait, irq);
+}
+
+void pagecache_write(uint32_t file, uint32_t offset, const uint8_t *data, uint32_t len) {
+    if (!file) return;
+    while (len > 0) {
+        uint32_t index = offset / PAGE_SIZE, in_page = offset % PAGE_SIZE;
+        uint32_t n = PAGE_SIZE - in_page < len ? PAGE_SIZE - in_page : len;
+        uint32_t irq = wait_queue_lock(&cache_wait);
+        int s = key_lookup(file, index);
+        if (s >= 0 && !pages[s].loading) {
+            pages[s].refs++; // Copy outside the lock: 'data' may fault
+            wait_queue_unlock(&cache_wait, irq);
+            memcpy((uint8_t*)pages[s].frame + in_page, data, n);
+            irq = wait_queue_lock(&cache_wait);
+            unpin(s);
+        }
+        wait_queue_unlock(&cache_wait, irq);
+        offset += n; data += n; len -= n;
+    }
+}
+
+void pagecache_truncate(uint32_t file, uint32_t size) {
+    if (!file) return;
+    uint32_t keep = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+    uint32_t irq = wait_queue_lock(&cache_wait);
+    for (int s = 0; s < PAGECACHE_MAX_PAGES; ++s) {
+        cache_page_t *p = &pages[s];
+        if (p->file != file) continue;
+        if (p->index < keep) {
+            if (p->index == keep - 1 && size % PAGE_SIZE) {
+                memset((uint8_t*)p->frame + size % PAGE_SIZE, 0, PAGE_SIZE - size % PAGE_SIZE);
+            }
+        } else if (p->refs || p->loading) {
+            key_unlink(s);
+            p->detached = 1;
+        } else {
+            release_slot(s);
+        }
+    }
+    wait_queue_unlock(&cache_wait, irq);
+}
+
+void pagecache_invalidate_all(void) {
+    uint32_t irq = wait_queue_lock(&cache_wait);
+    for (int s = 0; s < PAGECACHE_MAX_PAGES; ++s) {
+        cache_page_t *p = &pages[s];
+        if (!p->file) continue;
+        if (p->refs || p->loading) { key_unlink(s); p->detached = 1; }
+        else release_slot(s);
+    }
+    wait_queue_unlock(&cache_wait, irq);
+}
+
+uint32_t pagecache_reclaim(uint32_t want) {
+    uint32_t freed = 0, irq = wait_queue_lock(&cache_wait);
+    while (freed < want) {
+        int s = pick_victim();
+        if (s < 0) break;
+        release_slot(s);
+        stats.evictions++;
+        freed++;
+    }
+    wait_queue_unlock(&cache_wait, irq);
+    return freed;
+}
+
+void pagecache_get_stats(pagecache_stats_t *out) {
+    uint32_t irq = wait_queue_lock(&cache_wait);
+    *out = stats;
+    out->pinned = 0;
+    for (int s = 0; s < PAGECACHE_MAX_PAGES; ++s) {
+        if (pages[s].frame && pages[s].refs) out->pinned++;
+    }
+    wait_queue_unlock(&cache_wait, irq);
+}
@@ -0,0 +1,57 @@
+// kernel/pagecache.h
+// Unified page cache: 4 KiB file pages indexed by (file, page index), held
+// in frames from the paging pool and mapped straight into the user window
+// by their users (fat32_mmap, the ELF loader), so repeated scans copy
+// nothing. A page is pinned while mapped or being copied; unpinned pages are
+// evicted least recently used when the cache is full or frame_alloc() runs
+// dry. Readably formatted.
+
+#ifndef PAGECACHE_H
+#define PAGECACHE_H
+
+#include <stdint.h>
+
+#define PAGECACHE_MAX_PAGES 1024 // 4 MiB: half of the frame pool
+#define PAGECACHE_HASH      256  // Hash buckets (power of two)
+
+// Fills 'page' (4 KiB) with page 'index' of the file behind 'ctx'.
+// Returns 0 or a negative error.
+typedef int (*pagecache_fill_t)(void *ctx, uint32_t index, uint8_t *page);
+
+typedef struct {
+    uint32_t hits, misses;  // Lookups served from memory / filled from the file
+    uint32_t evictions;     // Pages dropped to make room
+    uint32_t resident;      // Pages held now
+    uint32_t pinned;        // ... of which mapped or in use
+} pagecache_stats_t;
+
+// Hooks the cache into frame_alloc() as its reclaim handler.
+void pagecache_init(void);
+
+// Page 'index' of 'file' (non-zero id, e.g. the first cluster), pinned.
+// Fills it through 'fill' on a miss; concurrent lookups of a page being
+// filled wait for it. Returns 1 on a hit, 0 after a fill, negative on error
+// (-4: every page is pinned). The frame goes to *frame.
+int pagecache_get(uint32_t file, uint32_t index, pagecache_fill_t fill, void *ctx, uint32_t *frame);
+
+// Unpins the page held in 'frame'.
+void pagecache_put(uint32_t frame);
+
+// Keeps resident pages of 'file' in step with a write of 'len' bytes at
+// byte 'offset'. Pages that are not resident are left alone.
+void pagecache_write(uint32_t file, uint32_t offset, const uint8_t *data, uint32_t len);
+
+// The file shrank to 'size' bytes: pages past it are dropped and the tail
+// of the last page is zeroed. 'size' 0 forgets the file (its id may be
+// reused). Pinned pages are detached and freed at their last put.
+void pagecache_truncate(uint32_t file, uint32_t size);
+
+// Forgets every file (the volume was replaced).
+void pagecache_invalidate_all(void);
+
+// Evicts up to 'want' unpinned pages and frees their frames.
+uint32_t pagecache_reclaim(uint32_t want);
+
+void pagecache_get_stats(pagecache_stats_t *out);
+
+#endif // PAGECACHE_H
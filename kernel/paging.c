@@ -0,0 +1,238 @@
+// kernel/paging.c
+// Page directory, frame pool and page-fault dispatch. Readably formatted.
+
+#include "paging.h"
+#include "cpu.h"
+#include "io.h"
+#include "spinlock.h"
+#include "string.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define PD_ENTRIES        1024
+#define PT_ENTRIES        1024
+#define POOL_FRAMES       (FRAME_POOL_SIZE / PAGE_SIZE)
+#define USER_PDE_FIRST    (USER_BASE / LARGE_PAGE_SIZE)
+#define USER_PDE_END      (USER_TOP / LARGE_PAGE_SIZE)
+#define VECTOR_PAGE_FAULT 14
+#define EFLAGS_IF         0x200
+#define CMOS_ADDRESS      0x70
+#define CMOS_DATA         0x71
+
+// --- Module State ---
+static uint32_t page_directory[PD_ENTRIES] __attribute__((aligned(PAGE_SIZE)));
+static spinlock_t paging_lock = SPINLOCK_INIT; // Directory, page tables and the frame bitmap
+static uint32_t pool_base = 0;                 // Physical address of the frame pool
+static uint32_t pool_bitmap[POOL_FRAMES / 32]; // Bit set: frame in use
+static uint32_t pool_free = 0;
+static uint32_t pool_hint = 0;                 // Where the next search starts
+static volatile uint32_t tlb_generation = 0;   // Bumped by every unmap or remap
+static struct { uint32_t start, end; page_fault_handler_t handler; } fault_ranges[PAGING_MAX_FAULT_RANGES];
+static frame_reclaim_t reclaim_handler = NULL;
+
+// --- Helpers ---
+static uint8_t cmos_read(uint8_t reg) {
+    uint32_t flags = irq_save();
+    outb(CMOS_ADDRESS, reg);
+    uint8_t v = inb(CMOS_DATA);
+    irq_restore(flags);
+    return v;
+}
+
+// Top of RAM from the CMOS size registers the BIOS fills in. Memory at or
+// above the user window is left unused.
+static uint32_t ram_top(void) {
+    uint32_t top, above_16m = cmos_read(0x34) | ((uint32_t)cmos_read(0x35) << 8); // 64 KiB blocks
+    if (above_16m) top = 0x1000000 + above_16m * 0x10000;
+    else top = 0x100000 + (cmos_read(0x30) | ((uint32_t)cmos_read(0x31) << 8)) * 1024; // KiB above 1 MiB
+    return top > USER_BASE ? USER_BASE : top;
+}
+
+static void paging_enable(void) {
+    uint32_t cr0, cr4;
+    asm volatile("mov %0, %%cr3" : : "r"(page_directory) : "memory");
+    asm volatile("mov %%cr4, %0" : "=r"(cr4));
+    asm volatile("mov %0, %%cr4" : : "r"(cr4 | CR4_PSE));
+    asm volatile("mov %%cr0, %0" : "=r"(cr0));
+    asm volatile("mov %0, %%cr0" : : "r"(cr0 | CR0_PG | CR0_WP) : "memory"); // Identity-mapped: execution simply continues
+}
+
+static inline void invlpg(uint32_t vaddr) {
+    asm volatile("invlpg (%0)" : : "r"(vaddr) : "memory");
+}
+
+// Caller holds paging_lock.
+static uint32_t frame_alloc_locked(void) {
+    for (uint32_t n = 0; n < POOL_FRAMES && pool_free > 0; ++n) {
+        uint32_t i = (pool_hint + n) % POOL_FRAMES;
+        if (pool_bitmap[i / 32] & (1u << (i % 32))) continue;
+        pool_bitmap[i / 32] |= 1u << (i % 32);
+        pool_free--;
+        pool_hint = i + 1;
+        return pool_base + i * PAGE_SIZE;
+    }
+    return 0;
+}
+
+// Page table entry for 'vaddr', or NULL if its page table does not exist.
+// Caller holds paging_lock.
+static uint32_t *pte_of(uint32_t vaddr) {
+    uint32_t pde = page_directory[vaddr / LARGE_PAGE_SIZE];
+    if (!(pde & PTE_PRESENT)) return NULL;
+    return (uint32_t*)(pde & PAGE_MASK) + (vaddr / PAGE_SIZE) % PT_ENTRIES;
+}
+
+static int in_user_window(uint32_t vaddr) { return vaddr >= USER_BASE && vaddr < USER_TOP; }
+
+static page_fault_handler_t fault_handler_for(uint32_t vaddr) {
+    for (int i = 0; i < PAGING_MAX_FAULT_RANGES; ++i) {
+        if (fault_ranges[i].handler && vaddr >= fault_ranges[i].start && vaddr < fault_ranges[i].end) return fault_ranges[i].handler;
+    }
+    return NULL;
+}
+
+// Vector 14. The handler of the faulting address gets the first try, the
+// handler of the faulting code the second (it may stop a program that
+// touched something it should not). Only when the faulting code could
+// sleep anyway (interrupts were on, not inside an IRQ handler): filling a
+// page usually means disk I/O.
+static int page_fault(interrupt_frame_t *frame) {
+    uint32_t addr;
+    asm volatile("mov %%cr2, %0" : "=r"(addr)); // Before anything can fault again
+    page_fault_handler_t by_addr = fault_handler_for(addr), by_code = fault_handler_for(frame->eip);
+    if ((by_addr || by_code) && (frame->eflags & EFLAGS_IF) && !irq_in_handler()) {
+        irq_enable();
+        int r = by_addr ? by_addr(addr, frame->err_code, frame) : -1;
+        if (r != 0 && by_code && by_code != by_addr) r = by_code(addr, frame->err_code, frame);
+        irq_disable();
+        if (r == 0) return 0;
+    }
+    term_writestring("\nPage fault at "); term_print_hex(addr);
+    return -1;
+}
+
+// --- Public Functions ---
+void paging_init(void) {
+    uint32_t top = ram_top();
+    pool_base = (top - FRAME_POOL_SIZE) & PAGE_MASK;
+    pool_free = POOL_FRAMES;
+    for (uint32_t i = 0; i < PD_ENTRIES; ++i) {
+        uint32_t base = i * LARGE_PAGE_SIZE, flags = PTE_PRESENT | PTE_WRITE | PDE_LARGE;
+        if (i >= USER_PDE_FIRST && i < USER_PDE_END) { page_directory[i] = 0; continue; }
+        if (base >= top) flags |= PTE_PCD | PTE_PWT; // Past RAM: device memory
+        page_directory[i] = base | flags;
+    }
+    exception_register_handler(VECTOR_PAGE_FAULT, page_fault);
+    paging_enable();
+}
+
+void paging_init_ap(void) {
+    paging_enable();
+}
+
+uint32_t memory_top(void) { return pool_base; }
+
+uint32_t frame_alloc(void) {
+    uint32_t flags = spin_lock_irqsave(&paging_lock);
+    uint32_t phys = frame_alloc_locked();
+    spin_unlock_irqrestore(&paging_lock, flags);
+    frame_reclaim_t reclaim = reclaim_handler;
+    if (!phys && reclaim && reclaim(1) > 0) {
+        flags = spin_lock_irqsave(&paging_lock);
+        phys = frame_alloc_locked();
+        spin_unlock_irqrestore(&paging_lock, flags);
+    }
+    return phys;
+}
+
+void frame_free(uint32_t phys) {
+    if (phys < pool_base || phys >= pool_base + FRAME_POOL_SIZE) return;
+    uint32_t i = (phys - pool_base) / PAGE_SIZE;
+    uint32_t flags = spin_lock_irqsave(&paging_lock);
+    if (pool_bitmap[i / 32] & (1u << (i % 32))) {
+        pool_bitmap[i / 32] &= ~(1u << (i % 32));
+        pool_free++;
+        if (i < pool_hint) pool_hint = i;
+    }
+    spin_unlock_irqrestore(&paging_lock, flags);
+}
+
+uint32_t frame_free_count(void) { return pool_free; }
+
+int page_map(uint32_t vaddr, uint32_t phys, uint32_t flags) {
+    if (!in_user_window(vaddr)) return -1;
+    vaddr &= PAGE_MASK;
+    uint32_t irq = spin_lock_irqsave(&paging_lock);
+    uint32_t *pde = &page_directory[vaddr / LARGE_PAGE_SIZE];
+    if (!(*pde & PTE_PRESENT)) {
+        uint32_t table = frame_alloc_locked();
+        if (!table) { spin_unlock_irqrestore(&paging_lock, irq); return -4; }
+        memset((void*)table, 0, PAGE_SIZE);
+        *pde = table | PTE_PRESENT | PTE_WRITE; // Page tables stay until reboot
+    }
+    uint32_t *pte = pte_of(vaddr);
+    if (*pte & PTE_PRESENT) { spin_unlock_irqrestore(&paging_lock, irq); return -2; } // Lost a race to another mapper
+    *pte = (phys & PAGE_MASK) | (flags & ~PAGE_MASK & ~PDE_LARGE) | PTE_PRESENT;
+    invlpg(vaddr);
+    spin_unlock_irqrestore(&paging_lock, irq);
+    return 0;
+}
+
+uint32_t page_lookup(uint32_t vaddr) {
+    if (!in_user_window(vaddr)) return 0;
+    uint32_t flags = spin_lock_irqsave(&paging_lock);
+    uint32_t *pte = pte_of(vaddr), phys = (pte && (*pte & PTE_PRESENT)) ? (*pte & PAGE_MASK) : 0;
+    spin_unlock_irqrestore(&paging_lock, flags);
+    return phys;
+}
+
+uint32_t page_unmap(uint32_t vaddr) {
+    if (!in_user_window(vaddr)) return 0;
+    vaddr &= PAGE_MASK;
+    uint32_t flags = spin_lock_irqsave(&paging_lock), old = 0;
+    uint32_t *pte = pte_of(vaddr);
+    if (pte && (*pte & PTE_PRESENT)) {
+        old = *pte;
+        *pte = 0;
+        invlpg(vaddr);
+        tlb_generation++;
+    }
+    spin_unlock_irqrestore(&paging_lock, flags);
+    return old;
+}
+
+void paging_tlb_sync(void) {
+    cpu_t *cpu = this_cpu();
+    uint32_t gen = tlb_generation;
+    if (cpu->tlb_generation == gen) return;
+    cpu->tlb_generation = gen;
+    uint32_t cr3;
+    asm volatile("mov %%cr3, %0; mov %0, %%cr3" : "=r"(cr3) : : "memory");
+}
+
+int paging_register_fault_range(uint32_t start, uint32_t end, page_fault_handler_t handler) {
+    int r = -1;
+    uint32_t flags = spin_lock_irqsave(&paging_lock);
+    for (int i = 0; i < PAGING_MAX_FAULT_RANGES; ++i) {
+        if (fault_ranges[i].handler) continue;
+        fault_ranges[i].start = start;
+        fault_ranges[i].end = end;
+        fault_ranges[i].handler = handler;
+        r = 0;
+        break;
+    }
+    spin_unlock_irqrestore(&paging_lock, flags);
+    return r;
+}
+
+void paging_unregister_fault_range(uint32_t start) {
+    uint32_t flags = spin_lock_irqsave(&paging_lock);
+    for (int i = 0; i < PAGING_MAX_FAULT_RANGES; ++i) {
+        if (fault_ranges[i].handler && fault_ranges[i].start == start) fault_ranges[i].handler = NULL;
+    }
+    spin_unlock_irqrestore(&paging_lock, flags);
+}
+
+void paging_set_reclaim_handler(frame_reclaim_t handler) {
+    reclaim_handler = handler;
+}
@@ -0,0 +1,95 @@
+// kernel/paging.h
+// Paging: one page directory shared by all CPUs. The kernel, its statics,
+// the RAM disk and all MMIO stay identity-mapped with 4 MiB pages (drivers
+// hand linear addresses to DMA engines), except for a user window that is
+// mapped 4 KiB at a time from a pool of physical frames, on demand.
+// Readably formatted.
+
+#ifndef PAGING_H
+#define PAGING_H
+
+#include <stdint.h>
+#include "idt.h"
+
+#define PAGE_SIZE        4096
+#define PAGE_MASK        (~(PAGE_SIZE - 1))
+#define LARGE_PAGE_SIZE  0x400000   // One page directory entry with PSE
+
+#define USER_BASE        0x40000000 // Demand-paged window [USER_BASE, USER_TOP)
+#define USER_TOP         0x80000000
+#define FRAME_POOL_SIZE  (8 * 1024 * 1024) // Frames for the window and its page tables, taken from the top of RAM
+
+// Page directory / table entry bits
+#define PTE_PRESENT  0x001
+#define PTE_WRITE    0x002
+#define PTE_PWT      0x008 // Write-through
+#define PTE_PCD      0x010 // Cache disable (MMIO)
+#define PTE_ACCESSED 0x020
+#define PTE_DIRTY    0x040
+#define PDE_LARGE    0x080 // 4 MiB page (CR4.PSE)
+#define PTE_SHARED   0x200 // Software bit: the frame belongs to the page cache, not the mapping
+
+#define PAGING_MAX_FAULT_RANGES 4
+
+#define CR0_PG  0x80000000
+#define CR0_WP  0x00010000 // Read-only pages are read-only in ring 0 too
+#define CR4_PSE 0x00000010
+#define PF_PROTECTION 0x01 // Page-fault error code: page was present (else: not present)
+
+// Resolves a fault at 'addr' (inside the handler's range, or raised by code
+// running there) by mapping a page, or redirects 'frame'. Called with
+// interrupts enabled, so it may sleep on disk I/O. Returns 0 if the frame
+// can be resumed.
+typedef int (*page_fault_handler_t)(uint32_t addr, uint32_t err, interrupt_frame_t *frame);
+
+// Gives back up to 'want' frames to the pool; returns how many it freed.
+typedef uint32_t (*frame_reclaim_t)(uint32_t want);
+
+// Builds the directory, enables PSE and paging on the BSP and hooks the
+// page-fault vector. Call before anything hands out memory (ramdisk, SMP).
+void paging_init(void);
+
+// Loads the shared directory on an application processor.
+void paging_init_ap(void);
+
+// Top of RAM for static regions such as the RAM disk: below the frame pool
+// and the user window.
+uint32_t memory_top(void);
+
+// One 4 KiB physical frame from the pool (not zeroed), or 0 if exhausted
+// even after asking the reclaim handler. Must not be called with locks the
+// reclaim handler takes.
+uint32_t frame_alloc(void);
+void frame_free(uint32_t phys);
+uint32_t frame_free_count(void);
+
+// Maps the page at 'vaddr' (user window) to frame 'phys'. PTE_PRESENT is
+// implied. Returns 0, -1 for an address outside the window, -2 (leaving
+// the old entry) if a page is mapped there already, -4 if no frame is left
+// for the page table.
+int page_map(uint32_t vaddr, uint32_t phys, uint32_t flags);
+
+// Frame mapped at 'vaddr', or 0.
+uint32_t page_lookup(uint32_t vaddr);
+
+// Removes the mapping at 'vaddr' and returns the old entry (frame | flags,
+// 0 if none was mapped); the caller decides what to do with the frame.
+// Other CPUs drop stale translations at their next context switch, see
+// paging_tlb_sync().
+uint32_t page_unmap(uint32_t vaddr);
+
+// Scheduler hook: flushes this CPU's TLB if pages were unmapped since it
+// last did. Only threads running code in the user window can hold such
+// translations, and they reach a CPU through a context switch.
+void paging_tlb_sync(void);
+
+// Routes faults in [start, end) of the user window to 'handler'; faults
+// elsewhere raised by code running inside the range go there too. Returns
+// 0, or -1 if the table is full. Faults nobody resolves are fatal.
+int paging_register_fault_range(uint32_t start, uint32_t end, page_fault_handler_t handler);
+void paging_unregister_fault_range(uint32_t start);
+
+// Installs the handler frame_alloc() calls when the pool runs dry.
+void paging_set_reclaim_handler(frame_reclaim_t handler);
+
+#endif // PAGING_H
@@ -0,0 +1,110 @@
+// kernel/pci.c
+// PCI configuration mechanism #1 and a brute-force bus scan. Readably formatted.
+
+#include "pci.h"
+#include "io.h"
+#include <stdint.h>
+
+#define PCI_CONFIG_ADDRESS 0xCF8
+#define PCI_CONFIG_DATA    0xCFC
+
+#define PCI_MSI_CTRL_ENABLE 0x0001
+#define PCI_MSI_CTRL_64BIT  0x0080
+#define PCI_MSI_CTRL_MME    0x0070 // Multiple Message Enable (we use one message)
+#define MSI_ADDRESS_BASE    0xFEE00000
+
+// --- Helpers ---
+static uint32_t pci_address(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset) {
+    return 0x80000000u | ((uint32_t)bus << 16) | ((uint32_t)slot << 11) | ((uint32_t)func << 8) | (offset & 0xFC);
+}
+
+static uint32_t pci_read_raw(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset) {
+    uint32_t flags = irq_save(); // Address/data pair must not interleave
+    outl(PCI_CONFIG_ADDRESS, pci_address(bus, slot, func, offset));
+    uint32_t v = inl(PCI_CONFIG_DATA);
+    irq_restore(flags);
+    return v;
+}
+
+// --- Public Functions ---
+uint32_t pci_read32(const pci_device_t *dev, uint8_t offset) {
+    return pci_read_raw(dev->bus, dev->slot, dev->func, offset);
+}
+
+uint16_t pci_read16(const pci_device_t *dev, uint8_t offset) {
+    return (uint16_t)(pci_read32(dev, offset) >> ((offset & 2) * 8));
+}
+
+void pci_write32(const pci_device_t *dev, uint8_t offset, uint32_t value) {
+    uint32_t flags = irq_save();
+    outl(PCI_CONFIG_ADDRESS, pci_address(dev->bus, dev->slot, dev->func, offset));
+    outl(PCI_CONFIG_DATA, value);
+    irq_restore(flags);
+}
+
+void pci_write16(const pci_device_t *dev, uint8_t offset, uint16_t value) {
+    uint32_t v = pci_read32(dev, offset);
+    uint32_t shift = (offset & 2) * 8;
+    v = (v & ~(0xFFFFu << shift)) | ((uint32_t)value << shift);
+    pci_write32(dev, offset, v);
+}
+
+int pci_find_class(uint8_t class_code, uint8_t subclass, uint8_t prog_if, pci_device_t *out) {
+    for (uint32_t bus = 0; bus < 256; ++bus) {
+        for (uint8_t slot = 0; slot < 32; ++slot) {
+            uint8_t funcs = 1;
+            for (uint8_t func = 0; func < funcs; ++func) {
+                uint32_t id = pci_read_raw((uint8_t)bus, slot, func, PCI_VENDOR_ID);
+                if ((id & 0xFFFF) == 0xFFFF) continue;
+                if (func == 0 && (pci_read_raw((uint8_t)bus, slot, 0, PCI_HEADER_TYPE & 0xFC) >> 16) & 0x80) funcs = 8; // Multi-function
+                uint32_t cls = pci_read_raw((uint8_t)bus, slot, func, PCI_CLASS_REVISION);
+                if ((cls >> 24) != class_code || ((cls >> 16) & 0xFF) != subclass || ((cls >> 8) & 0xFF) != prog_if) continue;
+
+                out->bus = (uint8_t)bus; out->slot = slot; out->func = func;
+                out->vendor_id = (uint16_t)(id & 0xFFFF);
+                out->device_id = (uint16_t)(id >> 16);
+                out->irq_line = (uint8_t)(pci_read_raw((uint8_t)bus, slot, func, PCI_INTERRUPT_LINE) & 0xFF);
+                return 0;
+            }
+        }
+    }
+    return -1;
+}
+
+uint32_t pci_bar_address(const pci_device_t *dev, int index) {
+    return pci_read32(dev, (uint8_t)(PCI_BAR0 + index * 4)) & ~0xFu;
+}
+
+void pci_enable_bus_master(const pci_device_t *dev) {
+    uint16_t cmd = pci_read16(dev, PCI_COMMAND);
+    pci_write16(dev, PCI_COMMAND, cmd | PCI_COMMAND_MEMORY | PCI_COMMAND_MASTER);
+}
+
+uint8_t pci_find_capability(const pci_device_t *dev, uint8_t cap_id) {
+    if (!(pci_read16(dev, PCI_STATUS) & PCI_STATUS_CAP_LIST)) return 0;
+    uint8_t ptr = (uint8_t)(pci_read32(dev, PCI_CAP_PTR) & 0xFC);
+    for (int guard = 0; ptr && guard < 48; ++guard) {
+        uint32_t hdr = pci_read32(dev, ptr);
+        if ((hdr & 0xFF) == cap_id) return ptr;
+        ptr = (uint8_t)((hdr >> 8) & 0xFC);
+    }
+    return 0;
+}
+
+int pci_enable_msi(const pci_device_t *dev, uint8_t vector, uint32_t apic_id) {
+    uint8_t cap = pci_find_capability(dev, PCI_CAP_ID_MSI);
+    if (!cap) return -1;
+    uint16_t ctrl = pci_read16(dev, (uint8_t)(cap + 2));
+
+    pci_write32(dev, (uint8_t)(cap + 4), MSI_ADDRESS_BASE | (apic_id << 12)); // Fixed delivery, physical destination
+    if (ctrl & PCI_MSI_CTRL_64BIT) {
+        pci_write32(dev, (uint8_t)(cap + 8), 0);
+        pci_write16(dev, (uint8_t)(cap + 12), vector); // Edge, fixed
+    } else {
+        pci_write16(dev, (uint8_t)(cap + 8), vector);
+    }
+    ctrl = (uint16_t)((ctrl & ~PCI_MSI_CTRL_MME) | PCI_MSI_CTRL_ENABLE);
+    pci_write16(dev, (uint8_t)(cap + 2), ctrl);
+    pci_write16(dev, PCI_COMMAND, pci_read16(dev, PCI_COMMAND) | PCI_COMMAND_INTX_OFF);
+    return 0;
+}
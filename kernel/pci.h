@@ -0,0 +1,56 @@
+// kernel/pci.h
+// PCI configuration space access (mechanism #1, ports 0xCF8/0xCFC), device
+// lookup by class and MSI set-up. Readably formatted.
+
+#ifndef PCI_H
+#define PCI_H
+
+#include <stdint.h>
+
+// Config space offsets
+#define PCI_VENDOR_ID      0x00
+#define PCI_DEVICE_ID      0x02
+#define PCI_COMMAND        0x04
+#define PCI_STATUS         0x06
+#define PCI_CLASS_REVISION 0x08 // Class (31:24), subclass (23:16), prog-if (15:8)
+#define PCI_HEADER_TYPE    0x0E
+#define PCI_BAR0           0x10
+#define PCI_CAP_PTR        0x34
+#define PCI_INTERRUPT_LINE 0x3C
+
+#define PCI_COMMAND_MEMORY     0x0002
+#define PCI_COMMAND_MASTER     0x0004
+#define PCI_COMMAND_INTX_OFF   0x0400
+#define PCI_STATUS_CAP_LIST    0x0010
+
+#define PCI_CAP_ID_MSI 0x05
+
+typedef struct {
+    uint8_t bus, slot, func;
+    uint16_t vendor_id, device_id;
+    uint8_t irq_line;  // Legacy (PIC) IRQ assigned by the BIOS, 0xFF if none
+} pci_device_t;
+
+uint32_t pci_read32(const pci_device_t *dev, uint8_t offset);
+uint16_t pci_read16(const pci_device_t *dev, uint8_t offset);
+void pci_write32(const pci_device_t *dev, uint8_t offset, uint32_t value);
+void pci_write16(const pci_device_t *dev, uint8_t offset, uint16_t value);
+
+// Finds the first function with the given class/subclass/prog-if.
+// Returns 0 and fills 'out', or -1 if there is none.
+int pci_find_class(uint8_t class_code, uint8_t subclass, uint8_t prog_if, pci_device_t *out);
+
+// Memory BAR 'index' (0-5) with the flag bits masked off.
+uint32_t pci_bar_address(const pci_device_t *dev, int index);
+
+// Turns on memory decoding and bus mastering (DMA).
+void pci_enable_bus_master(const pci_device_t *dev);
+
+// Config offset of capability 'cap_id', or 0 if the device lacks it.
+uint8_t pci_find_capability(const pci_device_t *dev, uint8_t cap_id);
+
+// Routes the device's single MSI message to 'vector' on the CPU with
+// 'apic_id' and disables its INTx line. Returns 0, or -1 without MSI.
+int pci_enable_msi(const pci_device_t *dev, uint8_t vector, uint32_t apic_id);
+
+#endif // PCI_H
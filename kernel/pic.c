@@ -0,0 +1,55 @@
+// kernel/pic.c
+// 8259A PIC setup, masking and EOI. Readably formatted.
+
+#include "pic.h"
+#include "io.h"
+#include <stdint.h>
+
+// --- PIC Ports ---
+#define PIC1_COMMAND 0x20
+#define PIC1_DATA    0x21
+#define PIC2_COMMAND 0xA0
+#define PIC2_DATA    0xA1
+
+// --- Commands ---
+#define PIC_EOI        0x20 // End-Of-Interrupt
+#define ICW1_INIT      0x10 // Initialization required
+#define ICW1_ICW4      0x01 // ICW4 will be sent
+#define ICW4_8086      0x01 // 8086/88 mode
+
+// --- Public Functions ---
+void pic_remap(uint8_t master_base, uint8_t slave_base) {
+    // Start the initialization sequence (cascade mode)
+    outb(PIC1_COMMAND, ICW1_INIT | ICW1_ICW4); io_wait();
+    outb(PIC2_COMMAND, ICW1_INIT | ICW1_ICW4); io_wait();
+    // ICW2: vector offsets
+    outb(PIC1_DATA, master_base); io_wait();
+    outb(PIC2_DATA, slave_base); io_wait();
+    // ICW3: slave on master IRQ2, slave cascade identity 2
+    outb(PIC1_DATA, 4); io_wait();
+    outb(PIC2_DATA, 2); io_wait();
+    // ICW4: 8086 mode
+    outb(PIC1_DATA, ICW4_8086); io_wait();
+    outb(PIC2_DATA, ICW4_8086); io_wait();
+
+    // Mask everything except the cascade line; drivers unmask their own IRQ.
+    outb(PIC1_DATA, 0xFB);
+    outb(PIC2_DATA, 0xFF);
+}
+
+void pic_unmask(uint8_t irq) {
+    uint16_t port = (irq < 8) ? PIC1_DATA : PIC2_DATA;
+    uint8_t bit = (uint8_t)(1 << (irq & 7));
+    outb(port, inb(port) & ~bit);
+}
+
+void pic_mask(uint8_t irq) {
+    uint16_t port = (irq < 8) ? PIC1_DATA : PIC2_DATA;
+    uint8_t bit = (uint8_t)(1 << (irq & 7));
+    outb(port, inb(port) | bit);
+}
+
+void pic_send_eoi(uint8_t irq) {
+    if (irq >= 8) outb(PIC2_COMMAND, PIC_EOI);
+    outb(PIC1_COMMAND, PIC_EOI);
+}
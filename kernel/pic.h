@@ -0,0 +1,16 @@
+// kernel/pic.h
+// 8259A Programmable Interrupt Controller (master/slave pair). Readably formatted.
+
+#ifndef PIC_H
+#define PIC_H
+
+#include <stdint.h>
+
+// Remaps IRQ 0-7 to 'master_base' and IRQ 8-15 to 'slave_base', all lines masked.
+void pic_remap(uint8_t master_base, uint8_t slave_base);
+void pic_unmask(uint8_t irq);
+void pic_mask(uint8_t irq);
+// Sends End-Of-Interrupt for 'irq' (to both chips for IRQ 8-15).
+void pic_send_eoi(uint8_t irq);
+
+#endif // PIC_H
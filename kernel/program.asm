@@ -0,0 +1,48 @@
+; kernel/program.asm
+; NASM syntax
+; Calls a program's entry point on its own stack (see elf.c). Only one
+; program runs at a time, so the caller's stack pointer lives in a global.
+
+bits 32
+
+section .text
+global program_call
+global program_abort
+
+; int program_call(uint32_t entry, uint32_t stack_top, const void *api, const char *args);
+; Saves the callee-saved registers, switches to stack_top and calls
+; entry(api, args). Returns the entry's return value.
+program_call:
+    push ebp
+    push ebx
+    push esi
+    push edi
+    mov [caller_esp], esp
+
+    mov eax, [esp + 20]     ; entry
+    mov ecx, [esp + 24]     ; stack_top
+    mov edx, [esp + 28]     ; api
+    mov ebx, [esp + 32]     ; args
+    mov esp, ecx
+    push ebx
+    push edx
+    call eax
+
+program_return:
+    mov esp, [caller_esp]
+    pop edi
+    pop esi
+    pop ebx
+    pop ebp
+    ret
+
+; void program_abort(void);
+; An exception handler points the faulting frame's EIP here: the program's
+; stack is abandoned and program_call returns -1 to its caller.
+program_abort:
+    mov eax, -1
+    jmp program_return
+
+section .bss
+align 4
+caller_esp: resd 1
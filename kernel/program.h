@@ -0,0 +1,28 @@
+// kernel/program.h
+// Interface between the kernel and programs started with 'exec'. A program
+// is a static ELF32 i386 executable linked inside the user window (see
+// user/user.ld). Its entry point is called as
+//     int _start(const program_api_t *api, const char *args);
+// in ring 0 with interrupts enabled, on a stack of its own; the return value
+// is the exit status. Programs include only this header; fields are only
+// ever appended, so check version >= the one a field arrived in.
+// Readably formatted.
+
+#ifndef PROGRAM_H
+#define PROGRAM_H
+
+#include <stdint.h>
+
+#define PROGRAM_API_VERSION 2
+
+typedef struct {
+    uint32_t version;                                // PROGRAM_API_VERSION
+    void (*write)(const char *data, uint32_t size);  // Console output
+    uint32_t (*ticks)(void);                         // Timer ticks since boot
+    uint32_t ticks_per_second;
+    // Version 2
+    const void *(*map)(const char *name, uint32_t *size); // Read-only view of a file in the
+    void (*unmap)(const void *addr);                      // current directory, NULL on error
+} program_api_t;
+
+#endif // PROGRAM_H
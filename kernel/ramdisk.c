@@ -0,0 +1,79 @@
+// kernel/ramdisk.c
+// RAM disk: reads and writes are memcpy, flush is a no-op. The disk takes
+// the identity-mapped memory between the kernel and the paging frame pool.
+// Readably formatted.
+
+#include "ramdisk.h"
+#include "io.h"
+#include "paging.h"
+#include "string.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define RAMDISK_ALIGN      0x100000        // Start on a 1 MiB boundary
+#define RAMDISK_LOAD_CHUNK 256             // Sectors per read while loading an image
+
+extern uint8_t end[]; // linker.ld: end of .bss
+
+// --- Module State ---
+static blkdev_t ramdisk_dev;
+static uint8_t *ramdisk_base = NULL;
+static uint32_t ramdisk_sectors = 0;
+
+// --- Backend Ops ---
+static int ramdisk_read(blkdev_t *dev, uint32_t lba, uint32_t count, void *buffer) {
+    (void)dev;
+    memcpy(buffer, ramdisk_base + lba * BLK_SECTOR_SIZE, count * BLK_SECTOR_SIZE);
+    return 0;
+}
+
+static int ramdisk_write(blkdev_t *dev, uint32_t lba, uint32_t count, const void *buffer) {
+    (void)dev;
+    memcpy(ramdisk_base + lba * BLK_SECTOR_SIZE, buffer, count * BLK_SECTOR_SIZE);
+    return 0;
+}
+
+static int ramdisk_flush(blkdev_t *dev) { (void)dev; return 0; }
+
+static int ramdisk_geometry(blkdev_t *dev, blkdev_geometry_t *out) {
+    (void)dev;
+    out->sector_size = BLK_SECTOR_SIZE;
+    out->sector_count = ramdisk_sectors;
+    return 0;
+}
+
+static const blkdev_ops_t ramdisk_ops = { ramdisk_read, ramdisk_write, ramdisk_flush, ramdisk_geometry };
+
+// --- Public Functions ---
+blkdev_t *ramdisk_create(uint32_t sectors) {
+    if (ramdisk_base || sectors == 0) return NULL;
+    uint32_t base = ((uint32_t)end + RAMDISK_ALIGN - 1) & ~(RAMDISK_ALIGN - 1);
+    uint32_t bytes = sectors * BLK_SECTOR_SIZE;
+    if (base + bytes < base || base + bytes > memory_top()) {
+        term_writestring("ramdisk: not enough memory for "); term_print_dec(bytes / 1024); term_writestring(" KiB\n");
+        return NULL;
+    }
+    ramdisk_base = (uint8_t*)base;
+    ramdisk_sectors = sectors;
+
+    memset(&ramdisk_dev, 0, sizeof(ramdisk_dev));
+    strncpy(ramdisk_dev.name, "ram0", BLKDEV_NAME_LEN - 1);
+    ramdisk_dev.ops = &ramdisk_ops;
+    if (blkdev_register(&ramdisk_dev) != 0) {
+        ramdisk_base = NULL;
+        ramdisk_sectors = 0;
+        return NULL;
+    }
+    return &ramdisk_dev;
+}
+
+int ramdisk_load(blkdev_t *rd, blkdev_t *src, uint32_t src_lba) {
+    if (rd != &ramdisk_dev || !src) return -1;
+    for (uint32_t lba = 0; lba < ramdisk_sectors; lba += RAMDISK_LOAD_CHUNK) {
+        uint32_t n = ramdisk_sectors - lba;
+        if (n > RAMDISK_LOAD_CHUNK) n = RAMDISK_LOAD_CHUNK;
+        int r = blkdev_read(src, src_lba + lba, n, ramdisk_base + lba * BLK_SECTOR_SIZE); // Straight into place
+        if (r != 0) return r;
+    }
+    return 0;
+}
@@ -0,0 +1,20 @@
+// kernel/ramdisk.h
+// RAM-disk block device backed by a fixed region of physical memory above
+// the kernel image. Readably formatted.
+
+#ifndef RAMDISK_H
+#define RAMDISK_H
+
+#include <stdint.h>
+#include "blkdev.h"
+
+// Creates and registers "ram0" with room for 'sectors' sectors, placed at the
+// first 1 MiB boundary after the kernel's .bss. Fails (NULL) if a RAM disk
+// already exists or there is too little memory below the paging frame pool.
+blkdev_t *ramdisk_create(uint32_t sectors);
+
+// Fills the RAM disk from 'src', starting at 'src_lba', in large chunks.
+// Returns 0 or the first read error.
+int ramdisk_load(blkdev_t *rd, blkdev_t *src, uint32_t src_lba);
+
+#endif // RAMDISK_H
@@ -0,0 +1,115 @@
+// kernel/smp.c
+// Multiprocessor bring-up. APs are started one at a time: each gets its index
+// and stack through the trampoline, joins the GDT/IDT, sets up its per-CPU data
+// and LAPIC timer, and becomes an idle thread that steals work. Readably formatted.
+
+#include "smp.h"
+#include "acpi.h"
+#include "apic.h"
+#include "gdt.h"
+#include "idt.h"
+#include "thread.h"
+#include "timer.h"
+#include "paging.h"
+#include "io.h"
+#include "string.h"
+#include <stdint.h>
+
+#define AP_TRAMPOLINE_ADDR 0x8000 // Must match TRAMP_BASE in trampoline.asm
+#define AP_START_TIMEOUT_MS 100
+
+extern uint8_t ap_trampoline_start[], ap_trampoline_end[]; // trampoline.asm
+extern uint8_t ap_trampoline_stack[], ap_trampoline_entry[];
+
+// --- Module State ---
+static uint8_t ap_stacks[MAX_CPUS - 1][THREAD_STACK_SIZE] __attribute__((aligned(16)));
+static acpi_madt_info_t madt;
+static int apic_active = 0;
+static volatile uint32_t ap_boot_index = 0; // CPU index the AP being started takes
+static volatile int ap_ready = 0;           // Set by the AP once it can run threads
+
+// --- Local APIC Vectors ---
+static void lapic_timer_irq(interrupt_frame_t *frame) { (void)frame; thread_cpu_tick(); }
+static void resched_ipi(interrupt_frame_t *frame) { (void)frame; thread_resched_ipi(); }
+
+// --- AP Side ---
+static void ap_main(void) {
+    uint32_t index = ap_boot_index;
+    gdt_load();
+    idt_load();
+    paging_init_ap();
+    cpu_setup(index, lapic_id());
+    lapic_enable();
+    thread_init_ap(ap_stacks[index - 1]);
+    lapic_timer_start();
+    ap_ready = 1;
+    for (;;) asm volatile("sti; hlt"); // This context is now the AP's idle thread
+}
+
+// Waits up to 'ms' for the AP being started to report in.
+static int ap_wait_ready(uint32_t ms) {
+    uint32_t start = timer_ticks(), limit = timer_ms_to_ticks(ms);
+    while (!ap_ready) {
+        if (timer_ticks() - start >= limit) return 0;
+        thread_yield();
+    }
+    return 1;
+}
+
+static int start_ap(uint32_t index, uint8_t apic_id) {
+    uint8_t *tramp = (uint8_t*)AP_TRAMPOLINE_ADDR;
+    *(uint32_t*)(tramp + (ap_trampoline_stack - ap_trampoline_start)) = (uint32_t)(ap_stacks[index - 1] + THREAD_STACK_SIZE);
+    ap_boot_index = index;
+    ap_ready = 0;
+
+    // INIT, 10 ms, then STARTUP (twice if the first one is not picked up).
+    lapic_send_init(apic_id);
+    thread_sleep_ms(10);
+    lapic_send_startup(apic_id, AP_TRAMPOLINE_ADDR >> 12);
+    if (ap_wait_ready(10)) return 0;
+    lapic_send_startup(apic_id, AP_TRAMPOLINE_ADDR >> 12);
+    return ap_wait_ready(AP_START_TIMEOUT_MS) ? 0 : -1;
+}
+
+// --- Public Functions ---
+void smp_init(void) {
+    if (acpi_parse_madt(&madt) != 0 || madt.ioapic_address == 0) {
+        term_writestring("SMP: no usable MADT, staying uniprocessor on the PIC\n");
+        return;
+    }
+
+    lapic_set_base(madt.lapic_address);
+    lapic_enable();
+    cpu_t *bsp = this_cpu();
+    bsp->apic_id = lapic_id();
+
+    ioapic_init(&madt, (uint8_t)bsp->apic_id); // Device IRQs all go to the BSP
+    irq_switch_to_apic();
+    local_vector_register_handler(VECTOR_LAPIC_TIMER, lapic_timer_irq);
+    local_vector_register_handler(VECTOR_RESCHED_IPI, resched_ipi);
+    apic_active = 1;
+
+    lapic_timer_calibrate();
+    lapic_timer_start(); // From here the BSP quantum comes from its LAPIC timer
+
+    memcpy((void*)AP_TRAMPOLINE_ADDR, ap_trampoline_start, (size_t)(ap_trampoline_end - ap_trampoline_start));
+    *(uint32_t*)((uint8_t*)AP_TRAMPOLINE_ADDR + (ap_trampoline_entry - ap_trampoline_start)) = (uint32_t)ap_main;
+
+    uint32_t index = 1;
+    for (uint32_t i = 0; i < madt.cpu_count && index < MAX_CPUS; ++i) {
+        if (madt.cpu_apic_ids[i] == bsp->apic_id) continue;
+        if (start_ap(index, madt.cpu_apic_ids[i]) == 0) {
+            index++;
+        } else {
+            term_writestring("SMP: CPU with APIC ID "); term_print_dec(madt.cpu_apic_ids[i]);
+            term_writestring(" did not start\n");
+        }
+    }
+    term_writestring("SMP: "); term_print_dec(cpu_online_count()); term_writestring(" CPU(s) online\n");
+}
+
+int smp_active(void) { return apic_active; }
+
+void smp_kick_cpu(cpu_t *c) {
+    if (apic_active && c->online) lapic_send_ipi(c->apic_id, VECTOR_RESCHED_IPI);
+}
@@ -0,0 +1,23 @@
+// kernel/smp.h
+// Multiprocessor bring-up: MADT discovery, APIC interrupt routing and
+// INIT-SIPI-SIPI start-up of the application processors. Readably formatted.
+
+#ifndef SMP_H
+#define SMP_H
+
+#include <stdint.h>
+#include "cpu.h"
+
+// Switches the BSP to APIC interrupt delivery, starts its LAPIC timer and
+// boots every enabled AP listed in the MADT. Call from the boot thread
+// with interrupts enabled. Without a usable MADT the system stays
+// uniprocessor on the 8259 PIC and the PIT-driven quantum.
+void smp_init(void);
+
+// Non-zero once the local APICs are in use (IPIs can be sent).
+int smp_active(void);
+
+// Sends a reschedule IPI so an idle CPU notices newly queued work.
+void smp_kick_cpu(cpu_t *c);
+
+#endif // SMP_H
@@ -0,0 +1,47 @@
+// kernel/spinlock.h
+// Test-and-test-and-set spinlocks for SMP. Every acquire disables interrupts
+// on the local CPU, so a lock can be shared between threads and IRQ handlers.
+// Readably formatted.
+
+#ifndef SPINLOCK_H
+#define SPINLOCK_H
+
+#include <stdint.h>
+#include "io.h"
+
+typedef struct {
+    volatile uint32_t locked;
+} spinlock_t;
+
+#define SPINLOCK_INIT { 0 }
+
+static inline void spin_init(spinlock_t *lock) { lock->locked = 0; }
+
+// Raw acquire/release: the caller must already have interrupts disabled.
+static inline void spin_lock(spinlock_t *lock) {
+    for (;;) {
+        uint32_t old = 1;
+        asm volatile ("xchgl %0, %1" : "+r"(old), "+m"(lock->locked) : : "memory");
+        if (old == 0) return;
+        while (lock->locked) asm volatile ("pause" : : : "memory");
+    }
+}
+
+static inline void spin_unlock(spinlock_t *lock) {
+    asm volatile ("" : : : "memory"); // x86 stores are not reordered with earlier stores
+    lock->locked = 0;
+}
+
+// Disables interrupts, acquires, and returns the previous EFLAGS for spin_unlock_irqrestore().
+static inline uint32_t spin_lock_irqsave(spinlock_t *lock) {
+    uint32_t flags = irq_save();
+    spin_lock(lock);
+    return flags;
+}
+
+static inline void spin_unlock_irqrestore(spinlock_t *lock, uint32_t flags) {
+    spin_unlock(lock);
+    irq_restore(flags);
+}
+
+#endif // SPINLOCK_H
@@ -7,11 +7,26 @@ bits 32          ; We are now in 32-bit Protected Mode
 section .text
 global _start    ; Export _start symbol for the linker (entry point)
 extern kernel_main ; Declare external C function
+extern bss_start   ; Provided by linker.ld
+extern bss_end
 
 _start:
     ; The bootloader already set up GDT, segments (DS, ES, FS, GS, SS)
-    ; and a basic stack pointer (ESP).
-    ; We can now directly call our C kernel main function.
+    ; and a basic stack pointer (ESP at 0x90000).
+
+    ; Clear .bss: the bootloader only copies the file image, so statics
+    ; (scheduler state, thread table, ...) would otherwise start as garbage.
+    cld
+    mov edi, bss_start
+    mov ecx, bss_end
+    sub ecx, edi
+    xor eax, eax
+    rep stosb
+
+    ; Switch to our own stack. It becomes the stack of the boot thread
+    ; (thread 0) once the scheduler is initialized.
+    mov esp, stack_top
+    xor ebp, ebp
 
     call kernel_main
 
@@ -22,17 +37,10 @@ _start:
     jmp .hang ; Loop indefinitely
 
 
-; We still need a .bss section for the C stack, even though ESP was initially set by bootloader
 section .bss
 align 16
+global stack_bottom
 stack_bottom:
-resb 16384 ; 16 KiB stack
+resb 16384 ; 16 KiB boot stack
+global stack_top
 stack_top:
-
-; Note: Although ESP is set by the bootloader initially (e.g., to 0x90000),
-; the C environment typically expects the stack to be within its BSS.
-; A more robust kernel entry would explicitly set ESP to 'stack_top' here.
-; However, for simplicity, we rely on the bootloader's ESP setting being usable
-; and the C code using the stack space defined here indirectly.
-; For a production system, you'd set ESP = stack_top here.
-; Example: mov esp, stack_top
\ No newline at end of file
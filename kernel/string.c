@@ -89,6 +89,35 @@ char* strtok(char *str, const char *delim) {
 }
 
 
+// --- Memory Functions ---
+// GCC may emit calls to these even in freestanding mode (struct copies, zeroing loops).
+
+void* memcpy(void* dest, const void* src, size_t n) {
+    char* dp = (char*)dest; const char* sp = (const char*)src;
+    for (size_t i = 0; i < n; i++) dp[i] = sp[i];
+    return dest;
+}
+
+void* memmove(void* dest, const void* src, size_t n) {
+    char* dp = (char*)dest; const char* sp = (const char*)src;
+    if (dp < sp) { for (size_t i = 0; i < n; i++) dp[i] = sp[i]; }
+    else { for (size_t i = n; i > 0; i--) dp[i - 1] = sp[i - 1]; }
+    return dest;
+}
+
+void* memset(void* dest, int value, size_t n) {
+    unsigned char* dp = (unsigned char*)dest;
+    for (size_t i = 0; i < n; i++) dp[i] = (unsigned char)value;
+    return dest;
+}
+
+int memcmp(const void* a, const void* b, size_t n) {
+    const unsigned char* pa = (const unsigned char*)a; const unsigned char* pb = (const unsigned char*)b;
+    for (size_t i = 0; i < n; i++) { if (pa[i] != pb[i]) return pa[i] - pb[i]; }
+    return 0;
+}
+
+
 // --- NEW: Number Conversion Implementations ---
 
 // Helper function to reverse a string in place
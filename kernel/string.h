@@ -13,6 +13,12 @@ char* strcpy(char* dest, const char* src);
 char* strncpy(char* dest, const char* src, size_t n);
 char* strtok(char *str, const char *delim);
 
+// --- Memory Functions ---
+void* memcpy(void* dest, const void* src, size_t n);
+void* memmove(void* dest, const void* src, size_t n);
+void* memset(void* dest, int value, size_t n);
+int memcmp(const void* a, const void* b, size_t n);
+
 // --- NEW: Number to String Conversion Prototypes ---
 char* itoa(int value, char* buffer, int base); // Signed version
 char* uitoa(unsigned int value, char* buffer, int base); // Unsigned version
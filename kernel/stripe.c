@@ -0,0 +1,156 @@
+// kernel/stripe.c
+// Striped volume on top of other block devices. A transfer is cut at stripe
+// boundaries and every piece is submitted straight to its member's request
+// queue, without waiting in between: each member's dispatch thread then
+// works on its share in parallel, and pieces that land next to each other
+// on one member are merged back into a single transfer by its elevator.
+// Readably formatted.
+
+#include "stripe.h"
+#include "blkq.h"
+#include "thread.h"
+#include "io.h"
+#include "string.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// --- Module State ---
+typedef struct {
+    blkdev_t dev;
+    blkdev_t *members[STRIPE_MAX_MEMBERS];
+    int count;
+    uint32_t stripe_sectors;
+    uint32_t stripe_shift;      // log2(stripe_sectors)
+    uint32_t member_sectors;    // Usable sectors per member (whole stripes)
+} stripe_volume_t;
+
+static stripe_volume_t volume;
+static int volume_created = 0;
+
+typedef struct {
+    wait_queue_t wait;          // Its lock also guards 'pending' and 'status'
+    uint32_t pending;
+    int status;
+} stripe_waiter_t;
+
+// --- Helpers ---
+static void stripe_done(blk_request_t *rq, int status) {
+    stripe_waiter_t *w = (stripe_waiter_t*)rq->private_data;
+    uint32_t flags = wait_queue_lock(&w->wait);
+    if (status < 0 && w->status == 0) w->status = status;
+    if (--w->pending == 0) wait_queue_wake_all_locked(&w->wait);
+    wait_queue_unlock(&w->wait, flags);
+}
+
+// Splits [lba, lba+count) into per-stripe pieces and submits them to the
+// members in batches of STRIPE_BATCH, sleeping only once per batch.
+static int stripe_transfer(stripe_volume_t *v, int op, uint32_t lba, uint32_t count, uint8_t *buf) {
+    blk_request_t rqs[STRIPE_BATCH];
+    stripe_waiter_t w = { WAIT_QUEUE_INIT, 0, 0 };
+    uint32_t mask = v->stripe_sectors - 1;
+
+    while (count > 0 && w.status == 0) {
+        uint32_t n = 0;
+        blk_queue_t *queues[STRIPE_BATCH];
+        for (; n < STRIPE_BATCH && count > 0; ++n) {
+            uint32_t stripe = lba >> v->stripe_shift;
+            uint32_t offset = lba & mask;
+            int m = (int)(stripe % (uint32_t)v->count);
+            blk_queue_t *q = v->members[m]->queue;
+            uint32_t chunk = v->stripe_sectors - offset;
+            if (chunk > count) chunk = count;
+            if (chunk > q->max_sectors) chunk = q->max_sectors;
+
+            memset(&rqs[n], 0, sizeof(rqs[n]));
+            rqs[n].lba = ((stripe / (uint32_t)v->count) << v->stripe_shift) + offset;
+            rqs[n].count = chunk; rqs[n].buffer = buf; rqs[n].op = op;
+            rqs[n].done = stripe_done; rqs[n].private_data = &w;
+            queues[n] = q;
+            lba += chunk; count -= chunk; buf += chunk * BLK_SECTOR_SIZE;
+        }
+
+        w.pending = n; // Set before submitting: completions may start right away
+        for (uint32_t i = 0; i < n; ++i) {
+            if (blk_submit(queues[i], &rqs[i]) != 0) {
+                uint32_t flags = wait_queue_lock(&w.wait);
+                if (w.status == 0) w.status = -1;
+                w.pending--;
+                wait_queue_unlock(&w.wait, flags);
+            }
+        }
+
+        uint32_t flags = wait_queue_lock(&w.wait);
+        while (w.pending > 0) wait_queue_sleep(&w.wait);
+        wait_queue_unlock(&w.wait, flags);
+    }
+    return w.status;
+}
+
+// --- Backend Ops ---
+static int stripe_read(blkdev_t *dev, uint32_t lba, uint32_t count, void *buffer) {
+    return stripe_transfer((stripe_volume_t*)dev->driver_data, BLK_READ, lba, count, (uint8_t*)buffer);
+}
+
+static int stripe_write(blkdev_t *dev, uint32_t lba, uint32_t count, const void *buffer) {
+    return stripe_transfer((stripe_volume_t*)dev->driver_data, BLK_WRITE, lba, count, (uint8_t*)buffer);
+}
+
+static int stripe_flush(blkdev_t *dev) {
+    stripe_volume_t *v = (stripe_volume_t*)dev->driver_data;
+    int status = 0;
+    for (int i = 0; i < v->count; ++i) {
+        int r = blkdev_flush(v->members[i]);
+        if (r < 0 && status == 0) status = r;
+    }
+    return status;
+}
+
+static int stripe_geometry(blkdev_t *dev, blkdev_geometry_t *out) {
+    stripe_volume_t *v = (stripe_volume_t*)dev->driver_data;
+    out->sector_size = BLK_SECTOR_SIZE;
+    out->sector_count = v->member_sectors * (uint32_t)v->count;
+    return 0;
+}
+
+static const blkdev_ops_t stripe_ops = { stripe_read, stripe_write, stripe_flush, stripe_geometry };
+
+// --- Public API ---
+int stripe_is_volume(const blkdev_t *dev) {
+    return volume_created && dev == &volume.dev;
+}
+
+int stripe_is_member(const blkdev_t *dev) {
+    if (!volume_created || !dev) return 0;
+    for (int i = 0; i < volume.count; ++i) if (volume.members[i] == dev) return 1;
+    return 0;
+}
+
+blkdev_t *stripe_create(const char *name, blkdev_t **members, int count, uint32_t stripe_sectors) {
+    if (volume_created || !name || !name[0] || !members) return NULL;
+    if (count < 2 || count > STRIPE_MAX_MEMBERS) return NULL;
+    if (stripe_sectors == 0 || (stripe_sectors & (stripe_sectors - 1))) return NULL;
+
+    stripe_volume_t *v = &volume;
+    memset(v, 0, sizeof(*v));
+    v->count = count;
+    v->stripe_sectors = stripe_sectors;
+    while ((1u << v->stripe_shift) < stripe_sectors) v->stripe_shift++;
+    v->member_sectors = 0xFFFFFFFFu;
+    for (int i = 0; i < count; ++i) {
+        blkdev_t *m = members[i];
+        if (!m || !m->queue) return NULL; // Pieces go straight to the member queues
+        for (int j = 0; j < i; ++j) if (members[j] == m) return NULL;
+        v->members[i] = m;
+        if (m->geometry.sector_count < v->member_sectors) v->member_sectors = m->geometry.sector_count;
+    }
+    v->member_sectors &= ~(stripe_sectors - 1);
+    if (v->member_sectors == 0) return NULL;
+
+    strncpy(v->dev.name, name, BLKDEV_NAME_LEN - 1);
+    v->dev.ops = &stripe_ops;
+    v->dev.driver_data = v;
+    v->dev.queue = NULL; // No queue of its own; iostat shows the members
+    if (blkdev_register(&v->dev) != 0) return NULL;
+    volume_created = 1;
+    return &v->dev;
+}
@@ -0,0 +1,27 @@
+// kernel/stripe.h
+// Striped (RAID-0) volume: consecutive stripes rotate across member devices,
+// so a large transfer keeps every member busy at once. Readably formatted.
+
+#ifndef STRIPE_H
+#define STRIPE_H
+
+#include <stdint.h>
+#include "blkdev.h"
+
+#define STRIPE_MAX_MEMBERS 4
+#define STRIPE_BATCH       16   // Member requests in flight per call
+
+// Builds and registers a striped volume called 'name' over 'members'
+// (2..STRIPE_MAX_MEMBERS devices with request queues, e.g. hd1 and hd2 on
+// different IDE channels). 'stripe_sectors' must be a power of two.
+// Capacity is the smallest member rounded down to whole stripes, times the
+// member count. Returns the device, or NULL on bad arguments or if a
+// volume already exists.
+blkdev_t *stripe_create(const char *name, blkdev_t **members, int count, uint32_t stripe_sectors);
+
+// Nonzero if 'dev' is the striped volume itself.
+int stripe_is_volume(const blkdev_t *dev);
+// Nonzero if 'dev' is a member of the striped volume.
+int stripe_is_member(const blkdev_t *dev);
+
+#endif // STRIPE_H
@@ -0,0 +1,31 @@
+; kernel/switch.asm
+; NASM syntax
+; Kernel thread context switch.
+
+bits 32
+
+section .text
+global switch_context
+
+; void switch_context(uint32_t *old_esp, uint32_t new_esp);
+; Saves the callee-saved registers on the current stack, stores ESP in
+; *old_esp, then loads new_esp and restores the next thread's registers.
+; The 'ret' resumes wherever the next thread called switch_context from
+; (or thread_bootstrap for a thread that has never run, see thread.c).
+switch_context:
+    mov eax, [esp + 4]      ; old_esp
+    mov edx, [esp + 8]      ; new_esp
+
+    push ebp
+    push ebx
+    push esi
+    push edi
+
+    mov [eax], esp
+    mov esp, edx
+
+    pop edi
+    pop esi
+    pop ebx
+    pop ebp
+    ret
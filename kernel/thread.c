@@ -0,0 +1,481 @@
+// kernel/thread.c
+// Kernel threads with a preemptive round-robin scheduler. Every CPU has its own
+// run queue (cpu_t in cpu.h); a CPU that runs dry steals from the busiest one.
+//
+// Locking (always with interrupts off), outer to inner:
+//   wait_queue_t.lock -> thread_t.lock -> cpu_t.rq_lock
+// threads_lock only guards slot allocation. A thread may sit on a run queue
+// while its old CPU is still switching away from its stack; 'on_cpu' stays set
+// until that switch completes, and nobody else runs it before then.
+// Readably formatted.
+
+#include "thread.h"
+#include "idt.h"
+#include "timer.h"
+#include "paging.h"
+#include "smp.h"
+#include "io.h"
+#include "string.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define STACK_CANARY 0xDEADC0DE
+
+// --- Module State ---
+static thread_t threads[MAX_THREADS];
+static uint8_t thread_stacks[MAX_THREADS][THREAD_STACK_SIZE] __attribute__((aligned(16)));
+static spinlock_t threads_lock = SPINLOCK_INIT;
+static uint32_t next_thread_id = 0;
+
+extern void switch_context(uint32_t *old_esp, uint32_t new_esp); // switch.asm
+extern uint8_t stack_bottom[];                                    // start.asm boot stack
+
+static inline thread_t *cur(void) { return this_cpu()->current; }
+static inline int is_idle(const thread_t *t) { return cpus[t->cpu].idle == t; }
+
+// --- Run Queue Helpers ---
+// Appends 't' to its CPU's run queue and makes sure that CPU notices.
+// Caller holds t->lock.
+static void make_ready(thread_t *t) {
+    t->state = THREAD_READY;
+    if (is_idle(t)) return; // Idle threads are picked only when a queue is empty
+
+    cpu_t *c = &cpus[t->cpu];
+    spin_lock(&c->rq_lock);
+    t->next = NULL;
+    if (c->rq_tail) c->rq_tail->next = t; else c->rq_head = t;
+    c->rq_tail = t;
+    c->nr_ready++;
+    spin_unlock(&c->rq_lock);
+
+    if (c == this_cpu()) {
+        if (c->current == c->idle) c->need_resched = 1; // Don't let a woken thread wait for idle's quantum
+    } else if (c->current == c->idle) {
+        smp_kick_cpu(c); // Wake it from hlt
+    }
+}
+
+static thread_t *rq_pop(cpu_t *c) {
+    spin_lock(&c->rq_lock);
+    thread_t *t = c->rq_head;
+    if (t) {
+        c->rq_head = t->next;
+        if (!c->rq_head) c->rq_tail = NULL;
+        t->next = NULL;
+        c->nr_ready--;
+    }
+    spin_unlock(&c->rq_lock);
+    return t;
+}
+
+// Takes one READY thread from the CPU with the longest run queue. Threads
+// whose stack is still in use elsewhere are skipped.
+static thread_t *steal_work(cpu_t *self) {
+    cpu_t *victim = NULL;
+    for (uint32_t i = 0; i < MAX_CPUS; ++i) {
+        cpu_t *c = &cpus[i];
+        if (c == self || !c->online || c->nr_ready == 0) continue;
+        if (!victim || c->nr_ready > victim->nr_ready) victim = c;
+    }
+    if (!victim) return NULL;
+
+    spin_lock(&victim->rq_lock);
+    thread_t *prev = NULL, *t = victim->rq_head;
+    while (t && t->on_cpu) { prev = t; t = t->next; }
+    if (t) {
+        if (prev) prev->next = t->next; else victim->rq_head = t->next;
+        if (victim->rq_tail == t) victim->rq_tail = prev;
+        t->next = NULL;
+        victim->nr_ready--;
+        t->cpu = self->index; // Migrates: it will be re-queued here from now on
+        self->steals++;
+    }
+    spin_unlock(&victim->rq_lock);
+    return t;
+}
+
+static int work_elsewhere(const cpu_t *self) {
+    for (uint32_t i = 0; i < MAX_CPUS; ++i) {
+        if (&cpus[i] != self && cpus[i].online && cpus[i].nr_ready > 0) return 1;
+    }
+    return 0;
+}
+
+// --- Core Scheduler (interrupts disabled, no locks held) ---
+// Runs on the new thread right after switch_context(): the previous thread's
+// stack is no longer in use, so other CPUs may pick it up now.
+static void finish_switch(void) {
+    cpu_t *cpu = this_cpu();
+    if (cpu->switched_from) {
+        cpu->switched_from->on_cpu = 0;
+        cpu->switched_from = NULL;
+    }
+    paging_tlb_sync();
+}
+
+static void schedule(void) {
+    cpu_t *cpu = this_cpu();
+    thread_t *prev = cpu->current;
+
+    if (*(uint32_t*)prev->stack_base != STACK_CANARY) {
+        term_writestring("PANIC: stack overflow in thread '"); term_writestring(prev->name); term_writestring("'\n");
+        asm volatile("cli; hlt");
+    }
+
+    spin_lock(&prev->lock);
+    if (prev->state == THREAD_RUNNING) make_ready(prev); // Preempted or yielding: back of the line
+    spin_unlock(&prev->lock);
+
+    thread_t *next = rq_pop(cpu);
+    if (!next) next = steal_work(cpu);
+    if (!next) next = cpu->idle;
+
+    next->state = THREAD_RUNNING;
+    next->cpu = cpu->index;
+    next->slice_left = THREAD_TIMESLICE_TICKS;
+    cpu->need_resched = 0;
+    if (next == prev) return;
+
+    while (next->on_cpu) asm volatile("pause" ::: "memory"); // Still switching out elsewhere
+    next->on_cpu = 1;
+    cpu->current = next;
+    cpu->switched_from = prev;
+    cpu->switches++;
+    switch_context(&prev->esp, next->esp);
+    // Back on 'prev', possibly on another CPU: re-read this_cpu().
+    finish_switch();
+}
+
+// First code a new thread runs: switch_context() 'ret's here with IRQs off.
+static void thread_bootstrap(void) {
+    finish_switch();
+    irq_enable();
+    thread_t *t = cur();
+    t->entry(t->arg);
+    thread_exit();
+}
+
+// Caller holds threads_lock.
+static thread_t *alloc_slot(void) {
+    for (int i = 0; i < MAX_THREADS; ++i) {
+        thread_t *t = &threads[i];
+        if (t->on_cpu) continue; // An exiting thread may still be on its stack
+        if (t->state == THREAD_UNUSED || (t->state == THREAD_ZOMBIE && t->detached)) return t;
+    }
+    return NULL;
+}
+
+static void thread_setup(thread_t *t, const char *name, uint8_t *stack_base) {
+    memset(t, 0, sizeof(*t));
+    t->id = next_thread_id++;
+    strncpy(t->name, name, THREAD_NAME_LEN - 1);
+    t->name[THREAD_NAME_LEN - 1] = '\0';
+    t->stack_base = stack_base;
+    *(uint32_t*)stack_base = STACK_CANARY;
+}
+
+// Least loaded online CPU (queued + running non-idle), preferring the caller's.
+static uint32_t pick_cpu(void) {
+    cpu_t *self = this_cpu(), *best = self;
+    uint32_t best_load = self->nr_ready + (self->current != self->idle);
+    for (uint32_t i = 0; i < MAX_CPUS; ++i) {
+        cpu_t *c = &cpus[i];
+        if (!c->online || !c->idle) continue;
+        uint32_t load = c->nr_ready + (c->current != c->idle);
+        if (load < best_load) { best = c; best_load = load; }
+    }
+    return best->index;
+}
+
+// Claims a slot and builds the initial stack frame; the thread is not queued yet.
+static thread_t *thread_spawn(const char *name, void (*entry)(void *arg), void *arg) {
+    uint32_t flags = spin_lock_irqsave(&threads_lock);
+    thread_t *t = alloc_slot();
+    if (!t) { spin_unlock_irqrestore(&threads_lock, flags); return NULL; }
+
+    int slot = (int)(t - threads);
+    thread_setup(t, name, thread_stacks[slot]);
+    t->state = THREAD_READY; // Reserve the slot before dropping the lock
+    t->entry = entry;
+    t->arg = arg;
+    spin_unlock_irqrestore(&threads_lock, flags);
+
+    // Initial frame consumed by switch_context: edi, esi, ebx, ebp, return address.
+    uint32_t *sp = (uint32_t*)(thread_stacks[slot] + THREAD_STACK_SIZE);
+    *--sp = 0;                          // Fake return address for thread_bootstrap
+    *--sp = (uint32_t)thread_bootstrap; // switch_context 'ret' target
+    *--sp = 0;                          // ebp
+    *--sp = 0;                          // ebx
+    *--sp = 0;                          // esi
+    *--sp = 0;                          // edi
+    t->esp = (uint32_t)sp;
+    return t;
+}
+
+static void idle_main(void *arg) {
+    (void)arg;
+    for (;;) asm volatile("sti; hlt");
+}
+
+// --- Public Functions ---
+void thread_init(void) {
+    cpu_t *cpu = this_cpu();
+
+    // Slot 0 adopts the boot stack from start.asm; its pool stack stays unused.
+    thread_t *boot = &threads[0];
+    thread_setup(boot, "main", stack_bottom);
+    boot->state = THREAD_RUNNING;
+    boot->on_cpu = 1;
+    boot->cpu = cpu->index;
+    boot->slice_left = THREAD_TIMESLICE_TICKS;
+    cpu->current = boot;
+
+    // Idle is never queued; schedule() picks it only when there is no other work.
+    thread_t *idle = thread_spawn("idle0", idle_main, NULL);
+    if (!idle) {
+        term_writestring("PANIC: cannot create idle thread\n");
+        asm volatile("cli; hlt");
+    }
+    idle->detached = 1;
+    idle->cpu = cpu->index;
+    cpu->idle = idle;
+}
+
+void thread_init_ap(uint8_t *stack_base) {
+    cpu_t *cpu = this_cpu();
+    uint32_t flags = spin_lock_irqsave(&threads_lock);
+    thread_t *t = alloc_slot();
+    if (!t) {
+        spin_unlock_irqrestore(&threads_lock, flags);
+        term_writestring("PANIC: no thread slot for AP idle\n");
+        asm volatile("cli; hlt");
+    }
+    thread_setup(t, "idle", stack_base);
+    t->name[4] = (char)('0' + cpu->index); t->name[5] = '\0';
+    t->state = THREAD_RUNNING;
+    t->on_cpu = 1;
+    t->cpu = cpu->index;
+    t->detached = 1;
+    cpu->idle = t;
+    cpu->current = t;
+    spin_unlock_irqrestore(&threads_lock, flags);
+}
+
+thread_t *thread_create(const char *name, void (*entry)(void *arg), void *arg) {
+    thread_t *t = thread_spawn(name, entry, arg);
+    if (!t) return NULL;
+    uint32_t flags = spin_lock_irqsave(&t->lock);
+    t->cpu = pick_cpu();
+    make_ready(t);
+    spin_unlock_irqrestore(&t->lock, flags);
+    return t;
+}
+
+void thread_detach(thread_t *t) {
+    uint32_t flags = spin_lock_irqsave(&threads_lock);
+    if (!t->joined) t->detached = 1;
+    spin_unlock_irqrestore(&threads_lock, flags);
+}
+
+int thread_join(thread_t *t) {
+    if (!t || t == cur()) return -1;
+    // Claim the slot where detach and recycling look: a claimed thread stays
+    // a zombie until we free it, and nobody else can join or detach it
+    uint32_t flags = spin_lock_irqsave(&threads_lock);
+    int ok = !t->detached && !t->joined && t->state != THREAD_UNUSED;
+    if (ok) t->joined = 1;
+    spin_unlock_irqrestore(&threads_lock, flags);
+    if (!ok) return -1;
+
+    flags = wait_queue_lock(&t->exit_waiters);
+    while (t->state != THREAD_ZOMBIE) wait_queue_sleep(&t->exit_waiters);
+    wait_queue_unlock(&t->exit_waiters, flags);
+
+    flags = spin_lock_irqsave(&threads_lock);
+    t->state = THREAD_UNUSED; // alloc_slot() still waits for on_cpu to clear
+    spin_unlock_irqrestore(&threads_lock, flags);
+    return 0;
+}
+
+void thread_exit(void) {
+    irq_disable();
+    thread_t *t = cur();
+    spin_lock(&t->exit_waiters.lock);
+    spin_lock(&t->lock);
+    t->state = THREAD_ZOMBIE;
+    spin_unlock(&t->lock);
+    wait_queue_wake_all_locked(&t->exit_waiters);
+    spin_unlock(&t->exit_waiters.lock);
+    schedule(); // Never returns: ZOMBIE threads are not re-queued
+    for (;;) asm volatile("hlt");
+}
+
+thread_t *thread_current(void) { return cur(); }
+
+void thread_yield(void) {
+    uint32_t flags = irq_save();
+    schedule();
+    irq_restore(flags);
+}
+
+void thread_sleep_ms(uint32_t ms) {
+    uint32_t ticks = timer_ms_to_ticks(ms);
+    if (ticks == 0) { thread_yield(); return; }
+    uint32_t flags = irq_save();
+    thread_t *t = cur();
+    spin_lock(&t->lock);
+    t->wake_tick = timer_ticks() + ticks;
+    t->state = THREAD_SLEEPING;
+    spin_unlock(&t->lock);
+    schedule();
+    irq_restore(flags);
+}
+
+void thread_block(void) {
+    uint32_t flags = irq_save();
+    thread_t *t = cur();
+    spin_lock(&t->lock);
+    if (t->wake_pending) {
+        t->wake_pending = 0;
+        spin_unlock(&t->lock);
+        irq_restore(flags);
+        return;
+    }
+    t->state = THREAD_BLOCKED;
+    spin_unlock(&t->lock);
+    schedule();
+    irq_restore(flags);
+}
+
+void thread_wake(thread_t *t) {
+    uint32_t flags = spin_lock_irqsave(&t->lock);
+    if ((t->state == THREAD_BLOCKED && !t->in_wait_queue) || t->state == THREAD_SLEEPING) {
+        make_ready(t);
+    } else if (t->state != THREAD_ZOMBIE && t->state != THREAD_UNUSED) {
+        t->wake_pending = 1; // Not asleep yet: its next thread_block() returns at once
+    }
+    spin_unlock_irqrestore(&t->lock, flags);
+}
+
+// --- Wait Queues ---
+uint32_t wait_queue_lock(wait_queue_t *wq) { return spin_lock_irqsave(&wq->lock); }
+void wait_queue_unlock(wait_queue_t *wq, uint32_t flags) { spin_unlock_irqrestore(&wq->lock, flags); }
+
+void wait_queue_sleep(wait_queue_t *wq) {
+    thread_t *t = cur();
+    t->next = NULL;
+    if (wq->tail) wq->tail->next = t; else wq->head = t;
+    wq->tail = t;
+
+    spin_lock(&t->lock);
+    t->in_wait_queue = 1;
+    t->state = THREAD_BLOCKED;
+    spin_unlock(&t->lock);
+
+    spin_unlock(&wq->lock); // A waker may make us READY before we switch; on_cpu covers that
+    schedule();
+    spin_lock(&wq->lock);
+}
+
+int wait_queue_wake_one_locked(wait_queue_t *wq) {
+    thread_t *t = wq->head;
+    if (!t) return 0;
+    wq->head = t->next;
+    if (!wq->head) wq->tail = NULL;
+    t->next = NULL;
+
+    spin_lock(&t->lock);
+    t->in_wait_queue = 0;
+    make_ready(t);
+    spin_unlock(&t->lock);
+    return 1;
+}
+
+int wait_queue_wake_all_locked(wait_queue_t *wq) {
+    int n = 0;
+    while (wait_queue_wake_one_locked(wq)) n++;
+    return n;
+}
+
+int wait_queue_wake_one(wait_queue_t *wq) {
+    uint32_t flags = wait_queue_lock(wq);
+    int n = wait_queue_wake_one_locked(wq);
+    wait_queue_unlock(wq, flags);
+    return n;
+}
+
+int wait_queue_wake_all(wait_queue_t *wq) {
+    uint32_t flags = wait_queue_lock(wq);
+    int n = wait_queue_wake_all_locked(wq);
+    wait_queue_unlock(wq, flags);
+    return n;
+}
+
+// --- Mutexes ---
+void mutex_init(mutex_t *m) {
+    memset(m, 0, sizeof(*m));
+}
+
+void mutex_lock(mutex_t *m) {
+    uint32_t flags = wait_queue_lock(&m->waiters);
+    while (m->owner) wait_queue_sleep(&m->waiters);
+    m->owner = cur();
+    wait_queue_unlock(&m->waiters, flags);
+}
+
+void mutex_unlock(mutex_t *m) {
+    uint32_t flags = wait_queue_lock(&m->waiters);
+    m->owner = NULL;
+    wait_queue_wake_one_locked(&m->waiters);
+    wait_queue_unlock(&m->waiters, flags);
+}
+
+// --- Introspection ---
+const thread_t *thread_get_slot(int slot) {
+    if (slot < 0 || slot >= MAX_THREADS || threads[slot].state == THREAD_UNUSED) return NULL;
+    return &threads[slot];
+}
+
+const char *thread_state_name(thread_state_t state) {
+    switch (state) {
+        case THREAD_READY:    return "ready";
+        case THREAD_RUNNING:  return "running";
+        case THREAD_BLOCKED:  return "blocked";
+        case THREAD_SLEEPING: return "sleeping";
+        case THREAD_ZOMBIE:   return "zombie";
+        default:              return "unused";
+    }
+}
+
+// --- Hooks ---
+void thread_wake_sleepers(uint32_t now) {
+    for (int i = 0; i < MAX_THREADS; ++i) {
+        thread_t *t = &threads[i];
+        if (t->state != THREAD_SLEEPING) continue;
+        spin_lock(&t->lock);
+        if (t->state == THREAD_SLEEPING && (int32_t)(now - t->wake_tick) >= 0) make_ready(t);
+        spin_unlock(&t->lock);
+    }
+}
+
+void thread_cpu_tick(void) {
+    cpu_t *cpu = this_cpu();
+    thread_t *t = cpu->current;
+    if (!t) return;
+    cpu->ticks++;
+
+    if (t == cpu->idle) {
+        cpu->idle_ticks++;
+        if (cpu->nr_ready > 0 || work_elsewhere(cpu)) cpu->need_resched = 1; // Run or steal it
+    } else {
+        t->cpu_ticks++;
+        if (t->slice_left > 0 && --t->slice_left == 0) cpu->need_resched = 1; // Quantum used up
+    }
+}
+
+void thread_resched_ipi(void) { this_cpu()->need_resched = 1; }
+
+void thread_preempt_check(void) {
+    cpu_t *cpu = this_cpu();
+    if (cpu->need_resched && cpu->current && cpu->irq_nesting == 0) schedule();
+}
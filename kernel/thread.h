@@ -0,0 +1,136 @@
+// kernel/thread.h
+// Kernel threads, preemptive round-robin scheduler with per-CPU run queues and
+// work stealing, wait queues and mutexes. Readably formatted.
+
+#ifndef THREAD_H
+#define THREAD_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "spinlock.h"
+#include "cpu.h"
+
+// --- Limits ---
+#define MAX_THREADS            32
+#define THREAD_STACK_SIZE      8192  // Bytes per kernel thread stack
+#define THREAD_NAME_LEN        16
+#define THREAD_TIMESLICE_TICKS 5     // Round-robin quantum (5 ticks = 50 ms at TIMER_HZ 100)
+
+typedef enum {
+    THREAD_UNUSED = 0, // Free slot
+    THREAD_READY,      // On the run queue
+    THREAD_RUNNING,    // Owns the CPU
+    THREAD_BLOCKED,    // Waiting on a wait queue
+    THREAD_SLEEPING,   // Waiting for wake_tick
+    THREAD_ZOMBIE      // Exited, waiting to be joined (or recycled if detached)
+} thread_state_t;
+
+typedef struct thread thread_t;
+
+// FIFO of blocked threads with its own lock. Zero-initialized (or
+// WAIT_QUEUE_INIT) is empty and unlocked.
+typedef struct wait_queue {
+    spinlock_t lock;
+    thread_t *head;
+    thread_t *tail;
+} wait_queue_t;
+#define WAIT_QUEUE_INIT { SPINLOCK_INIT, NULL, NULL }
+
+struct thread {
+    uint32_t esp;                 // Saved stack pointer while not running
+    uint32_t id;                  // Unique, never reused
+    spinlock_t lock;              // Guards state changes and wake_pending
+    volatile thread_state_t state;
+    volatile int on_cpu;          // Set while some CPU is still using this stack
+    uint32_t cpu;                 // CPU whose run queue it goes back to (affinity)
+    int wake_pending;             // thread_wake() arrived before thread_block()
+    int in_wait_queue;            // Linked on a wait_queue_t (only its waker may make it READY)
+    char name[THREAD_NAME_LEN];
+    void (*entry)(void *arg);
+    void *arg;
+    uint8_t *stack_base;          // Lowest stack address (holds the overflow canary)
+    uint32_t wake_tick;           // THREAD_SLEEPING: tick to wake at
+    uint32_t slice_left;          // Ticks left in the current quantum
+    uint32_t cpu_ticks;           // Ticks spent running (for 'ps')
+    int detached;                 // Recycle slot on exit instead of waiting for join
+    int joined;                   // A thread_join() has claimed the slot
+    thread_t *next;               // Run queue / wait queue link
+    wait_queue_t exit_waiters;    // Threads blocked in thread_join()
+};
+
+// Sleeping lock; may only be taken from thread context.
+typedef struct {
+    wait_queue_t waiters;         // waiters.lock also guards 'owner'
+    thread_t *owner;
+} mutex_t;
+#define MUTEX_INIT { WAIT_QUEUE_INIT, NULL }
+
+// --- Scheduler Setup ---
+// Turns the boot context (kernel_main on the boot stack) into thread 0 and
+// creates the BSP idle thread. Call after cpu_setup(0) and idt_init(),
+// before timer_init().
+void thread_init(void);
+
+// Turns an application processor's boot context into that CPU's idle thread.
+// Call on the AP after cpu_setup(); returns with the AP ready to schedule.
+void thread_init_ap(uint8_t *stack_base);
+
+// --- Thread Lifecycle ---
+// Creates a runnable thread. Returns NULL if all MAX_THREADS slots are in use.
+thread_t *thread_create(const char *name, void (*entry)(void *arg), void *arg);
+// Lets the slot be recycled as soon as the thread exits (no join). No
+// effect once a thread_join() is waiting for it.
+void thread_detach(thread_t *t);
+// Blocks until 't' exits, then frees its slot. Returns 0, or -1 if 't' is
+// invalid, detached or already being joined.
+int thread_join(thread_t *t);
+void thread_exit(void) __attribute__((noreturn));
+
+// --- Scheduling Primitives ---
+thread_t *thread_current(void);
+void thread_yield(void);
+void thread_sleep_ms(uint32_t ms);
+// Blocks the current thread until thread_wake() is called on it. Returns
+// at once if a wake-up already arrived since the last block. Callers
+// re-check their condition in a loop.
+void thread_block(void);
+// Makes a thread blocked in thread_block() or thread_sleep_ms() runnable,
+// or records a pending wake-up if it has not blocked yet. Do not use on
+// threads sleeping in a wait queue. Safe from IRQ handlers.
+void thread_wake(thread_t *t);
+
+// --- Wait Queues ---
+// Checking the wait condition and going to sleep must happen under the
+// queue lock, so a wake-up from another CPU or an IRQ cannot slip between:
+//     uint32_t f = wait_queue_lock(&wq);
+//     while (!cond) wait_queue_sleep(&wq);
+//     wait_queue_unlock(&wq, f);
+// wait_queue_sleep() drops the lock while asleep and retakes it before
+// returning. Never sleep from an IRQ handler.
+uint32_t wait_queue_lock(wait_queue_t *wq);
+void wait_queue_unlock(wait_queue_t *wq, uint32_t flags);
+void wait_queue_sleep(wait_queue_t *wq);
+// Wake the oldest waiter / every waiter. Safe from IRQ handlers. Return count woken.
+int wait_queue_wake_one(wait_queue_t *wq);
+int wait_queue_wake_all(wait_queue_t *wq);
+// Same, for callers already holding wq->lock.
+int wait_queue_wake_one_locked(wait_queue_t *wq);
+int wait_queue_wake_all_locked(wait_queue_t *wq);
+
+// --- Mutexes ---
+void mutex_init(mutex_t *m);
+void mutex_lock(mutex_t *m);
+void mutex_unlock(mutex_t *m);
+
+// --- Introspection ---
+// Returns the thread in table slot 'slot' (0..MAX_THREADS-1), or NULL if unused.
+const thread_t *thread_get_slot(int slot);
+const char *thread_state_name(thread_state_t state);
+
+// --- Hooks (timer.c / apic.c / idt.c) ---
+void thread_wake_sleepers(uint32_t now); // Global tick (PIT, BSP only): wake expired sleepers
+void thread_cpu_tick(void);              // Per-CPU tick: account time, expire quantum, look for work
+void thread_resched_ipi(void);           // Another CPU queued work for this one
+void thread_preempt_check(void);         // Interrupt exit: switch if a reschedule is pending
+
+#endif // THREAD_H
@@ -0,0 +1,43 @@
+// kernel/timer.c
+// PIT channel 0 in rate-generator mode: the global tick (sleeps, deadlines).
+// Each CPU's LAPIC timer drives its own quantum once SMP is up. Readably formatted.
+
+#include "timer.h"
+#include "idt.h"
+#include "thread.h"
+#include "apic.h"
+#include "io.h"
+#include <stdint.h>
+
+// --- PIT Ports ---
+#define PIT_CHANNEL0  0x40
+#define PIT_COMMAND   0x43
+#define PIT_BASE_HZ   1193182
+#define PIT_CMD_CH0_LOHI_RATE 0x34 // Channel 0, lobyte/hibyte, mode 2, binary
+
+// --- Module State ---
+static volatile uint32_t ticks = 0;
+
+// --- IRQ0 Handler ---
+static void timer_irq(interrupt_frame_t *frame) {
+    (void)frame;
+    ticks++;
+    thread_wake_sleepers(ticks);
+    if (!lapic_timer_active()) thread_cpu_tick(); // Uniprocessor fallback: PIT drives the quantum too
+}
+
+// --- Public Functions ---
+void timer_init(void) {
+    uint16_t divisor = (uint16_t)(PIT_BASE_HZ / TIMER_HZ);
+    outb(PIT_COMMAND, PIT_CMD_CH0_LOHI_RATE);
+    outb(PIT_CHANNEL0, divisor & 0xFF);
+    outb(PIT_CHANNEL0, (divisor >> 8) & 0xFF);
+    irq_register_handler(IRQ_TIMER, timer_irq);
+}
+
+uint32_t timer_ticks(void) { return ticks; }
+
+uint32_t timer_ms_to_ticks(uint32_t ms) {
+    if (ms == 0) return 0;
+    return (ms * TIMER_HZ + 999) / 1000;
+}
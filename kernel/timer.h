@@ -0,0 +1,20 @@
+// kernel/timer.h
+// PIT (8253/8254) system tick. Readably formatted.
+
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>
+
+#define TIMER_HZ 100 // Scheduler tick rate (10 ms per tick)
+
+// Programs PIT channel 0 for TIMER_HZ and installs the IRQ0 handler.
+void timer_init(void);
+
+// Ticks since timer_init().
+uint32_t timer_ticks(void);
+
+// Converts milliseconds to ticks, rounding up (at least 1 tick for ms > 0).
+uint32_t timer_ms_to_ticks(uint32_t ms);
+
+#endif // TIMER_H
@@ -0,0 +1,57 @@
+; kernel/trampoline.asm
+; NASM syntax
+; Application processor start-up code. smp.c copies it to AP_TRAMPOLINE_ADDR
+; (below 1 MiB, page aligned) and points the STARTUP IPI at it. The AP wakes
+; in real mode at CS:IP = 0x0800:0000, switches to flat protected mode with a
+; temporary GDT and calls the C entry on the stack smp.c patched in.
+
+%define TRAMP_BASE 0x8000 ; Must match AP_TRAMPOLINE_ADDR in smp.c
+%define TRAMP(x) (TRAMP_BASE + (x) - ap_trampoline_start)
+
+section .text
+global ap_trampoline_start
+global ap_trampoline_end
+global ap_trampoline_stack
+global ap_trampoline_entry
+
+bits 16
+ap_trampoline_start:
+    cli
+    cld
+    xor ax, ax
+    mov ds, ax
+    lgdt [TRAMP(tramp_gdt_ptr)]
+    mov eax, cr0
+    or eax, 1          ; PE
+    mov cr0, eax
+    jmp dword 0x08:TRAMP(tramp_pm)
+
+bits 32
+tramp_pm:
+    mov ax, 0x10
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    mov gs, ax
+    mov ss, ax
+    mov esp, [TRAMP(ap_trampoline_stack)]
+    xor ebp, ebp
+    call [TRAMP(ap_trampoline_entry)] ; Does not return
+.hang:
+    cli
+    hlt
+    jmp .hang
+
+align 8
+tramp_gdt:
+    dq 0                  ; Null descriptor
+    dq 0x00CF9A000000FFFF ; Code: flat 4 GiB, ring 0 (same layout as gdt.c)
+    dq 0x00CF92000000FFFF ; Data: flat 4 GiB, ring 0
+tramp_gdt_ptr:
+    dw 3 * 8 - 1
+    dd TRAMP(tramp_gdt)
+
+align 4
+ap_trampoline_stack: dd 0 ; Patched per AP: initial ESP
+ap_trampoline_entry: dd 0 ; Patched: C entry point
+ap_trampoline_end:
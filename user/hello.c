@@ -0,0 +1,23 @@
+// user/hello.c
+// Example program: prints its arguments. Run with 'exec hello.elf a b c'.
+
+#include "program.h"
+
+static uint32_t length(const char *s) {
+    uint32_t n = 0;
+    while (s[n]) n++;
+    return n;
+}
+
+static void print(const program_api_t *api, const char *s) {
+    api->write(s, length(s));
+}
+
+__attribute__((section(".text._start")))
+int _start(const program_api_t *api, const char *args) {
+    if (api->version < 1) return 1;
+    print(api, "Hello from hello.elf, args: '");
+    print(api, args);
+    print(api, "'\n");
+    return 0;
+}